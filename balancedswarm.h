@@ -0,0 +1,573 @@
+#pragma once
+#ifndef BALANCEDSWARM_H
+#define BALANCEDSWARM_H
+#include "swarm.h"
+#include "outputsink.h"
+#include <random>
+#define RED_LINK 1 //color of a red node in RedBlackPolicy
+#define BLACK_LINK 0
+
+// Balancing policies for BalancedSwarm. Every policy keeps its per-node balance data in
+// Robot::m_height, so all trees share the Robot payload:
+//   AvlPolicy       height, |left - right| <= 1
+//   RedBlackPolicy  color of a left-leaning red-black tree (RED_LINK / BLACK_LINK)
+//   WavlPolicy      rank of a weak AVL tree, rank differences 1 or 2 and leaves of rank 0
+//   TreapPolicy     random priority, heap ordered
+// A policy provides insert and remove on a subtree. insert links the new leaf and sets
+// inserted to false on a duplicate; remove unlinks one node, which may hold another ID after
+// its payload moved up, and returns it in removed. Both count rotations.
+class BalancePolicy {
+public:
+    // Single left rotation, only the links
+    static Robot* rotateLeft(Robot* aBot, long long& rotations) {
+        Robot* temp = aBot->getRight();
+        aBot->setRight(temp->getLeft());
+        temp->setLeft(aBot);
+        rotations++;
+        return temp;
+    }
+    // Single right rotation, only the links
+    static Robot* rotateRight(Robot* aBot, long long& rotations) {
+        Robot* temp = aBot->getLeft();
+        aBot->setLeft(temp->getRight());
+        temp->setRight(aBot);
+        rotations++;
+        return temp;
+    }
+    // Copy the ID, type and state of source into target
+    static void movePayload(Robot* target, const Robot* source) {
+        target->setID(source->getID());
+        target->setType(source->getType());
+        target->setState(source->getState());
+    }
+    // Balance data of a node, -1 for a missing node
+    static int rank(const Robot* aBot) {
+        return (aBot == nullptr) ? -1 : aBot->getHeight();
+    }
+};
+
+// AVL tree, the same rules as Swarm
+class AvlPolicy : public BalancePolicy {
+public:
+    static const char* name() { return "AVL"; }
+
+    static Robot* insert(Robot* aBot, Robot* leaf, bool& inserted, long long& rotations) {
+        if (aBot == nullptr) {
+            leaf->setHeight(0);
+            inserted = true;
+            return leaf;
+        }
+        if (leaf->getID() < aBot->getID()) {
+            aBot->setLeft(insert(aBot->getLeft(), leaf, inserted, rotations));
+        }
+        else if (leaf->getID() > aBot->getID()) {
+            aBot->setRight(insert(aBot->getRight(), leaf, inserted, rotations));
+        }
+        else {
+            inserted = false;
+            return aBot;
+        }
+        return rebalance(aBot, rotations);
+    }
+
+    static Robot* remove(Robot* aBot, int id, Robot*& removed, long long& rotations) {
+        if (aBot == nullptr) {
+            return nullptr;
+        }
+        if (id < aBot->getID()) {
+            aBot->setLeft(remove(aBot->getLeft(), id, removed, rotations));
+        }
+        else if (id > aBot->getID()) {
+            aBot->setRight(remove(aBot->getRight(), id, removed, rotations));
+        }
+        else if (aBot->getLeft() == nullptr || aBot->getRight() == nullptr) {
+            removed = aBot;
+            return (aBot->getLeft() == nullptr) ? aBot->getRight() : aBot->getLeft();
+        }
+        else {
+            Robot* temp = aBot->getRight();
+            while (temp->getLeft() != nullptr) {
+                temp = temp->getLeft();
+            }
+            movePayload(aBot, temp);
+            aBot->setRight(remove(aBot->getRight(), temp->getID(), removed, rotations));
+        }
+        return rebalance(aBot, rotations);
+    }
+
+private:
+    static void updateHeight(Robot* aBot) {
+        int left = rank(aBot->getLeft()), right = rank(aBot->getRight());
+        aBot->setHeight((left > right ? left : right) + 1);
+    }
+    static Robot* rotate(Robot* aBot, bool toLeft, long long& rotations) {
+        Robot* top = toLeft ? rotateLeft(aBot, rotations) : rotateRight(aBot, rotations);
+        updateHeight(aBot);
+        updateHeight(top);
+        return top;
+    }
+    static Robot* rebalance(Robot* aBot, long long& rotations) {
+        updateHeight(aBot);
+        int balance = rank(aBot->getLeft()) - rank(aBot->getRight());
+        if (balance > 1) {
+            Robot* left = aBot->getLeft();
+            if (rank(left->getLeft()) < rank(left->getRight())) {
+                aBot->setLeft(rotate(left, true, rotations));
+            }
+            return rotate(aBot, false, rotations);
+        }
+        if (balance < -1) {
+            Robot* right = aBot->getRight();
+            if (rank(right->getRight()) < rank(right->getLeft())) {
+                aBot->setRight(rotate(right, false, rotations));
+            }
+            return rotate(aBot, true, rotations);
+        }
+        return aBot;
+    }
+};
+
+// Left-leaning red-black tree (Sedgewick): every red node is a left child and no red node has
+// a red child, so the tree is a 2-3 tree drawn with binary nodes.
+class RedBlackPolicy : public BalancePolicy {
+public:
+    static const char* name() { return "red-black"; }
+
+    static Robot* insert(Robot* root, Robot* leaf, bool& inserted, long long& rotations) {
+        root = insertNode(root, leaf, inserted, rotations);
+        root->setHeight(BLACK_LINK);
+        return root;
+    }
+
+    static Robot* remove(Robot* root, int id, Robot*& removed, long long& rotations) {
+        if (!contains(root, id)) {
+            return root;
+        }
+        if (!isRed(root->getLeft()) && !isRed(root->getRight())) {
+            root->setHeight(RED_LINK);
+        }
+        root = removeNode(root, id, removed, rotations);
+        if (root != nullptr) {
+            root->setHeight(BLACK_LINK);
+        }
+        return root;
+    }
+
+private:
+    static bool isRed(const Robot* aBot) {
+        return aBot != nullptr && aBot->getHeight() == RED_LINK;
+    }
+    static bool contains(const Robot* aBot, int id) {
+        while (aBot != nullptr && aBot->getID() != id) {
+            aBot = (id < aBot->getID()) ? aBot->getLeft() : aBot->getRight();
+        }
+        return aBot != nullptr;
+    }
+    static Robot* rotate(Robot* aBot, bool toLeft, long long& rotations) {
+        Robot* top = toLeft ? rotateLeft(aBot, rotations) : rotateRight(aBot, rotations);
+        top->setHeight(aBot->getHeight());
+        aBot->setHeight(RED_LINK);
+        return top;
+    }
+    static void flipColors(Robot* aBot) {
+        aBot->setHeight(1 - aBot->getHeight());
+        aBot->getLeft()->setHeight(1 - aBot->getLeft()->getHeight());
+        aBot->getRight()->setHeight(1 - aBot->getRight()->getHeight());
+    }
+    static Robot* balance(Robot* aBot, long long& rotations) {
+        if (isRed(aBot->getRight()) && !isRed(aBot->getLeft())) {
+            aBot = rotate(aBot, true, rotations);
+        }
+        if (isRed(aBot->getLeft()) && isRed(aBot->getLeft()->getLeft())) {
+            aBot = rotate(aBot, false, rotations);
+        }
+        if (isRed(aBot->getLeft()) && isRed(aBot->getRight())) {
+            flipColors(aBot);
+        }
+        return aBot;
+    }
+    static Robot* moveRedLeft(Robot* aBot, long long& rotations) {
+        flipColors(aBot);
+        if (isRed(aBot->getRight()->getLeft())) {
+            aBot->setRight(rotate(aBot->getRight(), false, rotations));
+            aBot = rotate(aBot, true, rotations);
+            flipColors(aBot);
+        }
+        return aBot;
+    }
+    static Robot* moveRedRight(Robot* aBot, long long& rotations) {
+        flipColors(aBot);
+        if (isRed(aBot->getLeft()->getLeft())) {
+            aBot = rotate(aBot, false, rotations);
+            flipColors(aBot);
+        }
+        return aBot;
+    }
+    static Robot* insertNode(Robot* aBot, Robot* leaf, bool& inserted, long long& rotations) {
+        if (aBot == nullptr) {
+            leaf->setHeight(RED_LINK);
+            inserted = true;
+            return leaf;
+        }
+        if (leaf->getID() < aBot->getID()) {
+            aBot->setLeft(insertNode(aBot->getLeft(), leaf, inserted, rotations));
+        }
+        else if (leaf->getID() > aBot->getID()) {
+            aBot->setRight(insertNode(aBot->getRight(), leaf, inserted, rotations));
+        }
+        else {
+            inserted = false;
+            return aBot;
+        }
+        return balance(aBot, rotations);
+    }
+    static Robot* removeMin(Robot* aBot, Robot*& removed, long long& rotations) {
+        if (aBot->getLeft() == nullptr) {
+            removed = aBot;
+            return nullptr;
+        }
+        if (!isRed(aBot->getLeft()) && !isRed(aBot->getLeft()->getLeft())) {
+            aBot = moveRedLeft(aBot, rotations);
+        }
+        aBot->setLeft(removeMin(aBot->getLeft(), removed, rotations));
+        return balance(aBot, rotations);
+    }
+    static Robot* removeNode(Robot* aBot, int id, Robot*& removed, long long& rotations) {
+        if (id < aBot->getID()) {
+            if (!isRed(aBot->getLeft()) && !isRed(aBot->getLeft()->getLeft())) {
+                aBot = moveRedLeft(aBot, rotations);
+            }
+            aBot->setLeft(removeNode(aBot->getLeft(), id, removed, rotations));
+        }
+        else {
+            if (isRed(aBot->getLeft())) {
+                aBot = rotate(aBot, false, rotations);
+            }
+            if (id == aBot->getID() && aBot->getRight() == nullptr) {
+                removed = aBot;
+                return nullptr;
+            }
+            if (!isRed(aBot->getRight()) && !isRed(aBot->getRight()->getLeft())) {
+                aBot = moveRedRight(aBot, rotations);
+            }
+            if (id == aBot->getID()) {
+                Robot* temp = aBot->getRight();
+                while (temp->getLeft() != nullptr) {
+                    temp = temp->getLeft();
+                }
+                movePayload(aBot, temp);
+                aBot->setRight(removeMin(aBot->getRight(), removed, rotations));
+            }
+            else {
+                aBot->setRight(removeNode(aBot->getRight(), id, removed, rotations));
+            }
+        }
+        return balance(aBot, rotations);
+    }
+};
+
+// Weak AVL tree (Haeupler, Sen, Tarjan). Inserts rebalance exactly like AVL, but a delete does
+// at most two rotations because a node may be 2,2: deletions are absorbed by demotions.
+class WavlPolicy : public BalancePolicy {
+public:
+    static const char* name() { return "WAVL"; }
+
+    static Robot* insert(Robot* aBot, Robot* leaf, bool& inserted, long long& rotations) {
+        if (aBot == nullptr) {
+            leaf->setHeight(0);
+            inserted = true;
+            return leaf;
+        }
+        if (leaf->getID() < aBot->getID()) {
+            aBot->setLeft(insert(aBot->getLeft(), leaf, inserted, rotations));
+            return fixInsert(aBot, true, rotations);
+        }
+        if (leaf->getID() > aBot->getID()) {
+            aBot->setRight(insert(aBot->getRight(), leaf, inserted, rotations));
+            return fixInsert(aBot, false, rotations);
+        }
+        inserted = false;
+        return aBot;
+    }
+
+    static Robot* remove(Robot* aBot, int id, Robot*& removed, long long& rotations) {
+        if (aBot == nullptr) {
+            return nullptr;
+        }
+        if (id < aBot->getID()) {
+            aBot->setLeft(remove(aBot->getLeft(), id, removed, rotations));
+            return fixRemove(aBot, true, rotations);
+        }
+        if (id > aBot->getID()) {
+            aBot->setRight(remove(aBot->getRight(), id, removed, rotations));
+            return fixRemove(aBot, false, rotations);
+        }
+        if (aBot->getLeft() == nullptr || aBot->getRight() == nullptr) {
+            removed = aBot;
+            return (aBot->getLeft() == nullptr) ? aBot->getRight() : aBot->getLeft();
+        }
+        Robot* temp = aBot->getRight();
+        while (temp->getLeft() != nullptr) {
+            temp = temp->getLeft();
+        }
+        movePayload(aBot, temp);
+        aBot->setRight(remove(aBot->getRight(), temp->getID(), removed, rotations));
+        return fixRemove(aBot, false, rotations);
+    }
+
+private:
+    static Robot* child(Robot* aBot, bool left) {
+        return left ? aBot->getLeft() : aBot->getRight();
+    }
+    static void setChild(Robot* aBot, bool left, Robot* subtree) {
+        if (left) aBot->setLeft(subtree); else aBot->setRight(subtree);
+    }
+    static Robot* rotateUp(Robot* aBot, bool leftChild, long long& rotations) {
+        return leftChild ? rotateRight(aBot, rotations) : rotateLeft(aBot, rotations);
+    }
+    static void promote(Robot* aBot, int by) {
+        aBot->setHeight(aBot->getHeight() + by);
+    }
+    // The subtree on side `left` of aBot got an insert; resolve a rank difference of 0 there
+    static Robot* fixInsert(Robot* aBot, bool left, long long& rotations) {
+        Robot* y = child(aBot, left);
+        if (rank(aBot) - rank(y) != 0) {
+            return aBot;
+        }
+        if (rank(aBot) - rank(child(aBot, !left)) == 1) {
+            promote(aBot, 1);
+            return aBot;
+        }
+        Robot* outer = child(y, left);
+        if (rank(y) - rank(outer) == 1) {
+            Robot* top = rotateUp(aBot, left, rotations);
+            promote(aBot, -1);
+            return top;
+        }
+        Robot* z = child(y, !left);
+        setChild(aBot, left, rotateUp(y, !left, rotations));
+        Robot* top = rotateUp(aBot, left, rotations);
+        promote(z, 1);
+        promote(y, -1);
+        promote(aBot, -1);
+        return top;
+    }
+    // The subtree on side `left` of aBot lost a node; resolve a 2,2 leaf or a rank difference of 3
+    static Robot* fixRemove(Robot* aBot, bool left, long long& rotations) {
+        if (aBot->getLeft() == nullptr && aBot->getRight() == nullptr) {
+            if (rank(aBot) == 1) {
+                promote(aBot, -1);
+            }
+            return aBot;
+        }
+        if (rank(aBot) - rank(child(aBot, left)) != 3) {
+            return aBot;
+        }
+        Robot* y = child(aBot, !left);
+        if (rank(aBot) - rank(y) == 2) {
+            promote(aBot, -1);
+            return aBot;
+        }
+        Robot* outer = child(y, !left);
+        Robot* inner = child(y, left);
+        if (rank(y) - rank(outer) == 2 && rank(y) - rank(inner) == 2) {
+            promote(aBot, -1);
+            promote(y, -1);
+            return aBot;
+        }
+        if (rank(y) - rank(outer) == 1) {
+            Robot* top = rotateUp(aBot, !left, rotations);
+            promote(y, 1);
+            promote(aBot, -1);
+            if (aBot->getLeft() == nullptr && aBot->getRight() == nullptr) {
+                promote(aBot, -1);
+            }
+            return top;
+        }
+        setChild(aBot, !left, rotateUp(y, left, rotations));
+        Robot* top = rotateUp(aBot, !left, rotations);
+        promote(inner, 2);
+        promote(y, -1);
+        promote(aBot, -2);
+        return top;
+    }
+};
+
+// Treap: a search tree on IDs and a max-heap on random priorities, balanced in expectation
+class TreapPolicy : public BalancePolicy {
+public:
+    static const char* name() { return "treap"; }
+
+    static Robot* insert(Robot* aBot, Robot* leaf, bool& inserted, long long& rotations) {
+        if (aBot == nullptr) {
+            static std::mt19937 generator(10);// 10 is the fixed seed value
+            leaf->setHeight((int)(generator() >> 1));
+            inserted = true;
+            return leaf;
+        }
+        if (leaf->getID() < aBot->getID()) {
+            aBot->setLeft(insert(aBot->getLeft(), leaf, inserted, rotations));
+            if (aBot->getLeft()->getHeight() > aBot->getHeight()) {
+                aBot = rotateRight(aBot, rotations);
+            }
+        }
+        else if (leaf->getID() > aBot->getID()) {
+            aBot->setRight(insert(aBot->getRight(), leaf, inserted, rotations));
+            if (aBot->getRight()->getHeight() > aBot->getHeight()) {
+                aBot = rotateLeft(aBot, rotations);
+            }
+        }
+        else {
+            inserted = false;
+        }
+        return aBot;
+    }
+
+    // The node is rotated down below its higher-priority child until it has at most one child
+    static Robot* remove(Robot* aBot, int id, Robot*& removed, long long& rotations) {
+        if (aBot == nullptr) {
+            return nullptr;
+        }
+        if (id < aBot->getID()) {
+            aBot->setLeft(remove(aBot->getLeft(), id, removed, rotations));
+        }
+        else if (id > aBot->getID()) {
+            aBot->setRight(remove(aBot->getRight(), id, removed, rotations));
+        }
+        else if (aBot->getLeft() == nullptr || aBot->getRight() == nullptr) {
+            removed = aBot;
+            return (aBot->getLeft() == nullptr) ? aBot->getRight() : aBot->getLeft();
+        }
+        else if (aBot->getLeft()->getHeight() > aBot->getRight()->getHeight()) {
+            aBot = rotateRight(aBot, rotations);
+            aBot->setRight(remove(aBot->getRight(), id, removed, rotations));
+        }
+        else {
+            aBot = rotateLeft(aBot, rotations);
+            aBot->setLeft(remove(aBot->getLeft(), id, removed, rotations));
+        }
+        return aBot;
+    }
+};
+
+// Swarm with a pluggable balancing policy. Offers the interface of Swarm on the same Robot
+// nodes, taken from a RobotArena, and counts the rotations the policy performs so policies can
+// be compared on a workload. IDs must lie in MINID..MAXID.
+template <class Policy = AvlPolicy>
+class BalancedSwarm {
+public:
+    friend class Grader;
+    friend class Tester;
+    BalancedSwarm() : m_root(nullptr), m_size(0), m_rotations(0) {}
+
+    void insert(const Robot& robot) {
+        if (robot.getID() < MINID || robot.getID() > MAXID) {
+            return;
+        }
+        Robot* leaf = m_arena.allocate(robot.getID(), robot.getType(), robot.getState());
+        bool inserted = false;
+        m_root = Policy::insert(m_root, leaf, inserted, m_rotations);
+        if (inserted) {
+            m_size++;
+        }
+        else {
+            m_arena.release(leaf);
+        }
+    }
+
+    void clear() {
+        m_root = nullptr;
+        m_size = 0;
+        m_arena.reset();
+    }
+
+    void remove(int id) {
+        Robot* removed = nullptr;
+        m_root = Policy::remove(m_root, id, removed, m_rotations);
+        if (removed != nullptr) {
+            m_arena.release(removed);
+            m_size--;
+        }
+    }
+
+    void dumpTree() const {
+        dump(m_root);
+    }
+
+    void listRobots() const {
+        OutputSink out(cout);
+        listRobots(out);
+    }
+
+    void listRobots(OutputSink& out) const {//same text as listRobots(), written to out
+        traverseTree(m_root, out);
+    }
+
+    bool setState(int id, STATE state) {
+        Robot* aBot = findThisBot(id);
+        if (aBot == nullptr) {
+            return false;
+        }
+        aBot->setState(state);
+        return true;
+    }
+
+    // Removes every DEAD robot with one policy removal each, O(k log n)
+    void removeDead() {
+        vector<int> dead;
+        collectDead(m_root, dead);
+        for (int id : dead) {
+            remove(id);
+        }
+    }
+
+    bool findBot(int id) const {
+        return findThisBot(id) != nullptr;
+    }
+
+    int size() const { return m_size; }
+    long long rotations() const { return m_rotations; }//rotations since construction
+    static const char* policyName() { return Policy::name(); }
+
+private:
+    Robot* m_root;
+    int m_size;
+    long long m_rotations;
+    RobotArena m_arena;
+
+    Robot* findThisBot(int id) const {
+        Robot* aBot = m_root;
+        while (aBot != nullptr && aBot->getID() != id) {
+            aBot = (id < aBot->getID()) ? aBot->getLeft() : aBot->getRight();
+        }
+        return aBot;
+    }
+
+    void collectDead(Robot* aBot, vector<int>& dead) const {
+        if (aBot != nullptr) {
+            collectDead(aBot->getLeft(), dead);
+            if (aBot->getState() == DEAD) dead.push_back(aBot->getID());
+            collectDead(aBot->getRight(), dead);
+        }
+    }
+
+    void traverseTree(Robot* aBot, OutputSink& out) const {
+        if (aBot != nullptr) {
+            traverseTree(aBot->getLeft(), out);
+            Swarm::writeRobot(aBot->getID(), aBot->getState(), aBot->getType(), out);
+            traverseTree(aBot->getRight(), out);
+        }
+    }
+
+    // Display tree, the number after the ID is the policy's balance data
+    void dump(Robot* aBot) const {
+        if (aBot != nullptr) {
+            cout << "(";
+            dump(aBot->getLeft());
+            cout << aBot->getID() << ":" << aBot->getHeight();
+            dump(aBot->getRight());
+            cout << ")";
+        }
+    }
+};
+#endif
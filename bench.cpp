@@ -0,0 +1,235 @@
+/**
+ * File:    bench.cpp
+ *
+ * Description:
+ * Benchmarks of the Swarm operations, built by "make bench" with optimization on and run
+ * separately from the tests. Every operation is timed with steady_clock over repeated trials
+ * after a few warmup trials, at sizes doubling from 1,000 robots. For each size the median and
+ * the 99th percentile of the trials are reported in nanoseconds per operation, and the growth
+ * exponent k of time ~ n^k is fitted over all sizes: about 0 for O(log n), 1 for O(n).
+ * The results go to the terminal and, as JSON, to the file named on the command line so that
+ * runs can be compared between releases.
+ */
+#include "swarm.h"
+#include "outputsink.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+const int BENCH_WARMUP = 5;//trials run before measuring and thrown away
+const int BENCH_TRIALS = 100;//trials measured at every size
+const int BENCH_BATCH = 1000;//operations per trial for the operations on one robot
+const int BENCH_MIN_SIZE = 1000;
+const int BENCH_MAX_SIZE = 64000;//the ID space holds 90,000 robots; the rest are spares to insert
+
+// Timing of one operation at one size, in nanoseconds per operation
+struct Measurement {
+    int n;
+    double median;
+    double p99;
+};
+
+// Timings of one operation at every size and the fitted growth exponent
+struct Result {
+    string operation;
+    string per;//what one operation is
+    vector<Measurement> sizes;
+    double exponent;
+};
+
+static volatile long long g_sink = 0;//keeps the compiler from dropping the lookups
+
+// Run before, timed and after for BENCH_WARMUP + BENCH_TRIALS trials and return the median and
+// 99th percentile of the measured trials. Only timed is on the clock; before and after set up
+// and undo each trial. perTrial is the number of operations timed does.
+static Measurement measure(int n, int perTrial, const function<void(int)>& before,
+    const function<void(int)>& timed, const function<void(int)>& after)
+{
+    vector<double> trials;
+    for (int trial = 0; trial < BENCH_WARMUP + BENCH_TRIALS; trial++) {
+        before(trial);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        timed(trial);
+        chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+        after(trial);
+        if (trial >= BENCH_WARMUP) {
+            trials.push_back(chrono::duration<double, nano>(stop - start).count() / perTrial);
+        }
+    }
+    sort(trials.begin(), trials.end());
+    Measurement result;
+    result.n = n;
+    result.median = trials[trials.size() / 2];
+    result.p99 = trials[(size_t)ceil(0.99 * trials.size()) - 1];
+    return result;
+}
+
+// Least-squares slope of log(median) over log(n)
+static double growthExponent(const vector<Measurement>& sizes) {
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (const Measurement& size : sizes) {
+        double x = log((double)size.n);
+        double y = log(size.median);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    double count = (double)sizes.size();
+    return (count * sumXY - sumX * sumY) / (count * sumXX - sumX * sumX);
+}
+
+// Type every robot with id gets, so that robots put back are the same as before
+static ROBOTTYPE typeOf(int id) {
+    return static_cast<ROBOTTYPE>(id % TYPE_COUNT);
+}
+
+// Measure every operation on a swarm of n robots. ids holds every ID of the ID space in random
+// order; ids[0..n) are in the swarm and the rest are spares for the insert trials. Each trial
+// works on the next slice of IDs, so no trial repeats the IDs of the one before.
+static void measureSize(int n, const vector<int>& ids, vector<Result>& results)
+{
+    Swarm team;
+    for (int i = 0; i < n; i++) {
+        team.insert(Robot(ids[i], typeOf(ids[i])));
+    }
+    int spares = (int)ids.size() - n;
+    auto present = [&](int trial, int i) { return ids[(trial * BENCH_BATCH + i) % n]; };
+    auto spare = [&](int trial, int i) { return ids[n + (trial * BENCH_BATCH + i) % spares]; };
+    auto nothing = [](int) {};
+
+    results[0].sizes.push_back(measure(n, BENCH_BATCH, nothing,
+        [&](int trial) {
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                team.insert(Robot(spare(trial, i), typeOf(spare(trial, i))));
+            }
+        },
+        [&](int trial) {
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                team.remove(spare(trial, i));
+            }
+        }));
+
+    results[1].sizes.push_back(measure(n, BENCH_BATCH, nothing,
+        [&](int trial) {
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                team.remove(present(trial, i));
+            }
+        },
+        [&](int trial) {
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                team.insert(Robot(present(trial, i), typeOf(present(trial, i))));
+            }
+        }));
+
+    results[2].sizes.push_back(measure(n, BENCH_BATCH, nothing,
+        [&](int trial) {
+            long long found = 0;
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                found += team.findBot((i % 2 == 0) ? present(trial, i) : spare(trial, i));
+            }
+            g_sink = g_sink + found;
+        },
+        nothing));
+
+    results[3].sizes.push_back(measure(n, BENCH_BATCH, nothing,
+        [&](int trial) {
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                team.setState(present(trial, i), DEAD);
+            }
+        },
+        [&](int trial) {
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                team.setState(present(trial, i), ALIVE);
+            }
+        }));
+
+    int dead = n / 10;
+    auto deadID = [&](int trial, int i) { return ids[(trial * dead + i) % n]; };
+    results[4].sizes.push_back(measure(n, 1,
+        [&](int trial) {
+            for (int i = 0; i < dead; i++) {
+                team.setState(deadID(trial, i), DEAD);
+            }
+        },
+        [&](int) { team.removeDead(); },
+        [&](int trial) {
+            for (int i = 0; i < dead; i++) {
+                team.insert(Robot(deadID(trial, i), typeOf(deadID(trial, i))));
+            }
+        }));
+
+    vector<char> text((size_t)n * 32);
+    results[5].sizes.push_back(measure(n, 1, nothing,
+        [&](int) {
+            OutputSink out(text.data(), text.size());
+            team.listRobots(out);
+            g_sink = g_sink + (long long)out.written();
+        },
+        nothing));
+}
+
+// The results as one JSON object, with full precision whatever out was set to for the table
+static void writeJSON(ostream& out, const vector<Result>& results) {
+    out << defaultfloat << setprecision(6);
+    out << "{\n  \"benchmark\": \"swarm\",\n  \"unit\": \"ns\",\n  \"warmup\": " << BENCH_WARMUP
+        << ",\n  \"trials\": " << BENCH_TRIALS << ",\n  \"batch\": " << BENCH_BATCH << ",\n  \"operations\": [";
+    for (size_t r = 0; r < results.size(); r++) {
+        const Result& result = results[r];
+        out << (r == 0 ? "" : ",") << "\n    {\"operation\": \"" << result.operation << "\", \"per\": \""
+            << result.per << "\", \"exponent\": " << result.exponent << ", \"sizes\": [";
+        for (size_t s = 0; s < result.sizes.size(); s++) {
+            const Measurement& size = result.sizes[s];
+            out << (s == 0 ? "" : ", ") << "{\"n\": " << size.n << ", \"median\": " << size.median
+                << ", \"p99\": " << size.p99 << "}";
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    vector<int> ids;
+    for (int id = MINID; id <= MAXID; id++) {
+        ids.push_back(id);
+    }
+    shuffle(ids.begin(), ids.end(), mt19937(10));//fixed seed, every run measures the same trees
+
+    vector<Result> results = {
+        { "insert", "robot", {}, 0.0 }, { "remove", "robot", {}, 0.0 }, { "findBot", "lookup", {}, 0.0 },
+        { "setState", "robot", {}, 0.0 }, { "removeDead", "call, a tenth of the robots dead", {}, 0.0 },
+        { "listRobots", "call, into memory", {}, 0.0 } };
+    for (int n = BENCH_MIN_SIZE; n <= BENCH_MAX_SIZE; n *= 2) {
+        measureSize(n, ids, results);
+    }
+
+    cout << fixed << setprecision(1);
+    for (Result& result : results) {
+        result.exponent = growthExponent(result.sizes);
+        cout << result.operation << " (ns per " << result.per << "), growth exponent "
+             << setprecision(3) << result.exponent << setprecision(1) << endl;
+        for (const Measurement& size : result.sizes) {
+            cout << "  n = " << setw(6) << size.n << ": median " << setw(12) << size.median << ", p99 "
+                 << setw(12) << size.p99 << endl;
+        }
+    }
+    if (argc > 1) {
+        ofstream file(argv[1]);
+        writeJSON(file, results);
+        if (!file) {
+            cerr << "cannot write " << argv[1] << endl;
+            return 1;
+        }
+        cout << "results written to " << argv[1] << endl;
+    }
+    else {
+        writeJSON(cout, results);
+    }
+    return 0;
+}
@@ -0,0 +1,475 @@
+#include "btreeswarm.h"
+#include "outputsink.h"
+#include <climits>
+#include <cstring>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BTREE_X86 1
+#include <immintrin.h>
+#endif
+
+// Empty node with every key slot padded
+BTreeNode::BTreeNode(bool leaf) {
+    m_count = 0;
+    m_leaf = leaf;
+    m_next = nullptr;
+    for (int i = 0; i <= BTREE_KEYS; i++) {
+        m_children[i] = nullptr;
+    }
+    pad();
+}
+
+// Refill the unused key slots with INT32_MAX so they never count as smaller than an ID
+void BTreeNode::pad() {
+    for (int i = m_count; i < BTREE_KEYS; i++) {
+        m_keys[i] = INT32_MAX;
+    }
+}
+
+#ifdef BTREE_X86
+// True when the processor runs AVX2 instructions
+static bool detectAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+static const bool HAS_AVX2 = detectAVX2();
+
+// Count the keys smaller than id, eight at a time
+__attribute__((target("avx2,popcnt")))
+static int countLessAVX2(const int32_t* keys, int id) {
+    __m256i target = _mm256_set1_epi32(id);
+    int count = 0;
+    for (int i = 0; i < BTREE_KEYS; i += 8) {
+        __m256i less = _mm256_cmpgt_epi32(target, _mm256_load_si256((const __m256i*)(keys + i)));
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+    }
+    return count;
+}
+
+// Count the keys smaller than id, four at a time
+static int countLessSSE2(const int32_t* keys, int id) {
+    __m128i target = _mm_set1_epi32(id);
+    int count = 0;
+    for (int i = 0; i < BTREE_KEYS; i += 4) {
+        __m128i less = _mm_cmplt_epi32(_mm_load_si128((const __m128i*)(keys + i)), target);
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+    }
+    return count;
+}
+#endif
+
+// Number of keys of a node smaller than id. All BTREE_KEYS slots are compared; the padding
+// never counts, so the result is the position of id among the keys.
+int BTreeSwarm::countLess(const int32_t* keys, int id) {
+#ifdef BTREE_X86
+    return HAS_AVX2 ? countLessAVX2(keys, id) : countLessSSE2(keys, id);
+#else
+    int count = 0;
+    for (int i = 0; i < BTREE_KEYS; i++) {
+        count += keys[i] < id;
+    }
+    return count;
+#endif
+}
+
+// Index of the child of an inner node whose range holds id
+int BTreeSwarm::childSlot(const BTreeNode* node, int id) {
+    return countLess(node->m_keys, id + 1);
+}
+
+// Constructor, performs the required initializations.
+BTreeSwarm::BTreeSwarm() {
+    m_root = nullptr;
+    m_size = 0;
+}
+
+// Destructor, deallocates every node.
+BTreeSwarm::~BTreeSwarm() {
+    clear();
+}
+
+// Inserts a robot. Full nodes are split on the way down, so the leaf always has room and no
+// split has to travel back up. IDs outside MINID..MAXID and duplicates are ignored.
+void BTreeSwarm::insert(const Robot& robot) {
+    int id = robot.getID();
+    if (id < MINID || id > MAXID) {
+        return;
+    }
+    if (m_root == nullptr) {
+        m_root = new BTreeNode(true);
+    }
+    if (m_root->m_count == BTREE_KEYS) {
+        BTreeNode* root = new BTreeNode(false);
+        root->m_children[0] = m_root;
+        m_root = root;
+        splitChild(root, 0);
+    }
+    BTreeNode* node = m_root;
+    while (!node->m_leaf) {
+        int slot = childSlot(node, id);
+        if (node->m_children[slot]->m_count == BTREE_KEYS) {
+            splitChild(node, slot);
+            slot = childSlot(node, id);
+        }
+        node = node->m_children[slot];
+    }
+    int pos = countLess(node->m_keys, id);
+    if (pos < node->m_count && node->m_keys[pos] == id) {
+        return;
+    }
+    int moved = node->m_count - pos;
+    memmove(node->m_keys + pos + 1, node->m_keys + pos, moved * sizeof(int32_t));
+    memmove(node->m_types + pos + 1, node->m_types + pos, moved);
+    memmove(node->m_states + pos + 1, node->m_states + pos, moved);
+    node->m_keys[pos] = id;
+    node->m_types[pos] = (uint8_t)robot.getType();
+    node->m_states[pos] = (uint8_t)robot.getState();
+    node->m_count++;
+    m_size++;
+}
+
+// Split the full child at slot into two nodes and add the separator to parent, which has room
+void BTreeSwarm::splitChild(BTreeNode* parent, int slot) {
+    BTreeNode* child = parent->m_children[slot];
+    BTreeNode* right = new BTreeNode(child->m_leaf);
+    int half = BTREE_KEYS / 2;
+    int separator = 0;
+    if (child->m_leaf) {
+        // leaves keep every key, the separator is a copy of the first key on the right
+        right->m_count = BTREE_KEYS - half;
+        memcpy(right->m_keys, child->m_keys + half, right->m_count * sizeof(int32_t));
+        memcpy(right->m_types, child->m_types + half, right->m_count);
+        memcpy(right->m_states, child->m_states + half, right->m_count);
+        right->m_next = child->m_next;
+        child->m_next = right;
+        separator = right->m_keys[0];
+    }
+    else {
+        // the middle key of an inner node moves up
+        separator = child->m_keys[half];
+        right->m_count = BTREE_KEYS - half - 1;
+        memcpy(right->m_keys, child->m_keys + half + 1, right->m_count * sizeof(int32_t));
+        memcpy(right->m_children, child->m_children + half + 1, (right->m_count + 1) * sizeof(BTreeNode*));
+    }
+    child->m_count = half;
+    child->pad();
+    right->pad();
+
+    int moved = parent->m_count - slot;
+    memmove(parent->m_keys + slot + 1, parent->m_keys + slot, moved * sizeof(int32_t));
+    memmove(parent->m_children + slot + 2, parent->m_children + slot + 1, moved * sizeof(BTreeNode*));
+    parent->m_keys[slot] = separator;
+    parent->m_children[slot + 1] = right;
+    parent->m_count++;
+}
+
+// Deallocates all nodes and makes it an empty tree.
+void BTreeSwarm::clear() {
+    clearFromNode(m_root);
+    m_root = nullptr;
+    m_size = 0;
+}
+
+// Delete a subtree
+void BTreeSwarm::clearFromNode(BTreeNode* node) {
+    if (node == nullptr) {
+        return;
+    }
+    if (!node->m_leaf) {
+        for (int i = 0; i <= node->m_count; i++) {
+            clearFromNode(node->m_children[i]);
+        }
+    }
+    delete node;
+}
+
+// Removes the robot with id. A child holding only BTREE_MIN_KEYS keys is refilled from a
+// sibling, or merged with one, before the descent enters it, so the leaf can always give up a
+// key and no underflow has to travel back up.
+void BTreeSwarm::remove(int id) {
+    if (m_root == nullptr || id < MINID || id > MAXID) {
+        return;
+    }
+    BTreeNode* node = m_root;
+    while (!node->m_leaf) {
+        int slot = childSlot(node, id);
+        if (node->m_children[slot]->m_count <= BTREE_MIN_KEYS) {
+            fixChild(node, slot);
+            if (node == m_root && node->m_count == 0) {
+                // the root's last two children were merged, the tree gets one level shorter
+                m_root = node->m_children[0];
+                delete node;
+                node = m_root;
+                continue;
+            }
+            slot = childSlot(node, id);
+        }
+        node = node->m_children[slot];
+    }
+    int pos = countLess(node->m_keys, id);
+    if (pos == node->m_count || node->m_keys[pos] != id) {
+        return;
+    }
+    int moved = node->m_count - pos - 1;
+    memmove(node->m_keys + pos, node->m_keys + pos + 1, moved * sizeof(int32_t));
+    memmove(node->m_types + pos, node->m_types + pos + 1, moved);
+    memmove(node->m_states + pos, node->m_states + pos + 1, moved);
+    node->m_count--;
+    node->m_keys[node->m_count] = INT32_MAX;
+    m_size--;
+    if (node == m_root && node->m_count == 0) {
+        delete m_root;
+        m_root = nullptr;
+    }
+}
+
+// Give the child at slot at least one key above the minimum by borrowing from a sibling,
+// or merge it with a sibling when both are at the minimum
+void BTreeSwarm::fixChild(BTreeNode* parent, int slot) {
+    BTreeNode* child = parent->m_children[slot];
+    BTreeNode* left = (slot > 0) ? parent->m_children[slot - 1] : nullptr;
+    BTreeNode* right = (slot < parent->m_count) ? parent->m_children[slot + 1] : nullptr;
+
+    if (left != nullptr && left->m_count > BTREE_MIN_KEYS) {
+        // borrow the last key of the left sibling
+        memmove(child->m_keys + 1, child->m_keys, child->m_count * sizeof(int32_t));
+        if (child->m_leaf) {
+            memmove(child->m_types + 1, child->m_types, child->m_count);
+            memmove(child->m_states + 1, child->m_states, child->m_count);
+            child->m_keys[0] = left->m_keys[left->m_count - 1];
+            child->m_types[0] = left->m_types[left->m_count - 1];
+            child->m_states[0] = left->m_states[left->m_count - 1];
+            parent->m_keys[slot - 1] = child->m_keys[0];
+        }
+        else {
+            memmove(child->m_children + 1, child->m_children, (child->m_count + 1) * sizeof(BTreeNode*));
+            child->m_keys[0] = parent->m_keys[slot - 1];
+            child->m_children[0] = left->m_children[left->m_count];
+            parent->m_keys[slot - 1] = left->m_keys[left->m_count - 1];
+        }
+        child->m_count++;
+        left->m_count--;
+        left->pad();
+    }
+    else if (right != nullptr && right->m_count > BTREE_MIN_KEYS) {
+        // borrow the first key of the right sibling
+        if (child->m_leaf) {
+            child->m_keys[child->m_count] = right->m_keys[0];
+            child->m_types[child->m_count] = right->m_types[0];
+            child->m_states[child->m_count] = right->m_states[0];
+            memmove(right->m_types, right->m_types + 1, right->m_count - 1);
+            memmove(right->m_states, right->m_states + 1, right->m_count - 1);
+            parent->m_keys[slot] = right->m_keys[1];
+        }
+        else {
+            child->m_keys[child->m_count] = parent->m_keys[slot];
+            child->m_children[child->m_count + 1] = right->m_children[0];
+            parent->m_keys[slot] = right->m_keys[0];
+            memmove(right->m_children, right->m_children + 1, right->m_count * sizeof(BTreeNode*));
+        }
+        memmove(right->m_keys, right->m_keys + 1, (right->m_count - 1) * sizeof(int32_t));
+        child->m_count++;
+        right->m_count--;
+        right->pad();
+    }
+    else if (left != nullptr) {
+        mergeChildren(parent, slot - 1);
+    }
+    else {
+        mergeChildren(parent, slot);
+    }
+}
+
+// Append the child at slot + 1 to the child at slot and drop their separator from parent.
+// Both children hold BTREE_MIN_KEYS keys, so the result fits in one node.
+void BTreeSwarm::mergeChildren(BTreeNode* parent, int slot) {
+    BTreeNode* left = parent->m_children[slot];
+    BTreeNode* right = parent->m_children[slot + 1];
+    if (left->m_leaf) {
+        memcpy(left->m_keys + left->m_count, right->m_keys, right->m_count * sizeof(int32_t));
+        memcpy(left->m_types + left->m_count, right->m_types, right->m_count);
+        memcpy(left->m_states + left->m_count, right->m_states, right->m_count);
+        left->m_count += right->m_count;
+        left->m_next = right->m_next;
+    }
+    else {
+        left->m_keys[left->m_count] = parent->m_keys[slot];
+        memcpy(left->m_keys + left->m_count + 1, right->m_keys, right->m_count * sizeof(int32_t));
+        memcpy(left->m_children + left->m_count + 1, right->m_children, (right->m_count + 1) * sizeof(BTreeNode*));
+        left->m_count += right->m_count + 1;
+    }
+    delete right;
+
+    int moved = parent->m_count - slot - 1;
+    memmove(parent->m_keys + slot, parent->m_keys + slot + 1, moved * sizeof(int32_t));
+    memmove(parent->m_children + slot + 1, parent->m_children + slot + 2, moved * sizeof(BTreeNode*));
+    parent->m_count--;
+    parent->pad();
+}
+
+// Leaf whose range holds id, nullptr for an empty tree
+BTreeNode* BTreeSwarm::findLeaf(int id) const {
+    BTreeNode* node = m_root;
+    while (node != nullptr && !node->m_leaf) {
+        node = node->m_children[childSlot(node, id)];
+    }
+    return node;
+}
+
+// This function returns true if it finds the robot with id in the tree.
+bool BTreeSwarm::findBot(int id) const {
+    if (id < MINID || id > MAXID) {
+        return false;
+    }
+    BTreeNode* leaf = findLeaf(id);
+    if (leaf == nullptr) {
+        return false;
+    }
+    int pos = countLess(leaf->m_keys, id);
+    return pos < leaf->m_count && leaf->m_keys[pos] == id;
+}
+
+// Sets the state of the robot with id, returns false if there is no such robot.
+bool BTreeSwarm::setState(int id, STATE state) {
+    if (id < MINID || id > MAXID) {
+        return false;
+    }
+    BTreeNode* leaf = findLeaf(id);
+    if (leaf == nullptr) {
+        return false;
+    }
+    int pos = countLess(leaf->m_keys, id);
+    if (pos == leaf->m_count || leaf->m_keys[pos] != id) {
+        return false;
+    }
+    leaf->m_states[pos] = (uint8_t)state;
+    return true;
+}
+
+// Removes every DEAD robot. The survivors are read from the leaf chain and packed into new,
+// full leaves, and the inner levels are rebuilt on top of them in O(n).
+void BTreeSwarm::removeDead() {
+    vector<BTreeNode*> leaves;
+    BTreeNode* current = new BTreeNode(true);
+    int survivors = 0;
+    for (BTreeNode* leaf = findLeaf(MINID); leaf != nullptr; leaf = leaf->m_next) {
+        for (int i = 0; i < leaf->m_count; i++) {
+            if (leaf->m_states[i] == DEAD) {
+                continue;
+            }
+            if (current->m_count == BTREE_KEYS) {
+                leaves.push_back(current);
+                current = new BTreeNode(true);
+            }
+            current->m_keys[current->m_count] = leaf->m_keys[i];
+            current->m_types[current->m_count] = leaf->m_types[i];
+            current->m_states[current->m_count] = leaf->m_states[i];
+            current->m_count++;
+            survivors++;
+        }
+    }
+    leaves.push_back(current);
+    clear();
+    if (survivors == 0) {
+        delete current;
+        return;
+    }
+    // the last leaf may be short, even it out with the one before
+    if (leaves.size() > 1 && current->m_count < BTREE_MIN_KEYS) {
+        BTreeNode* previous = leaves[leaves.size() - 2];
+        int total = previous->m_count + current->m_count;
+        int moved = total / 2 - current->m_count;
+        memmove(current->m_keys + moved, current->m_keys, current->m_count * sizeof(int32_t));
+        memmove(current->m_types + moved, current->m_types, current->m_count);
+        memmove(current->m_states + moved, current->m_states, current->m_count);
+        int from = previous->m_count - moved;
+        memcpy(current->m_keys, previous->m_keys + from, moved * sizeof(int32_t));
+        memcpy(current->m_types, previous->m_types + from, moved);
+        memcpy(current->m_states, previous->m_states + from, moved);
+        previous->m_count = from;
+        current->m_count += moved;
+        previous->pad();
+    }
+    for (size_t i = 0; i + 1 < leaves.size(); i++) {
+        leaves[i]->m_next = leaves[i + 1];
+    }
+    m_size = survivors;
+    build(leaves);
+}
+
+// Stack inner levels on top of a level of nodes until one root is left. Each parent takes an
+// even share of the children, which keeps every node at or above the minimum.
+void BTreeSwarm::build(vector<BTreeNode*>& level) {
+    while (level.size() > 1) {
+        size_t parents = (level.size() + BTREE_KEYS) / (BTREE_KEYS + 1);
+        vector<BTreeNode*> above;
+        size_t next = 0;
+        for (size_t p = 0; p < parents; p++) {
+            size_t end = level.size() * (p + 1) / parents;
+            BTreeNode* parent = new BTreeNode(false);
+            for (size_t i = next; i < end; i++) {
+                parent->m_children[i - next] = level[i];
+                if (i > next) {
+                    // separator: the smallest ID under the child
+                    BTreeNode* leftmost = level[i];
+                    while (!leftmost->m_leaf) {
+                        leftmost = leftmost->m_children[0];
+                    }
+                    parent->m_keys[i - next - 1] = leftmost->m_keys[0];
+                }
+            }
+            parent->m_count = (int)(end - next) - 1;
+            next = end;
+            above.push_back(parent);
+        }
+        level.swap(above);
+    }
+    m_root = level.empty() ? nullptr : level[0];
+}
+
+// Prints every robot in ascending order of IDs, in the format of Swarm::listRobots.
+void BTreeSwarm::listRobots() const {
+    OutputSink out(cout);
+    listRobots(out);
+}
+
+// Writes the listing of listRobots() to out by following the leaf chain
+void BTreeSwarm::listRobots(OutputSink& out) const {
+    for (BTreeNode* leaf = findLeaf(MINID); leaf != nullptr; leaf = leaf->m_next) {
+        for (int i = 0; i < leaf->m_count; i++) {
+            Swarm::writeRobot(leaf->m_keys[i], static_cast<STATE>(leaf->m_states[i]), static_cast<ROBOTTYPE>(leaf->m_types[i]), out);
+        }
+    }
+}
+
+// Number of robots in the tree
+int BTreeSwarm::size() const {
+    return m_size;
+}
+
+// Display tree: leaves as [id id ...], inner nodes as (child key child ...)
+void BTreeSwarm::dumpTree() const {
+    dump(m_root);
+}
+
+// Display tree
+void BTreeSwarm::dump(const BTreeNode* node) const {
+    if (node == nullptr) {
+        return;
+    }
+    if (node->m_leaf) {
+        cout << "[";
+        for (int i = 0; i < node->m_count; i++) {
+            cout << (i ? " " : "") << node->m_keys[i];
+        }
+        cout << "]";
+        return;
+    }
+    cout << "(";
+    for (int i = 0; i <= node->m_count; i++) {
+        dump(node->m_children[i]);
+        if (i < node->m_count) {
+            cout << " " << node->m_keys[i] << " ";
+        }
+    }
+    cout << ")";
+}
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef BTREESWARM_H
+#define BTREESWARM_H
+#include "swarm.h"
+#include <cstdint>
+#define BTREE_KEYS 32 //keys per node, two cache lines of IDs
+#define BTREE_MIN_KEYS 15 //fewest keys in a node other than the root
+
+// One B+-tree node. Unused key slots hold INT32_MAX so the in-node search can always compare
+// all BTREE_KEYS keys with SIMD instructions and count the smaller ones.
+// In an inner node m_children[i] holds the IDs below m_keys[i] and m_children[i + 1] the IDs
+// from m_keys[i] up; leaves keep the robots and are chained in ID order through m_next.
+struct alignas(64) BTreeNode {
+    int32_t m_keys[BTREE_KEYS];
+    int m_count;
+    bool m_leaf;
+    BTreeNode* m_next;
+    BTreeNode* m_children[BTREE_KEYS + 1];//inner nodes only
+    uint8_t m_types[BTREE_KEYS];//leaves only
+    uint8_t m_states[BTREE_KEYS];//leaves only
+
+    explicit BTreeNode(bool leaf);
+    void pad();//refill the unused key slots with INT32_MAX
+};
+
+// Swarm backend built as a B+-tree: many sorted IDs per node mean one or two cache misses per
+// level instead of one per binary level. Offers the interface of Swarm; IDs must lie in
+// MINID..MAXID.
+class BTreeSwarm {
+public:
+    friend class Grader;
+    friend class Tester;
+    BTreeSwarm();
+    ~BTreeSwarm();
+    BTreeSwarm(const BTreeSwarm&) = delete;//the destructor frees every node, a shallow copy would free them twice
+    BTreeSwarm& operator=(const BTreeSwarm&) = delete;
+    void insert(const Robot& robot);
+    void clear();
+    void remove(int id);
+    void dumpTree() const;
+    void listRobots() const;
+    void listRobots(OutputSink& out) const;//same text as listRobots(), written to out
+    bool setState(int id, STATE state);
+    void removeDead();//removes all dead robots from the tree
+    bool findBot(int id) const;//returns true if the bot is in tree
+    int size() const;
+
+private:
+    BTreeNode* m_root;
+    int m_size;
+
+    static int countLess(const int32_t* keys, int id);
+    static int childSlot(const BTreeNode* node, int id);
+    BTreeNode* findLeaf(int id) const;
+    void splitChild(BTreeNode* parent, int slot);
+    void fixChild(BTreeNode* parent, int slot);
+    void mergeChildren(BTreeNode* parent, int slot);
+    void build(vector<BTreeNode*>& level);
+    void clearFromNode(BTreeNode* node);
+    void dump(const BTreeNode* node) const;
+};
+#endif
@@ -0,0 +1,294 @@
+#include "compactswarm.h"
+#include "outputsink.h"
+
+// The node this reference points to
+const CompactRobot& CompactRobotRef::node() const {
+    return m_swarm->m_nodes[m_index];
+}
+
+// Constructor, performs the required initializations.
+CompactSwarm::CompactSwarm() {
+    m_root = NIL_INDEX;
+    m_freeList = NIL_INDEX;
+    m_size = 0;
+}
+
+// Inserts a robot, following the same rules as Swarm::insert. IDs outside MINID..MAXID cannot be
+// packed and are ignored, as are duplicates.
+void CompactSwarm::insert(const Robot& robot) {
+    if (robot.getID() < MINID || robot.getID() > MAXID) {
+        return;
+    }
+    m_root = insertRobot(robot, m_root);
+}
+
+// Insert robot using recursion function. Nodes are addressed by index because the array may
+// grow, and move, while the recursion is in progress.
+uint32_t CompactSwarm::insertRobot(const Robot& robot, uint32_t index) {
+    if (index == NIL_INDEX) {
+        return allocate(robot);
+    }
+    int id = m_nodes[index].id();
+    if (robot.getID() < id) {
+        uint32_t left = insertRobot(robot, m_nodes[index].m_left);
+        m_nodes[index].m_left = left;
+    }
+    else if (robot.getID() > id) {
+        uint32_t right = insertRobot(robot, m_nodes[index].m_right);
+        m_nodes[index].m_right = right;
+    }
+    else {
+        return index;
+    }
+    updateHeight(index);
+    return rebalance(index);
+}
+
+// Deallocates all nodes and makes it an empty tree.
+void CompactSwarm::clear() {
+    m_nodes.clear();
+    m_root = NIL_INDEX;
+    m_freeList = NIL_INDEX;
+    m_size = 0;
+}
+
+// Removes the robot with id, retracing heights and balance along the search path.
+void CompactSwarm::remove(int id) {
+    m_root = deleteRobot(m_root, id);
+}
+
+// Delete a robot using recursion
+uint32_t CompactSwarm::deleteRobot(uint32_t index, int id) {
+    if (index == NIL_INDEX) {
+        return index;
+    }
+    CompactRobot& aBot = m_nodes[index];
+    if (id < aBot.id()) {
+        aBot.m_left = deleteRobot(aBot.m_left, id);
+    }
+    else if (id > aBot.id()) {
+        aBot.m_right = deleteRobot(aBot.m_right, id);
+    }
+    else if (aBot.m_left == NIL_INDEX || aBot.m_right == NIL_INDEX) {
+        // Case 1 and 2: at most one child takes the place of the node
+        uint32_t child = (aBot.m_left == NIL_INDEX) ? aBot.m_right : aBot.m_left;
+        release(index);
+        return child;
+    }
+    else {
+        // Case 3: two children, the successor's payload moves up
+        uint32_t temp = aBot.m_right;
+        while (m_nodes[temp].m_left != NIL_INDEX) {
+            temp = m_nodes[temp].m_left;
+        }
+        const CompactRobot& successor = m_nodes[temp];
+        aBot.pack(successor.id(), aBot.height(), successor.type(), successor.state());
+        aBot.m_right = deleteRobot(aBot.m_right, successor.id());
+    }
+    updateHeight(index);
+    return rebalance(index);
+}
+
+// Height of the node at index, -1 for a missing node
+int CompactSwarm::height(uint32_t index) const {
+    return (index == NIL_INDEX) ? -1 : m_nodes[index].height();
+}
+
+// Recomputes the height of the node at index from its children.
+void CompactSwarm::updateHeight(uint32_t index) {
+    int heightLeft = height(m_nodes[index].m_left);
+    int heightRight = height(m_nodes[index].m_right);
+    m_nodes[index].setHeight((heightLeft > heightRight ? heightLeft : heightRight) + 1);
+}
+
+// Left height minus right height of the node at index
+int CompactSwarm::checkImbalance(uint32_t index) const {
+    if (index == NIL_INDEX) {
+        return -1;
+    }
+    return height(m_nodes[index].m_left) - height(m_nodes[index].m_right);
+}
+
+// Restores the AVL property at index, see Swarm::rebalance
+uint32_t CompactSwarm::rebalance(uint32_t index) {
+    int balance = checkImbalance(index);
+    if (balance > 1) {
+        if (checkImbalance(m_nodes[index].m_left) < 0) {
+            m_nodes[index].m_left = singleLeftRotation(m_nodes[index].m_left);
+        }
+        return singleRightRotation(index);
+    }
+    if (balance < -1) {
+        if (checkImbalance(m_nodes[index].m_right) > 0) {
+            m_nodes[index].m_right = singleRightRotation(m_nodes[index].m_right);
+        }
+        return singleLeftRotation(index);
+    }
+    return index;
+}
+
+// Single right rotation
+uint32_t CompactSwarm::singleRightRotation(uint32_t index) {
+    uint32_t temp = m_nodes[index].m_left;
+    m_nodes[index].m_left = m_nodes[temp].m_right;
+    m_nodes[temp].m_right = index;
+    updateHeight(index);
+    updateHeight(temp);
+    return temp;
+}
+
+// Single left rotation
+uint32_t CompactSwarm::singleLeftRotation(uint32_t index) {
+    uint32_t temp = m_nodes[index].m_right;
+    m_nodes[index].m_right = m_nodes[temp].m_left;
+    m_nodes[temp].m_left = index;
+    updateHeight(index);
+    updateHeight(temp);
+    return temp;
+}
+
+// Takes a slot from the free list, or appends one, for a new leaf
+uint32_t CompactSwarm::allocate(const Robot& robot) {
+    uint32_t index = m_freeList;
+    if (index != NIL_INDEX) {
+        m_freeList = m_nodes[index].m_left;
+    }
+    else {
+        index = (uint32_t)m_nodes.size();
+        m_nodes.push_back(CompactRobot());
+    }
+    m_nodes[index].m_left = NIL_INDEX;
+    m_nodes[index].m_right = NIL_INDEX;
+    m_nodes[index].pack(robot.getID(), DEFAULT_HEIGHT, robot.getType(), robot.getState());
+    m_size++;
+    return index;
+}
+
+// Puts a slot on the free list
+void CompactSwarm::release(uint32_t index) {
+    m_nodes[index].m_left = m_freeList;
+    m_freeList = index;
+    m_size--;
+}
+
+// Prints every robot in ascending order of IDs, in the format of Swarm::listRobots.
+void CompactSwarm::listRobots() const {
+    OutputSink out(cout);
+    listRobots(out);
+}
+
+// Writes the listing of listRobots() to out
+void CompactSwarm::listRobots(OutputSink& out) const {
+    traverseTree(m_root, out);
+}
+
+// Traverse the whole tree and write one line per robot to out
+void CompactSwarm::traverseTree(uint32_t index, OutputSink& out) const {
+    if (index != NIL_INDEX) {
+        traverseTree(m_nodes[index].m_left, out);
+        const CompactRobot& aBot = m_nodes[index];
+        Swarm::writeRobot(aBot.id(), aBot.state(), aBot.type(), out);
+        traverseTree(m_nodes[index].m_right, out);
+    }
+}
+
+// Sets the state of the robot with id, returns false if there is no such robot.
+bool CompactSwarm::setState(int id, STATE state) {
+    uint32_t index = findThisBot(id);
+    if (index == NIL_INDEX) {
+        return false;
+    }
+    m_nodes[index].setState(state);
+    return true;
+}
+
+// Removes every DEAD robot by relinking the survivors into a balanced tree, see Swarm::removeIf
+void CompactSwarm::removeDead() {
+    vector<uint32_t> survivors;
+    int before = m_size;
+    collectSurvivors(m_root, survivors);
+    if (m_size != before) {
+        m_root = buildBalanced(survivors, 0, (int)survivors.size() - 1);
+    }
+}
+
+// Visit the tree in order, keep the ALIVE robots in survivors and release the others
+void CompactSwarm::collectSurvivors(uint32_t index, vector<uint32_t>& survivors) {
+    if (index == NIL_INDEX) {
+        return;
+    }
+    collectSurvivors(m_nodes[index].m_left, survivors);
+    uint32_t right = m_nodes[index].m_right;
+    if (m_nodes[index].state() == DEAD) {
+        release(index);
+    }
+    else {
+        survivors.push_back(index);
+    }
+    collectSurvivors(right, survivors);
+}
+
+// Link survivors[low..high] into a perfectly balanced tree and return its root
+uint32_t CompactSwarm::buildBalanced(vector<uint32_t>& survivors, int low, int high) {
+    if (low > high) {
+        return NIL_INDEX;
+    }
+    int middle = low + (high - low) / 2;
+    uint32_t index = survivors[middle];
+    m_nodes[index].m_left = buildBalanced(survivors, low, middle - 1);
+    m_nodes[index].m_right = buildBalanced(survivors, middle + 1, high);
+    updateHeight(index);
+    return index;
+}
+
+// This function returns true if it finds the node with id in the tree, otherwise it returns false.
+bool CompactSwarm::findBot(int id) const {
+    return findThisBot(id) != NIL_INDEX;
+}
+
+// Index of the robot with id, NIL_INDEX if it is not in the tree
+uint32_t CompactSwarm::findThisBot(int id) const {
+    uint32_t index = m_root;
+    while (index != NIL_INDEX) {
+        int key = m_nodes[index].id();
+        if (key == id) {
+            return index;
+        }
+        index = (key < id) ? m_nodes[index].m_right : m_nodes[index].m_left;
+    }
+    return NIL_INDEX;
+}
+
+// Reference to the root node, equal to nullptr for an empty tree
+CompactRobotRef CompactSwarm::getRoot() const {
+    return CompactRobotRef(this, m_root);
+}
+
+// Number of robots in the tree
+int CompactSwarm::size() const {
+    return m_size;
+}
+
+// Heap bytes held by the node array divided by the number of robots
+double CompactSwarm::bytesPerRobot() const {
+    if (m_size == 0) {
+        return 0.0;
+    }
+    return (double)(m_nodes.capacity() * sizeof(CompactRobot)) / m_size;
+}
+
+// Display tree in the format of Swarm::dumpTree
+void CompactSwarm::dumpTree() const {
+    dump(m_root);
+}
+
+// Display tree
+void CompactSwarm::dump(uint32_t index) const {
+    if (index != NIL_INDEX) {
+        cout << "(";
+        dump(m_nodes[index].m_left);//first visit the left child
+        cout << m_nodes[index].id() << ":" << m_nodes[index].height();//second visit the node itself
+        dump(m_nodes[index].m_right);//third visit the right child
+        cout << ")";
+    }
+}
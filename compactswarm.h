@@ -0,0 +1,106 @@
+#pragma once
+#ifndef COMPACTSWARM_H
+#define COMPACTSWARM_H
+#include "swarm.h"
+#include <cstdint>
+#include <cstddef>
+#define NIL_INDEX 0xFFFFFFFFu //index of a missing child
+#define COMPACT_ID_BITS 17 //MAXID - MINID fits in 17 bits
+#define COMPACT_HEIGHT_BITS 6
+#define COMPACT_TYPE_BITS 3
+
+// A 12 byte tree node. Children are 32-bit indices into the node array of the owning
+// CompactSwarm and the ID (as an offset from MINID), height, type and state share one word:
+// bits 0-16 ID - MINID, bits 17-22 height, bits 23-25 type, bit 26 state.
+struct CompactRobot {
+    uint32_t m_left;
+    uint32_t m_right;
+    uint32_t m_packed;
+
+    int id() const { return MINID + (int)(m_packed & ((1u << COMPACT_ID_BITS) - 1)); }
+    int height() const { return (int)((m_packed >> COMPACT_ID_BITS) & ((1u << COMPACT_HEIGHT_BITS) - 1)); }
+    ROBOTTYPE type() const {
+        return static_cast<ROBOTTYPE>((m_packed >> (COMPACT_ID_BITS + COMPACT_HEIGHT_BITS)) & ((1u << COMPACT_TYPE_BITS) - 1));
+    }
+    STATE state() const {
+        return static_cast<STATE>((m_packed >> (COMPACT_ID_BITS + COMPACT_HEIGHT_BITS + COMPACT_TYPE_BITS)) & 1u);
+    }
+    void pack(int id, int height, ROBOTTYPE type, STATE state) {
+        m_packed = (uint32_t)(id - MINID) | ((uint32_t)height << COMPACT_ID_BITS) |
+            ((uint32_t)type << (COMPACT_ID_BITS + COMPACT_HEIGHT_BITS)) |
+            ((uint32_t)state << (COMPACT_ID_BITS + COMPACT_HEIGHT_BITS + COMPACT_TYPE_BITS));
+    }
+    void setHeight(int height) { pack(id(), height, type(), state()); }
+    void setState(STATE state) { pack(id(), height(), type(), state); }
+};
+
+class CompactSwarm;
+
+// Read-only view of one node of a CompactSwarm offering the getters of Robot, so code written
+// against Robot pointers (getID, getLeft, comparisons with nullptr) works on compact nodes.
+class CompactRobotRef {
+public:
+    CompactRobotRef(const CompactSwarm* swarm, uint32_t index) : m_swarm(swarm), m_index(index) {}
+    int getID() const { return node().id(); }
+    STATE getState() const { return node().state(); }
+    string getStateStr() const { return Robot(getID(), getType(), getState()).getStateStr(); }
+    ROBOTTYPE getType() const { return node().type(); }
+    string getTypeStr() const { return Robot(getID(), getType(), getState()).getTypeStr(); }
+    int getHeight() const { return node().height(); }
+    CompactRobotRef getLeft() const { return CompactRobotRef(m_swarm, node().m_left); }
+    CompactRobotRef getRight() const { return CompactRobotRef(m_swarm, node().m_right); }
+    const CompactRobotRef* operator->() const { return this; }
+    bool operator==(std::nullptr_t) const { return m_index == NIL_INDEX; }
+    bool operator!=(std::nullptr_t) const { return m_index != NIL_INDEX; }
+
+private:
+    const CompactSwarm* m_swarm;
+    uint32_t m_index;
+    const CompactRobot& node() const;
+};
+
+// Same interface and AVL rules as Swarm, with every node stored in one contiguous array of
+// CompactRobot instead of separately allocated Robot objects. Removed slots are chained on a
+// free list through m_left. IDs must lie in MINID..MAXID.
+class CompactSwarm {
+public:
+    friend class Grader;
+    friend class Tester;
+    friend class CompactRobotRef;
+    CompactSwarm();
+    void insert(const Robot& robot);
+    void clear();
+    void remove(int id);
+    void dumpTree() const;
+    void listRobots() const;
+    void listRobots(OutputSink& out) const;//same text as listRobots(), written to out
+    bool setState(int id, STATE state);
+    void removeDead();//removes all dead robots from the tree
+    bool findBot(int id) const;//returns true if the bot is in tree
+    CompactRobotRef getRoot() const;
+    int size() const;//number of robots in the tree
+    double bytesPerRobot() const;//heap bytes of the node array per stored robot
+
+private:
+    vector<CompactRobot> m_nodes;
+    uint32_t m_root;
+    uint32_t m_freeList;
+    int m_size;
+
+    int height(uint32_t index) const;
+    void updateHeight(uint32_t index);
+    int checkImbalance(uint32_t index) const;
+    uint32_t rebalance(uint32_t index);
+    uint32_t singleRightRotation(uint32_t index);
+    uint32_t singleLeftRotation(uint32_t index);
+    uint32_t allocate(const Robot& robot);
+    void release(uint32_t index);
+    uint32_t insertRobot(const Robot& robot, uint32_t index);
+    uint32_t deleteRobot(uint32_t index, int id);
+    uint32_t findThisBot(int id) const;
+    void collectSurvivors(uint32_t index, vector<uint32_t>& survivors);
+    uint32_t buildBalanced(vector<uint32_t>& survivors, int low, int high);
+    void traverseTree(uint32_t index, OutputSink& out) const;
+    void dump(uint32_t index) const;
+};
+#endif
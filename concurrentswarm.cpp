@@ -0,0 +1,120 @@
+#include "concurrentswarm.h"
+#include "outputsink.h"
+
+// Constructor, performs the required initializations.
+ConcurrentSwarm::ConcurrentSwarm() : m_waitingWriters(0) {
+}
+
+// Waits at the gate only while a writer is announced, then takes the tree lock shared
+ConcurrentSwarm::ReadLock::ReadLock(const ConcurrentSwarm& swarm) : m_swarm(swarm) {
+    if (m_swarm.m_waitingWriters.load() > 0) {
+        lock_guard<mutex> gate(m_swarm.m_writerGate);
+    }
+    m_swarm.m_treeLock.lock_shared();
+}
+
+// Releases the shared hold
+ConcurrentSwarm::ReadLock::~ReadLock() {
+    m_swarm.m_treeLock.unlock_shared();
+}
+
+// Announces the writer, closes the gate to new readers and waits for the current ones
+ConcurrentSwarm::WriteLock::WriteLock(ConcurrentSwarm& swarm) : m_swarm(swarm) {
+    m_swarm.m_waitingWriters++;
+    m_swarm.m_writerGate.lock();
+    m_swarm.m_treeLock.lock();
+}
+
+// Releases the tree lock and reopens the gate
+ConcurrentSwarm::WriteLock::~WriteLock() {
+    m_swarm.m_treeLock.unlock();
+    m_swarm.m_writerGate.unlock();
+    m_swarm.m_waitingWriters--;
+}
+
+// Stripe guarding the state of the robot with id
+mutex& ConcurrentSwarm::stateLock(int id) const {
+    return m_stateLocks[(unsigned int)id % STATE_LOCK_STRIPES];
+}
+
+// Inserts a robot under the exclusive tree lock
+void ConcurrentSwarm::insert(const Robot& robot) {
+    WriteLock tree(*this);
+    m_swarm.insert(robot);
+}
+
+// Removes every robot under the exclusive tree lock
+void ConcurrentSwarm::clear() {
+    WriteLock tree(*this);
+    m_swarm.clear();
+}
+
+// Removes a robot under the exclusive tree lock
+void ConcurrentSwarm::remove(int id) {
+    WriteLock tree(*this);
+    m_swarm.remove(id);
+}
+
+// Displays the tree; IDs and heights only change under the exclusive lock
+void ConcurrentSwarm::dumpTree() const {
+    ReadLock tree(*this);
+    m_swarm.dumpTree();
+}
+
+// Lists the robots with every state stripe held, so no state changes while printing
+void ConcurrentSwarm::listRobots() const {
+    OutputSink out(cout);
+    listRobots(out);
+}
+
+// Writes the listing of listRobots() to out under the same locks
+void ConcurrentSwarm::listRobots(OutputSink& out) const {
+    ReadLock tree(*this);
+    for (int i = 0; i < STATE_LOCK_STRIPES; i++) {
+        m_stateLocks[i].lock();
+    }
+    m_swarm.listRobots(out);
+    for (int i = STATE_LOCK_STRIPES - 1; i >= 0; i--) {
+        m_stateLocks[i].unlock();
+    }
+}
+
+// Sets the state of a robot. The shared tree lock keeps the node in place and the stripe
+// orders writers of the same robot; readers and other robots are not held up.
+bool ConcurrentSwarm::setState(int id, STATE state) {
+    ReadLock tree(*this);
+    lock_guard<mutex> stripe(stateLock(id));
+    return m_swarm.setState(id, state);
+}
+
+// Removes the DEAD robots under the exclusive tree lock
+void ConcurrentSwarm::removeDead() {
+    if (m_swarm.countByState(DEAD) == 0) {
+        return;//no need to stop the readers
+    }
+    WriteLock tree(*this);
+    m_swarm.removeDead();
+}
+
+// Looks a robot up under the shared tree lock; it reads no state
+bool ConcurrentSwarm::findBot(int id) const {
+    ReadLock tree(*this);
+    return m_swarm.findBot(id);
+}
+
+// Reads the state counter, which setState updates atomically, without any lock
+int ConcurrentSwarm::countByState(STATE state) const {
+    return m_swarm.countByState(state);
+}
+
+// Counts in a range of IDs under the shared tree lock; types only change with the tree
+int ConcurrentSwarm::countByType(ROBOTTYPE type, int idLo, int idHi) const {
+    ReadLock tree(*this);
+    return m_swarm.countByType(type, idLo, idHi);
+}
+
+// Builds or drops the direct-addressed ID index under the exclusive tree lock
+void ConcurrentSwarm::enableIndex(bool enable) {
+    WriteLock tree(*this);
+    m_swarm.enableIndex(enable);
+}
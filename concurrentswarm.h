@@ -0,0 +1,67 @@
+#pragma once
+#ifndef CONCURRENTSWARM_H
+#define CONCURRENTSWARM_H
+#include "swarm.h"
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#define STATE_LOCK_STRIPES 64 //mutexes guarding Robot::m_state, chosen by ID
+
+// Swarm that many threads may call at once.
+//  - findBot and dumpTree take the tree lock shared, so readers never block each other.
+//  - setState takes the tree lock shared as well, plus one of STATE_LOCK_STRIPES mutexes picked
+//    by ID. It never excludes readers, and only excludes setState calls on the same stripe.
+//  - listRobots reads every state, so it takes the tree lock shared and all stripes.
+//  - countByState reads an atomic counter and takes no lock; countByType takes the tree lock
+//    shared since it descends the tree.
+//  - insert, remove, removeDead and clear change links and heights along the path, and
+//    rotations can reach the root, so they take the tree lock exclusively, for O(log n)
+//    (O(n) for removeDead).
+// shared_mutex may let a steady stream of readers starve a writer, so writers announce
+// themselves first and hold a gate that new readers pass through only while no writer waits.
+class ConcurrentSwarm {
+public:
+    friend class Grader;
+    friend class Tester;
+    ConcurrentSwarm();
+    void insert(const Robot& robot);
+    void clear();
+    void remove(int id);
+    void dumpTree() const;
+    void listRobots() const;
+    void listRobots(OutputSink& out) const;//same text as listRobots(), written to out
+    bool setState(int id, STATE state);
+    void removeDead();//removes all dead robots from the tree
+    bool findBot(int id) const;//returns true if the bot is in tree
+    int countByState(STATE state) const;//lock-free, see Swarm::countByState
+    int countByType(ROBOTTYPE type, int idLo, int idHi) const;
+    void enableIndex(bool enable);//see Swarm::enableIndex
+
+private:
+    Swarm m_swarm;
+    mutable shared_mutex m_treeLock;
+    mutable mutex m_writerGate;//held by a writer from before it waits until it is done
+    mutable atomic<int> m_waitingWriters;
+    mutable mutex m_stateLocks[STATE_LOCK_STRIPES];
+
+    mutex& stateLock(int id) const;
+
+    // Shared hold on the tree lock that gives way to waiting writers
+    class ReadLock {
+    public:
+        explicit ReadLock(const ConcurrentSwarm& swarm);
+        ~ReadLock();
+    private:
+        const ConcurrentSwarm& m_swarm;
+    };
+
+    // Exclusive hold on the tree lock
+    class WriteLock {
+    public:
+        explicit WriteLock(ConcurrentSwarm& swarm);
+        ~WriteLock();
+    private:
+        ConcurrentSwarm& m_swarm;
+    };
+};
+#endif
@@ -0,0 +1,204 @@
+#include "frozenswarm.h"
+#include "outputsink.h"
+#include <climits>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FROZEN_X86 1
+#include <immintrin.h>
+#endif
+
+// Keys in one cache line; prefetching slot 16k fetches the descendants of k four levels down
+const size_t KEYS_PER_LINE = 64 / sizeof(int32_t);
+
+// Empty snapshot
+FrozenSwarm::FrozenSwarm() {
+    m_size = 0;
+    m_levels = 0;
+    m_ids.assign(1, INT32_MAX);
+}
+
+// Copy the robots of swarm into the Eytzinger arrays. The robots are collected in order with
+// an explicit stack and placed by an in-order walk of the implicit tree, O(n) in total.
+FrozenSwarm::FrozenSwarm(const Swarm& swarm) {
+    vector<const Robot*> sorted;
+    vector<const Robot*> stack;
+    const Robot* aBot = swarm.m_root;
+    while (aBot != nullptr || !stack.empty()) {
+        while (aBot != nullptr) {
+            stack.push_back(aBot);
+            aBot = aBot->getLeft();
+        }
+        aBot = stack.back();
+        stack.pop_back();
+        sorted.push_back(aBot);
+        aBot = aBot->getRight();
+    }
+
+    m_size = (int)sorted.size();
+    m_levels = 0;
+    while (((size_t)1 << m_levels) - 1 < sorted.size()) {
+        m_levels++;
+    }
+    size_t slots = ((size_t)1 << m_levels);
+    m_ids.assign(slots, INT32_MAX);
+    m_types.assign(slots, DEFAULT_TYPE);
+    m_states.assign(slots, DEFAULT_STATE);
+    fill(sorted, 0, 1);
+}
+
+// Place sorted[next..] into the subtree rooted at slot k in order, padding with INT32_MAX once
+// the robots run out. Returns the index of the next robot to place.
+size_t FrozenSwarm::fill(const vector<const Robot*>& sorted, size_t next, size_t k) {
+    if (k >= m_ids.size()) {
+        return next;
+    }
+    next = fill(sorted, next, 2 * k);
+    if (next < sorted.size()) {
+        m_ids[k] = sorted[next]->getID();
+        m_types[k] = (uint8_t)sorted[next]->getType();
+        m_states[k] = (uint8_t)sorted[next]->getState();
+    }
+    next++;
+    return fill(sorted, next, 2 * k + 1);
+}
+
+// Slot of the smallest ID not less than id, 0 if there is none. The descent has no data
+// dependent branch: each level adds the comparison result to the child index.
+size_t FrozenSwarm::lowerBound(int id) const {
+    size_t k = 1;
+    for (int level = 0; level < m_levels; level++) {
+        if (k * KEYS_PER_LINE < m_ids.size()) {
+            __builtin_prefetch(m_ids.data() + k * KEYS_PER_LINE);
+        }
+        k = 2 * k + (m_ids[k] < id);
+    }
+    // strip the trailing right turns and the left turn above them
+    return k >> __builtin_ffsll(~(long long)k);
+}
+
+// True when slot k holds id. IDs outside MINID..MAXID are never in the snapshot; checking them
+// here also keeps INT32_MAX from matching the padding.
+bool FrozenSwarm::hit(size_t k, int id) const {
+    return k != 0 && id >= MINID && id <= MAXID && m_ids[k] == id;
+}
+
+// This function returns true if it finds the robot with id in the snapshot.
+bool FrozenSwarm::findBot(int id) const {
+    return hit(lowerBound(id), id);
+}
+
+// Look up count IDs at once; found[i] is set to findBot(ids[i]). Uses an AVX2 gather kernel
+// when the processor has it, an SSE2 kernel on other x86 processors and scalar code otherwise.
+void FrozenSwarm::findBots(const int* ids, bool* found, size_t count) const {
+#ifdef FROZEN_X86
+    if (__builtin_cpu_supports("avx2")) {
+        findBotsAVX2(ids, found, count);
+    }
+    else {
+        findBotsSSE2(ids, found, count);
+    }
+#else
+    findBotsScalar(ids, found, count);
+#endif
+}
+
+// One search after the other
+void FrozenSwarm::findBotsScalar(const int* ids, bool* found, size_t count) const {
+    for (size_t i = 0; i < count; i++) {
+        found[i] = findBot(ids[i]);
+    }
+}
+
+#ifdef FROZEN_X86
+// Four searches in lockstep: the loads are scalar but independent, so their misses overlap,
+// and the comparisons and index updates run in one SSE2 register.
+void FrozenSwarm::findBotsSSE2(const int* ids, bool* found, size_t count) const {
+    const int32_t* keys = m_ids.data();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i target = _mm_loadu_si128((const __m128i*)(ids + i));
+        __m128i k = _mm_set1_epi32(1);
+        alignas(16) int32_t lanes[4];
+        for (int level = 0; level < m_levels; level++) {
+            _mm_store_si128((__m128i*)lanes, k);
+            __m128i values = _mm_set_epi32(keys[lanes[3]], keys[lanes[2]], keys[lanes[1]], keys[lanes[0]]);
+            __m128i less = _mm_cmplt_epi32(values, target);//-1 where the key is smaller
+            k = _mm_sub_epi32(_mm_add_epi32(k, k), less);
+        }
+        _mm_store_si128((__m128i*)lanes, k);
+        for (int lane = 0; lane < 4; lane++) {
+            size_t slot = (size_t)lanes[lane];
+            found[i + lane] = hit(slot >> __builtin_ffsll(~(long long)slot), ids[i + lane]);
+        }
+    }
+    findBotsScalar(ids + i, found + i, count - i);
+}
+
+// Eight searches in lockstep with one gather per level
+__attribute__((target("avx2")))
+void FrozenSwarm::findBotsAVX2(const int* ids, bool* found, size_t count) const {
+    const int32_t* keys = m_ids.data();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i target = _mm256_loadu_si256((const __m256i*)(ids + i));
+        __m256i k = _mm256_set1_epi32(1);
+        for (int level = 0; level < m_levels; level++) {
+            __m256i values = _mm256_i32gather_epi32(keys, k, 4);
+            __m256i less = _mm256_cmpgt_epi32(target, values);//-1 where the key is smaller
+            k = _mm256_sub_epi32(_mm256_add_epi32(k, k), less);
+        }
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256((__m256i*)lanes, k);
+        for (int lane = 0; lane < 8; lane++) {
+            size_t slot = (size_t)lanes[lane];
+            found[i + lane] = hit(slot >> __builtin_ffsll(~(long long)slot), ids[i + lane]);
+        }
+    }
+    findBotsScalar(ids + i, found + i, count - i);
+}
+#else
+// No SIMD kernels outside x86
+void FrozenSwarm::findBotsSSE2(const int* ids, bool* found, size_t count) const {
+    findBotsScalar(ids, found, count);
+}
+
+// No SIMD kernels outside x86
+void FrozenSwarm::findBotsAVX2(const int* ids, bool* found, size_t count) const {
+    findBotsScalar(ids, found, count);
+}
+#endif
+
+// Prints every robot in ascending order of IDs, in the format of Swarm::listRobots
+void FrozenSwarm::listRobots() const {
+    OutputSink out(cout);
+    listRobots(out);
+}
+
+// Writes the listing of listRobots() to out. The implicit tree is walked in order without
+// recursion or a stack.
+void FrozenSwarm::listRobots(OutputSink& out) const {
+    size_t slots = m_ids.size();
+    size_t k = 1;
+    while (2 * k < slots) {
+        k = 2 * k;
+    }
+    for (int printed = 0; printed < m_size; printed++) {
+        Swarm::writeRobot(m_ids[k], static_cast<STATE>(m_states[k]), static_cast<ROBOTTYPE>(m_types[k]), out);
+        if (2 * k + 1 < slots) {
+            k = 2 * k + 1;
+            while (2 * k < slots) {
+                k = 2 * k;
+            }
+        }
+        else {
+            while (k & 1) {
+                k >>= 1;
+            }
+            k >>= 1;
+        }
+    }
+}
+
+// Number of robots in the snapshot
+int FrozenSwarm::size() const {
+    return m_size;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef FROZENSWARM_H
+#define FROZENSWARM_H
+#include "swarm.h"
+#include <cstdint>
+#include <cstddef>
+
+// Immutable, read-only snapshot of a Swarm for lookup-heavy traffic. IDs are stored in
+// Eytzinger (BFS) order in one array, with the type and state of each robot in parallel arrays.
+// The array is padded to a complete tree of 2^levels - 1 slots with INT32_MAX, so every search
+// takes exactly `levels` branchless steps and many searches can run in SIMD lanes side by side.
+// The padding is never reported as a robot: IDs outside MINID..MAXID are not found.
+class FrozenSwarm {
+public:
+    friend class Grader;
+    friend class Tester;
+    FrozenSwarm();
+    explicit FrozenSwarm(const Swarm& swarm);//O(n) copy of the live tree
+    bool findBot(int id) const;//returns true if the bot is in the snapshot
+    void findBots(const int* ids, bool* found, size_t count) const;//batched findBot
+    void listRobots() const;//same output as Swarm::listRobots
+    void listRobots(OutputSink& out) const;//same text as listRobots(), written to out
+    int size() const;
+
+private:
+    vector<int32_t> m_ids;//1-based Eytzinger order, m_ids[0] unused
+    vector<uint8_t> m_types;
+    vector<uint8_t> m_states;
+    int m_size;//robots in the snapshot
+    int m_levels;//levels of the padded complete tree
+
+    size_t fill(const vector<const Robot*>& sorted, size_t next, size_t k);
+    size_t lowerBound(int id) const;
+    bool hit(size_t k, int id) const;
+    void findBotsScalar(const int* ids, bool* found, size_t count) const;
+    void findBotsSSE2(const int* ids, bool* found, size_t count) const;
+    void findBotsAVX2(const int* ids, bool* found, size_t count) const;
+};
+#endif
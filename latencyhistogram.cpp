@@ -0,0 +1,154 @@
+#include "latencyhistogram.h"
+#include <cmath>
+
+// Shard of the current thread, handed out round-robin the first time a thread records
+static atomic<int> g_nextShard(0);
+static thread_local int t_shard = -1;
+
+// Power-of-two magnitude where values stop having a bucket each
+const int LATENCY_LINEAR_BITS = 5;//log2(LATENCY_SUB_BUCKETS)
+
+// Empty histogram
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+// Forget every value
+void LatencyHistogram::reset() {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        m_counts[i] = 0;
+    }
+    m_count = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+// Bucket of a latency. A value of magnitude 2^e, e >= 5, goes to the sub-bucket given by its
+// five bits below the leading one.
+int LatencyHistogram::bucketOf(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (int)ns;
+    }
+    int magnitude = 63 - __builtin_clzll(ns);
+    int bucket = (magnitude - LATENCY_LINEAR_BITS + 1) * LATENCY_SUB_BUCKETS +
+        (int)((ns >> (magnitude - LATENCY_LINEAR_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+    return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Largest latency that bucketOf() puts into bucket
+uint64_t LatencyHistogram::bucketHighest(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int magnitude = bucket / LATENCY_SUB_BUCKETS + LATENCY_LINEAR_BITS - 1;
+    uint64_t sub = (uint64_t)(bucket % LATENCY_SUB_BUCKETS) + LATENCY_SUB_BUCKETS;
+    return ((sub + 1) << (magnitude - LATENCY_LINEAR_BITS)) - 1;
+}
+
+// Count one latency
+void LatencyHistogram::record(uint64_t ns) {
+    m_counts[bucketOf(ns)]++;
+    m_count++;
+    m_sum += ns;
+    if (ns > m_max) {
+        m_max = ns;
+    }
+}
+
+// Add the values of other to this histogram
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    if (other.m_max > m_max) {
+        m_max = other.m_max;
+    }
+}
+
+// Number of values recorded
+uint64_t LatencyHistogram::count() const {
+    return m_count;
+}
+
+// Largest value recorded, exact
+uint64_t LatencyHistogram::max() const {
+    return m_max;
+}
+
+// Average value, 0 for an empty histogram
+double LatencyHistogram::mean() const {
+    return (m_count > 0) ? (double)m_sum / m_count : 0.0;
+}
+
+// Latency that percent of the values do not exceed, e.g. percentile(99.9). The answer is the
+// top of the bucket holding that rank, so it overstates by at most one bucket width; 0 for an
+// empty histogram.
+uint64_t LatencyHistogram::percentile(double percent) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)ceil(percent / 100.0 * m_count);
+    rank = (rank < 1) ? 1 : (rank > m_count ? m_count : rank);
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += m_counts[i];
+        if (seen >= rank) {
+            uint64_t highest = bucketHighest(i);
+            return (highest < m_max) ? highest : m_max;
+        }
+    }
+    return m_max;
+}
+
+// Zeroed shards
+LatencyRecorder::LatencyRecorder() : m_shards(new Shard[LATENCY_SHARDS]) {
+    reset();
+}
+
+// Count one latency of op in the shard of the calling thread
+void LatencyRecorder::record(SWARMOP op, uint64_t ns) {
+    if (t_shard < 0) {
+        t_shard = g_nextShard.fetch_add(1, memory_order_relaxed) % LATENCY_SHARDS;
+    }
+    Shard& shard = m_shards[t_shard];
+    shard.m_counts[op][LatencyHistogram::bucketOf(ns)].fetch_add(1, memory_order_relaxed);
+    shard.m_sum[op].fetch_add(ns, memory_order_relaxed);
+    uint64_t seen = shard.m_max[op].load(memory_order_relaxed);
+    while (ns > seen && !shard.m_max[op].compare_exchange_weak(seen, ns, memory_order_relaxed)) {
+    }
+}
+
+// Histogram of op over every shard, read while recording goes on
+LatencyHistogram LatencyRecorder::snapshot(SWARMOP op) const {
+    LatencyHistogram histogram;
+    for (int s = 0; s < LATENCY_SHARDS; s++) {
+        const Shard& shard = m_shards[s];
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            uint64_t count = shard.m_counts[op][i].load(memory_order_relaxed);
+            histogram.m_counts[i] += count;
+            histogram.m_count += count;
+        }
+        histogram.m_sum += shard.m_sum[op].load(memory_order_relaxed);
+        uint64_t max = shard.m_max[op].load(memory_order_relaxed);
+        if (max > histogram.m_max) {
+            histogram.m_max = max;
+        }
+    }
+    return histogram;
+}
+
+// Zero every shard. Values recorded while it runs may survive in part.
+void LatencyRecorder::reset() {
+    for (int s = 0; s < LATENCY_SHARDS; s++) {
+        Shard& shard = m_shards[s];
+        for (int op = 0; op < SWARMOP_COUNT; op++) {
+            for (int i = 0; i < LATENCY_BUCKETS; i++) {
+                shard.m_counts[op][i].store(0, memory_order_relaxed);
+            }
+            shard.m_max[op].store(0, memory_order_relaxed);
+            shard.m_sum[op].store(0, memory_order_relaxed);
+        }
+    }
+}
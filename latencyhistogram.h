@@ -0,0 +1,96 @@
+#pragma once
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+using namespace std;
+#define LATENCY_SUB_BUCKETS 32 //buckets per power of two, so a bucket is at most 1/32 of its values wide
+#define LATENCY_BUCKETS 1024 //covers 0 to 2^36 ns, about 68 seconds; longer latencies land in the last bucket
+#define LATENCY_SHARDS 8 //recording shards, threads are spread over them
+
+// Public operations of a Swarm that are timed
+enum SWARMOP { OP_INSERT, OP_REMOVE, OP_SET_STATE, OP_FIND_BOT, OP_REMOVE_DEAD };
+const int SWARMOP_COUNT = OP_REMOVE_DEAD + 1;
+constexpr string_view SWARMOP_NAMES[SWARMOP_COUNT] = { "insert", "remove", "setState", "findBot", "removeDead" };
+
+// HDR-style histogram of latencies in nanoseconds. Values below LATENCY_SUB_BUCKETS have a
+// bucket each; above, every power of two is split into LATENCY_SUB_BUCKETS equal buckets, so a
+// value is known to within about 3% however large it is, in a fixed 8 KiB of counts.
+// Percentiles report the largest value of the bucket they fall in, capped at the exact maximum.
+// Histograms merge by adding their counts, so per-thread or per-shard histograms combine into
+// one without losing anything.
+class LatencyHistogram {
+public:
+    friend class Grader;
+    friend class Tester;
+    friend class LatencyRecorder;
+    LatencyHistogram();
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& other);
+    void reset();
+    uint64_t count() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t percentile(double percent) const;//smallest bucket value that percent of the values do not exceed
+
+    static int bucketOf(uint64_t ns);
+    static uint64_t bucketHighest(int bucket);//largest value that lands in bucket
+
+private:
+    uint64_t m_counts[LATENCY_BUCKETS];
+    uint64_t m_count;
+    uint64_t m_max;
+    uint64_t m_sum;
+};
+
+// Latency histograms of every SWARMOP, recorded from any number of threads at once. Each thread
+// records into one of LATENCY_SHARDS shards, picked once per thread, with relaxed atomic adds on
+// counters no other shard shares a cache line with, so recording takes no lock and threads on
+// different shards do not contend. snapshot() adds the shards up while recording goes on, so
+// exporting never pauses the swarm; a snapshot taken mid-operation may miss that operation.
+class LatencyRecorder {
+public:
+    friend class Grader;
+    friend class Tester;
+    LatencyRecorder();
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+    void record(SWARMOP op, uint64_t ns);
+    LatencyHistogram snapshot(SWARMOP op) const;
+    void reset();
+
+private:
+    struct alignas(64) Shard {
+        atomic<uint64_t> m_counts[SWARMOP_COUNT][LATENCY_BUCKETS];
+        atomic<uint64_t> m_max[SWARMOP_COUNT];
+        atomic<uint64_t> m_sum[SWARMOP_COUNT];
+    };
+    unique_ptr<Shard[]> m_shards;
+};
+
+// Times one operation from construction to destruction and records it, if there is a recorder
+class LatencyTimer {
+public:
+    LatencyTimer(LatencyRecorder* recorder, SWARMOP op) : m_recorder(recorder), m_op(op) {
+        if (m_recorder != nullptr) {
+            m_start = chrono::steady_clock::now();
+        }
+    }
+    ~LatencyTimer() {
+        if (m_recorder != nullptr) {
+            chrono::nanoseconds elapsed = chrono::steady_clock::now() - m_start;
+            m_recorder->record(m_op, (uint64_t)elapsed.count());
+        }
+    }
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+    LatencyRecorder* m_recorder;
+    SWARMOP m_op;
+    chrono::steady_clock::time_point m_start;
+};
+#endif
@@ -0,0 +1,237 @@
+#include "mappedswarm.h"
+#include "outputsink.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const unsigned char SWARM_FILE_MAGIC[4] = { 'S', 'W', 'R', 'M' };
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// Little-endian loads and stores, independent of the byte order of the machine
+static uint32_t loadLE32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t loadLE64(const unsigned char* p) {
+    return (uint64_t)loadLE32(p) | ((uint64_t)loadLE32(p + 4) << 32);
+}
+
+static void storeLE32(unsigned char* p, uint32_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static void storeLE64(unsigned char* p, uint64_t value) {
+    storeLE32(p, (uint32_t)value);
+    storeLE32(p + 4, (uint32_t)(value >> 32));
+}
+
+// FNV-1a over count records, one 64-bit word per record
+static uint64_t checksum(const unsigned char* records, size_t count) {
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ loadLE64(records + i * SWARM_RECORD_SIZE)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Nothing mapped
+MappedSwarm::MappedSwarm() {
+    m_data = nullptr;
+    m_length = 0;
+    m_records = nullptr;
+    m_count = 0;
+}
+
+// Unmaps the file
+MappedSwarm::~MappedSwarm() {
+    close();
+}
+
+// Map path read-only and check it: header fields, length, checksum, and IDs ascending within
+// MINID..MAXID with valid types and states. A failed check leaves nothing mapped.
+bool MappedSwarm::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < SWARM_HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);//the mapping stays valid
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const unsigned char*>(data);
+    m_length = (size_t)info.st_size;
+    m_records = m_data + SWARM_HEADER_SIZE;
+    m_count = loadLE32(m_data + 12);
+    if (!valid()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Check the mapped file, see open()
+bool MappedSwarm::valid() const {
+    if (m_data[0] != SWARM_FILE_MAGIC[0] || m_data[1] != SWARM_FILE_MAGIC[1] ||
+        m_data[2] != SWARM_FILE_MAGIC[2] || m_data[3] != SWARM_FILE_MAGIC[3] ||
+        loadLE32(m_data + 4) != SWARM_FILE_VERSION || loadLE32(m_data + 8) != SWARM_RECORD_SIZE ||
+        m_length != SWARM_HEADER_SIZE + (size_t)m_count * SWARM_RECORD_SIZE) {
+        return false;
+    }
+    if (checksum(m_records, m_count) != loadLE64(m_data + 16)) {
+        return false;
+    }
+    int last = MINID - 1;
+    for (size_t i = 0; i < m_count; i++) {
+        const unsigned char* record = m_records + i * SWARM_RECORD_SIZE;
+        int id = idAt(i);
+        if (id <= last || id > MAXID || record[4] >= TYPE_COUNT || record[5] >= STATE_COUNT) {
+            return false;
+        }
+        last = id;
+    }
+    return true;
+}
+
+// Unmap the file, if any
+void MappedSwarm::close() {
+    if (m_data != nullptr) {
+        munmap(const_cast<unsigned char*>(m_data), m_length);
+    }
+    m_data = nullptr;
+    m_length = 0;
+    m_records = nullptr;
+    m_count = 0;
+}
+
+// True while a valid file is mapped
+bool MappedSwarm::isOpen() const {
+    return m_data != nullptr;
+}
+
+// Fields of record i
+int MappedSwarm::idAt(size_t i) const {
+    return (int)loadLE32(m_records + i * SWARM_RECORD_SIZE);
+}
+
+ROBOTTYPE MappedSwarm::typeAt(size_t i) const {
+    return static_cast<ROBOTTYPE>(m_records[i * SWARM_RECORD_SIZE + 4]);
+}
+
+STATE MappedSwarm::stateAt(size_t i) const {
+    return static_cast<STATE>(m_records[i * SWARM_RECORD_SIZE + 5]);
+}
+
+// Index of the first record with an ID not below id, m_count if there is none. Each step
+// halves the range and picks the half with a conditional move instead of a branch.
+size_t MappedSwarm::lowerBound(int id) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    size_t base = 0;
+    size_t length = m_count;
+    while (length > 1) {
+        size_t half = length / 2;
+        base = (idAt(base + half) < id) ? base + half : base;
+        length -= half;
+    }
+    return base + (idAt(base) < id ? 1 : 0);
+}
+
+// This function returns true if it finds the robot with id in the file.
+bool MappedSwarm::findBot(int id) const {
+    size_t i = lowerBound(id);
+    return i < m_count && idAt(i) == id;
+}
+
+// Copy the robot with id into robot; returns false if it is not in the file
+bool MappedSwarm::getRobot(int id, Robot& robot) const {
+    size_t i = lowerBound(id);
+    if (i >= m_count || idAt(i) != id) {
+        return false;
+    }
+    robot = Robot(id, typeAt(i), stateAt(i));
+    return true;
+}
+
+// Prints every robot in ascending order of IDs, in the format of Swarm::listRobots
+void MappedSwarm::listRobots() const {
+    OutputSink out(cout);
+    listRobots(out);
+}
+
+// Writes the listing to out
+void MappedSwarm::listRobots(OutputSink& out) const {
+    for (size_t i = 0; i < m_count; i++) {
+        out.writeInt(idAt(i));
+        out.put(':');
+        out.write(STATE_NAMES[stateAt(i)]);
+        out.put(':');
+        out.write(TYPE_NAMES[typeAt(i)]);
+        out.put('\n');
+    }
+}
+
+// Number of robots in the file
+int MappedSwarm::size() const {
+    return (int)m_count;
+}
+
+// Write the robots of swarm to path in ID order. The file is written under a temporary name
+// and renamed over path, so a crash never leaves a half-written file behind. Returns false if
+// the file cannot be written; robots outside MINID..MAXID, which only an empty swarm accepts,
+// cannot be stored.
+bool MappedSwarm::save(const string& path, const Swarm& swarm) {
+    size_t count = (size_t)swarm.size();
+    vector<unsigned char> file(SWARM_HEADER_SIZE + count * SWARM_RECORD_SIZE, 0);
+    unsigned char* record = file.data() + SWARM_HEADER_SIZE;
+    for (const Robot& aBot : swarm) {
+        if (aBot.getID() < MINID || aBot.getID() > MAXID) {
+            return false;
+        }
+        storeLE32(record, (uint32_t)aBot.getID());
+        record[4] = (unsigned char)aBot.getType();
+        record[5] = (unsigned char)aBot.getState();
+        record += SWARM_RECORD_SIZE;
+    }
+    for (int i = 0; i < 4; i++) {
+        file[i] = SWARM_FILE_MAGIC[i];
+    }
+    storeLE32(file.data() + 4, SWARM_FILE_VERSION);
+    storeLE32(file.data() + 8, SWARM_RECORD_SIZE);
+    storeLE32(file.data() + 12, (uint32_t)count);
+    storeLE64(file.data() + 16, checksum(file.data() + SWARM_HEADER_SIZE, count));
+
+    string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t done = 0;
+    while (done < file.size()) {
+        ssize_t written = ::write(fd, file.data() + done, file.size() - done);
+        if (written <= 0) {
+            break;
+        }
+        done += (size_t)written;
+    }
+    bool complete = done == file.size() && fsync(fd) == 0;
+    ::close(fd);
+    if (!complete || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef MAPPEDSWARM_H
+#define MAPPEDSWARM_H
+#include "swarm.h"
+#include <string>
+#include <cstdint>
+#define SWARM_FILE_VERSION 1
+#define SWARM_HEADER_SIZE 32
+#define SWARM_RECORD_SIZE 8
+
+// Swarm file, everything little-endian and fixed-width:
+//   header  0: magic "SWRM"   4: version (u32)   8: record size (u32)   12: robot count (u32)
+//          16: checksum (u64) 24: reserved, 0
+//   records, sorted by ID: 0: id (i32)   4: type (u8)   5: state (u8)   6: reserved, 0
+// The checksum is FNV-1a over the records taken as 64-bit little-endian words.
+//
+// Read-only lookup mode on a mapped swarm file: lookups binary search the records in place,
+// so opening costs one validating pass and no node is built. Swarm::load builds a tree from
+// the same mapping.
+class MappedSwarm {
+public:
+    friend class Grader;
+    friend class Tester;
+    friend class Swarm;
+    MappedSwarm();
+    ~MappedSwarm();
+    MappedSwarm(const MappedSwarm&) = delete;
+    MappedSwarm& operator=(const MappedSwarm&) = delete;
+    bool open(const string& path);//maps and checks the file; false if it is missing or corrupt
+    void close();
+    bool isOpen() const;
+    bool findBot(int id) const;//returns true if the bot is in the file
+    bool getRobot(int id, Robot& robot) const;//copies the robot with id into robot if it is there
+    void listRobots() const;//same output as Swarm::listRobots
+    void listRobots(OutputSink& out) const;
+    int size() const;
+    static bool save(const string& path, const Swarm& swarm);
+
+private:
+    const unsigned char* m_data;//the whole mapped file
+    size_t m_length;
+    const unsigned char* m_records;
+    uint32_t m_count;
+
+    int idAt(size_t i) const;
+    ROBOTTYPE typeAt(size_t i) const;
+    STATE stateAt(size_t i) const;
+    size_t lowerBound(int id) const;
+    bool valid() const;
+};
+#endif
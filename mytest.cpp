@@ -13,7 +13,27 @@
  */
 
 #include "swarm.h"
+#include "compactswarm.h"
+#include "frozenswarm.h"
+#include "btreeswarm.h"
+#include "balancedswarm.h"
+#include "concurrentswarm.h"
+#include "persistentswarm.h"
+#include "outputsink.h"
+#include "mappedswarm.h"
+#include "swarmjournal.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <random>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
 
 enum RANDOM { UNIFORM, NORMAL };
 class Random {
@@ -71,9 +91,7 @@ class Tester {
         bool testBSTAfterMultipleRemovals();
         bool testRemovedDeadFunction();
         bool testDuplicates();
-        bool proveInsertionTimeComplexity();
-        bool proveInsertionTimeComplexity2();
-        bool proveDeletionTimeComplexity();
+        bool proveInsertRemoveScaling();
         bool testInsertionOutOfRangeMin();
         bool testInsertionOutOfRangeMax();
         bool testInsertionEmptyRobotObjects();
@@ -81,7 +99,74 @@ class Tester {
         bool testDeletionOutOfRangeMin();
         bool testDeletionOutOfRangeMax();
         bool testDeleteAllRobots();
-        unsigned int Log2n(unsigned int n);
+        bool testRemoveIfByType();
+        bool proveRemoveDeadLinear();
+        bool testBulkLoad();
+        bool proveBulkLoadTime();
+        bool testArenaAllocator();
+        bool testCompactSwarm();
+        bool testDenseIndex();
+        bool proveDenseIndexThroughput();
+        bool testFrozenSwarm();
+        bool testBTreeSwarm();
+        bool proveBTreeAgainstAVL();
+        bool testBalancingPolicies();
+        bool proveBalancingPolicies();
+        bool testConcurrentSwarm();
+        bool proveConcurrentThroughput();
+        bool testPersistentSwarm();
+        bool testBatchOperations();
+        bool proveBatchCost();
+        bool testParallelReduce();
+        bool proveParallelReduceSpeedup();
+        bool testTypeStateCounters();
+        bool testOrderStatistics();
+        bool proveOrderStatistics();
+        bool testIterators();
+        bool proveIteratorScan();
+        bool testOutputSink();
+        bool proveOutputSinkThroughput();
+        bool testSaveLoad();
+        bool proveLoadTime();
+        bool testJournal();
+        bool proveJournalOverhead();
+        bool testIterativeUpdates();
+        bool proveIterativeUpdates();
+        bool testSwarmStats();
+        bool testLatencyHistograms();
+        bool proveLatencyOverhead();
+        bool testCopyAndMove();
+        bool proveRosterHandoff();
+        bool testSplitJoinConcat();
+        bool proveSplitConcat();
+        int avlHeight(Robot* aBot);
+        vector<int> shuffledIDs();
+        int countRobots(Robot* aBot);
+        void collect(Robot* aBot, vector<Robot*>& robots);
+        bool compareCompact(Robot* aBot, CompactRobotRef compactBot);
+        int btreeDepth(BTreeNode* node, long long low, long long high, bool isRoot);
+        template <class Policy>
+        bool testPolicy(bool (Tester::*valid)(Robot*));
+        template <class Policy>
+        void runPolicyWorkloads();
+        bool avlValid(Robot* aBot) { return avlHeight(aBot) >= 0; }
+        bool redBlackValid(Robot* aBot) { return blackHeight(aBot) >= 0; }
+        int blackHeight(Robot* aBot);
+        bool wavlValid(Robot* aBot);
+        bool treapValid(Robot* aBot);
+        int persistentHeight(const PersistentRobot* aBot);
+        bool countersMatch(Swarm& team);
+        string rosterOf(Swarm& team);
+        string scratchFile(const string& suffix);
+        void journaledWork(Swarm& team, const vector<int>& ids, int first, int count);
+        void dumpText(Robot* aBot, ostream& out);
+};
+
+// Stream buffer that drops everything written to it, used to time listings without a console
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
 };
 
 int main() {
@@ -219,50 +304,24 @@ int main() {
             cout << "\n\nNO DUPLICATES TEST FAILED!" << endl;
         }
     }
-    
-    {
-        // Prove that the insertion performs in O(log n).
-        bool result = false;
-        cout << "\n9) Prove that the insertion operation performs in O(log n). Measure time for inserting one robot after inserting 10,000 robots ..." << endl;
-        result = tester.proveInsertionTimeComplexity();
-        if (result == true) {
-            cout << "\n\nINSERTION PERFORMS O(LOG N) TEST PASSED!" << endl;
-        }
-        else {
-            cout << "\n\nINSERTION PERFORMS O(LOG N) TEST FAILED!" << endl;
-        }
-    }
 
     {
-        // Prove that the insertion performs in O(log n).
-        bool result = false;
-        cout << "\n10) Prove that the insertion operation performs in O(log n) for increasing insertions with problable duplicates extending the time ..." << endl;
-        result = tester.proveInsertionTimeComplexity2();
-        if (result == true) {
-            cout << "\n\nINSERTION PERFORMS O(LOG N) TEST PASSED!" << endl;
-        }
-        else {
-            cout << "\n\nINSERTION PERFORMS O(LOG N) TEST FAILED!" << endl;
-        }
-    }
-        
-    {
-        // Prove that the removal operation performs in O(log n).
+        // Show that the per-operation cost of insert/remove stays flat as the tree doubles in size.
         bool result = false;
-        cout << "\n11) Prove that the deletion operation performs in O(log n)..." << endl;
-        result = tester.proveDeletionTimeComplexity();
+        cout << "\n9) Prove that insert and remove cost per operation stays flat as n doubles ..." << endl;
+        result = tester.proveInsertRemoveScaling();
         if (result == true) {
-            cout << "\n\nDELETION PERFORMS O(LOG N) TEST PASSED!" << endl;
+            cout << "\n\nINSERT/REMOVE SCALING TEST PASSED!" << endl;
         }
         else {
-            cout << "\n\nDELETION PERFORMS O(LOG N) TEST FAILED!" << endl;
+            cout << "\n\nINSERT/REMOVE SCALING TEST FAILED!" << endl;
         }
     }
 
     {
         // Test the insertion with a robot id less than MINID.
         bool result = false;
-        cout << "\n12) Test insertion of robot with ID less than IDMIN..." << endl;
+        cout << "\n10) Test insertion of robot with ID less than IDMIN..." << endl;
         result = tester.testInsertionOutOfRangeMin();
         if (result == true) {
             cout << "\n\nINSERTION OF ROBOT WITH ID LESS THAN IDMIN FAILED! TEST PASSED!" << endl;
@@ -275,7 +334,7 @@ int main() {
     {
         // Test the insertion with a robot id greater than MAXID.
         bool result = false;
-        cout << "\n13) Test insertion of robot with ID greater than IDMAX..." << endl;
+        cout << "\n11) Test insertion of robot with ID greater than IDMAX..." << endl;
         result = tester.testInsertionOutOfRangeMax();
         if (result == true) {
             cout << "\n\nINSERTION OF ROBOT WITH ID GREATER THAN IDMAX FAILED! TEST PASSED!" << endl;
@@ -288,7 +347,7 @@ int main() {
     {
         // Test the insertion with a robot id greater than MAXID.
         bool result = false;
-        cout << "\n14) Test insertion of empty Robot objects ..." << endl;
+        cout << "\n12) Test insertion of empty Robot objects ..." << endl;
         result = tester.testInsertionEmptyRobotObjects();
         if (result == true) {
             cout << "\n\nINSERTION OF EMPTY ROBOT OBJECTS FAILED! TEST PASSED!" << endl;
@@ -301,7 +360,7 @@ int main() {
     {
         // Test inserting very large number of robots and whether the tree is balanced after that.
         bool result = false;
-        cout << "\n15) Testing the insertion of 12,000 robots and balance of the tree..." << endl;
+        cout << "\n13) Testing the insertion of 12,000 robots and balance of the tree..." << endl;
         result = tester.testInsertionVeryLargeTree();
         if (result == true) {
             cout << "\n\nINSERTION AND BALANCED TREE TEST PASSED!" << endl;
@@ -314,7 +373,7 @@ int main() {
     {
         // Testing the deletion of a robot with id less than MINID.
         bool result = false;
-        cout << "\n16) Testing the deletion of a robot with id less than MINID..." << endl;
+        cout << "\n14) Testing the deletion of a robot with id less than MINID..." << endl;
         result = tester.testDeletionOutOfRangeMin();
         if (result == true) {
             cout << "\n\nDELETION OF A ROBOT WITH ID LESS THAN MINID FAILED! TEST PASSED!" << endl;
@@ -327,7 +386,7 @@ int main() {
     {
         // Testing the deletion of a robot with id greater than MAXID.
         bool result = false;
-        cout << "\n17) Testing the deletion of a robot with id greater than MAXID..." << endl;
+        cout << "\n15) Testing the deletion of a robot with id greater than MAXID..." << endl;
         result = tester.testDeletionOutOfRangeMax();
         if (result == true) {
             cout << "\n\nDELETION OF A ROBOT WITH ID LESS THAN MAXID FAILED! TEST PASSED!" << endl;
@@ -340,7 +399,7 @@ int main() {
     {
         // Test deleting all the robots.
         bool result = false;
-        cout << "\n18) Testing deleting all the robots from the tree..." << endl;
+        cout << "\n16) Testing deleting all the robots from the tree..." << endl;
         result = tester.testDeleteAllRobots();
         if (result == true) {
             cout << "\n\nDELETE ALL ROBOTS FROM THE TREE TEST PASSED!" << endl;
@@ -349,230 +408,564 @@ int main() {
             cout << "\n\nDELETE ALL ROBOTS FROM THE TREE TEST FAILED!" << endl;
         }
     }
-    return 0;
-}
 
-// Test the insertion function
-bool Tester::testInsertionFunction()
-{
-    Random idGen(MINID, MAXID);
-    Random typeGen(0, 4);
-    Robot test;
-    Swarm team;
-    int teamSize = 15;
-    int tempID = 0;
-    int ID = 0;
+    {
+        // Test removing robots by type with removeIf.
+        bool result = false;
+        cout << "\n17) Testing removeIf with a robot type predicate..." << endl;
+        result = tester.testRemoveIfByType();
+        if (result == true) {
+            cout << "\n\nREMOVE IF BY TYPE TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nREMOVE IF BY TYPE TEST FAILED!" << endl;
+        }
+    }
 
-    for (int i = 0; i < teamSize; i++) {
-        ID = idGen.getRandNum();
-        if (i == teamSize / 2) tempID = ID;//we store this ID for later use
-        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-        team.insert(robot);
+    {
+        // Compare removeDead against one remove() per dead robot.
+        bool result = false;
+        cout << "\n18) Comparing linear removeDead against per-robot removal for 10%, 50% and 90% dead..." << endl;
+        result = tester.proveRemoveDeadLinear();
+        if (result == true) {
+            cout << "\n\nLINEAR REMOVE DEAD TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nLINEAR REMOVE DEAD TEST FAILED!" << endl;
+        }
     }
-    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
-    team.dumpTree();
-    if (team.treeStatus(team.m_root)) {
-        return true;
+
+    {
+        // Test building a swarm from an unsorted range with duplicates and out of range IDs.
+        bool result = false;
+        cout << "\n19) Testing the bulk-load constructor and assign()..." << endl;
+        result = tester.testBulkLoad();
+        if (result == true) {
+            cout << "\n\nBULK LOAD TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nBULK LOAD TEST FAILED!" << endl;
+        }
     }
-    return false;
-}
 
-// Test whether the tree is balanced after a decent number of insertions. (Note: this requires visiting all nodes and checking the height values)
-bool Tester::testBalanceOfTree()
-{
-    Random idGen(MINID, MAXID);
-    Random typeGen(0, 4);
-    Robot test;
-    Swarm team;
-    int teamSize = 1500;
-    int tempID = 0;
-    int ID = 0;
+    {
+        // Compare the bulk-load constructor against one insert() per robot.
+        bool result = false;
+        cout << "\n20) Comparing bulk load against one insert per robot..." << endl;
+        result = tester.proveBulkLoadTime();
+        if (result == true) {
+            cout << "\n\nBULK LOAD TIME TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nBULK LOAD TIME TEST FAILED!" << endl;
+        }
+    }
 
-    for (int i = 0; i < teamSize; i++) {
-        ID = idGen.getRandNum();
-        if (i == teamSize / 2) tempID = ID;//we store this ID for later use
-        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-        team.insert(robot);
+    {
+        // Test that removed nodes are reused and clear() resets the arena.
+        bool result = false;
+        cout << "\n21) Testing the node arena statistics..." << endl;
+        result = tester.testArenaAllocator();
+        if (result == true) {
+            cout << "\n\nARENA ALLOCATOR TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nARENA ALLOCATOR TEST FAILED!" << endl;
+        }
     }
-    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
-    team.dumpTree();
-    if (team.checkImbalance(team.m_root) >= -1 && team.checkImbalance(team.m_root) <= 1) {
-        return true;
+
+    {
+        // Test the compact node layout against Swarm and report memory per robot.
+        bool result = false;
+        cout << "\n22) Testing the compact index-based swarm..." << endl;
+        result = tester.testCompactSwarm();
+        if (result == true) {
+            cout << "\n\nCOMPACT SWARM TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nCOMPACT SWARM TEST FAILED!" << endl;
+        }
     }
-    return false;
-}
 
-// Test whether the BST property is preserved after all insertions. (Note: this requires visiting all nodes and comparing key values)
-bool Tester::testBSTProperty()
-{
-    Random idGen(MINID, MAXID);
-    Random typeGen(0, 4);
-    Robot test;
-    Swarm team;
-    int teamSize = 15;
-    int tempID = 0;
-    int ID = 0;
+    {
+        // Test that the direct-addressed ID index follows inserts, removals and removeDead.
+        bool result = false;
+        cout << "\n23) Testing the direct-addressed ID index..." << endl;
+        result = tester.testDenseIndex();
+        if (result == true) {
+            cout << "\n\nDENSE INDEX TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nDENSE INDEX TEST FAILED!" << endl;
+        }
+    }
 
-    for (int i = 0; i < teamSize; i++) {
-        ID = idGen.getRandNum();
-        if (i == teamSize / 2) tempID = ID;//we store this ID for later use
-        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-        team.insert(robot);
+    {
+        // Compare random findBot/setState throughput with and without the index.
+        bool result = false;
+        cout << "\n24) Comparing findBot and setState throughput with and without the ID index..." << endl;
+        result = tester.proveDenseIndexThroughput();
+        if (result == true) {
+            cout << "\n\nDENSE INDEX THROUGHPUT TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nDENSE INDEX THROUGHPUT TEST FAILED!" << endl;
+        }
     }
-    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
-    team.dumpTree();
-    if (team.bstProperty(team.m_root, MINID, MAXID)) {
-        return true;
+
+    {
+        // Test the frozen Eytzinger snapshot against the live tree.
+        bool result = false;
+        cout << "\n25) Testing the frozen read-only snapshot..." << endl;
+        result = tester.testFrozenSwarm();
+        if (result == true) {
+            cout << "\n\nFROZEN SWARM TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nFROZEN SWARM TEST FAILED!" << endl;
+        }
     }
-    return false;
-}
 
-// Test the remove function.
-bool Tester::testRemoveFunction()
-{
-    Random idGen(MINID, MAXID);
-    Random typeGen(0, 4);
-    Robot test;
-    Swarm team;
-    int teamSize = 10;
-    int tempID = 0, tempID1 = 0;
-    int ID = 0;
+    {
+        // Test the B+-tree backend against Swarm and check every node.
+        bool result = false;
+        cout << "\n26) Testing the B+-tree swarm..." << endl;
+        result = tester.testBTreeSwarm();
+        if (result == true) {
+            cout << "\n\nB+-TREE SWARM TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nB+-TREE SWARM TEST FAILED!" << endl;
+        }
+    }
 
-    for (int i = 0; i < teamSize; i++) {
-        ID = idGen.getRandNum();
-        if (i == teamSize / 2) tempID = ID;//we store this ID for later use
-        if (i == teamSize / 3) tempID1 = ID;
-        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-        team.insert(robot);
+    {
+        // Compare the B+-tree and AVL swarms for insert, lookup and ordered scan.
+        bool result = false;
+        cout << "\n27) Comparing the B+-tree swarm with the AVL swarm..." << endl;
+        result = tester.proveBTreeAgainstAVL();
+        if (result == true) {
+            cout << "\n\nB+-TREE AGAINST AVL TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nB+-TREE AGAINST AVL TEST FAILED!" << endl;
+        }
     }
-    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
-    team.dumpTree();
-    team.remove(tempID);
-    team.remove(tempID1);
-    cout << "\nDump after removing the nodes with ID: " << tempID << " and " << tempID1 << "\n\n";
-    team.dumpTree();
-    cout << "\n\nList of Robots after removing the nodes with ID: " << tempID << " and " << tempID1 << "\n";
-    team.listRobots();
-    if (team.findThisBot(team.m_root, tempID) == nullptr && team.findThisBot(team.m_root, tempID1) == nullptr) {
-        return true;
+
+    {
+        // Test every balancing policy against Swarm and check its invariants.
+        bool result = false;
+        cout << "\n28) Testing the AVL, red-black, WAVL and treap balancing policies..." << endl;
+        result = tester.testBalancingPolicies();
+        if (result == true) {
+            cout << "\n\nBALANCING POLICIES TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nBALANCING POLICIES TEST FAILED!" << endl;
+        }
     }
-    return false;
-}
 
-// Test whether the tree is balanced after multiple removals.
-bool Tester::testBalanceAfterMultipleRemovals()
-{
-    Random idGen(MINID, MAXID);
-    Random typeGen(0, 4);
-    Robot test;
-    Swarm team;
-    int teamSize = 15;
-    int tempID = 0, tempID1 = 0, tempID2 = 0, tempID3 = 0;
-    int ID = 0;
+    {
+        // Compare rotations and throughput of the balancing policies.
+        bool result = false;
+        cout << "\n29) Comparing the balancing policies on insert-heavy, delete-heavy and mixed workloads..." << endl;
+        result = tester.proveBalancingPolicies();
+        if (result == true) {
+            cout << "\n\nBALANCING POLICIES BENCHMARK TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nBALANCING POLICIES BENCHMARK TEST FAILED!" << endl;
+        }
+    }
 
-    for (int i = 0; i < teamSize; i++) {
-        ID = idGen.getRandNum();
-        if (i == teamSize - 1) tempID = ID;//we store this ID for later use
-        if (i == teamSize - 2) tempID1 = ID;
-        if (i == teamSize - 3) tempID2 = ID;
-        if (i == teamSize - 4) tempID3 = ID;
-        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-        team.insert(robot);
+    {
+        // Test readers, state writers and an ingest thread running on one swarm at once.
+        bool result = false;
+        cout << "\n30) Testing the concurrent swarm with parallel readers and writers..." << endl;
+        result = tester.testConcurrentSwarm();
+        if (result == true) {
+            cout << "\n\nCONCURRENT SWARM TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nCONCURRENT SWARM TEST FAILED!" << endl;
+        }
     }
-    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
-    team.dumpTree();
-    team.remove(tempID);
-    team.remove(tempID1);
-    team.remove(tempID2);
-    team.remove(tempID3);
-    cout << "\nDump after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n\n";
-    team.dumpTree();
-    cout << "\n\nList of Robots after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n";
-    team.listRobots();
-    if (team.checkImbalance(team.m_root) >= -1 && team.checkImbalance(team.m_root) <= 1) {
-        return true;
+
+    {
+        // Compare the concurrent swarm with one global mutex from 1 thread to all cores.
+        bool result = false;
+        cout << "\n31) Measuring concurrent throughput for 95/5 and 50/50 read/write mixes..." << endl;
+        result = tester.proveConcurrentThroughput();
+        if (result == true) {
+            cout << "\n\nCONCURRENT THROUGHPUT TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nCONCURRENT THROUGHPUT TEST FAILED!" << endl;
+        }
     }
-    return false;
-}
-// Test whether the BST property is preserved after multiple removals.
-bool Tester::testBSTAfterMultipleRemovals()
-{
-    Random idGen(MINID, MAXID);
-    Random typeGen(0, 4);
-    Robot test;
-    Swarm team;
-    int teamSize = 15;
-    int tempID = 0, tempID1 = 0, tempID2 = 0, tempID3 = 0;
-    int ID = 0;
 
-    for (int i = 0; i < teamSize; i++) {
-        ID = idGen.getRandNum();
-        if (i == teamSize - 4) tempID = ID;//we store this ID for later use
-        if (i == teamSize - 3) tempID1 = ID;
-        if (i == teamSize - 2) tempID2 = ID;
-        if (i == teamSize - 1) tempID3 = ID;
-        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-        team.insert(robot);
+    {
+        // Test that snapshots keep their version while writers change the persistent swarm.
+        bool result = false;
+        cout << "\n32) Testing persistent swarm snapshots under concurrent writes..." << endl;
+        result = tester.testPersistentSwarm();
+        if (result == true) {
+            cout << "\n\nPERSISTENT SWARM TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nPERSISTENT SWARM TEST FAILED!" << endl;
+        }
     }
-    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
-    team.dumpTree();
-    team.remove(tempID);
-    team.remove(tempID1);
-    team.remove(tempID2);
-    team.remove(tempID3);
-    cout << "\nDump after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n\n";
-    team.dumpTree();
-    cout << "\n\nList of Robots after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n";
-    team.listRobots();
-    if (team.bstProperty(team.m_root, MINID, MAXID)) {
-        return true;
+
+    {
+        // Test insertBatch and removeBatch against looped insert and remove.
+        bool result = false;
+        cout << "\n33) Testing batched insert and remove..." << endl;
+        result = tester.testBatchOperations();
+        if (result == true) {
+            cout << "\n\nBATCH OPERATIONS TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nBATCH OPERATIONS TEST FAILED!" << endl;
+        }
     }
-    return false;
+
+    {
+        // Compare the per-robot cost of batches with looped insert and remove.
+        bool result = false;
+        cout << "\n34) Measuring batched insert and remove for batch sizes 16 to 65536..." << endl;
+        result = tester.proveBatchCost();
+        if (result == true) {
+            cout << "\n\nBATCH COST TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nBATCH COST TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test parallelReduce against a sequential walk for several pool sizes.
+        bool result = false;
+        cout << "\n35) Testing parallel reductions over the swarm..." << endl;
+        result = tester.testParallelReduce();
+        if (result == true) {
+            cout << "\n\nPARALLEL REDUCE TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nPARALLEL REDUCE TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Measure the speedup of parallelReduce from 1 thread to all cores.
+        bool result = false;
+        cout << "\n36) Measuring parallel reduction speedup..." << endl;
+        result = tester.proveParallelReduceSpeedup();
+        if (result == true) {
+            cout << "\n\nPARALLEL REDUCE SPEEDUP TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nPARALLEL REDUCE SPEEDUP TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test the per-type and per-state counters through every kind of change.
+        bool result = false;
+        cout << "\n37) Testing the per-type and per-state counters..." << endl;
+        result = tester.testTypeStateCounters();
+        if (result == true) {
+            cout << "\n\nTYPE AND STATE COUNTERS TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nTYPE AND STATE COUNTERS TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test rank, select, range counts, range walks and pages against the sorted robots.
+        bool result = false;
+        cout << "\n38) Testing rank, select and range queries..." << endl;
+        result = tester.testOrderStatistics();
+        if (result == true) {
+            cout << "\n\nORDER STATISTICS TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nORDER STATISTICS TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Compare listing the last page with select() and with a walk from the smallest ID.
+        bool result = false;
+        cout << "\n39) Measuring paginated listing with select()..." << endl;
+        result = tester.proveOrderStatistics();
+        if (result == true) {
+            cout << "\n\nPAGINATED LISTING TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nPAGINATED LISTING TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test the iterators forwards, backwards, from bounds and with std algorithms.
+        bool result = false;
+        cout << "\n40) Testing the in-order iterators..." << endl;
+        result = tester.testIterators();
+        if (result == true) {
+            cout << "\n\nITERATORS TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nITERATORS TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Compare a full scan with the iterators and with the recursive traverseTree.
+        bool result = false;
+        cout << "\n41) Measuring a full scan with iterators against traverseTree..." << endl;
+        result = tester.proveIteratorScan();
+        if (result == true) {
+            cout << "\n\nITERATOR SCAN TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nITERATOR SCAN TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test that every output sink gives the text the stream-based listing gave.
+        bool result = false;
+        cout << "\n42) Testing listings through output sinks..." << endl;
+        result = tester.testOutputSink();
+        if (result == true) {
+            cout << "\n\nOUTPUT SINK TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nOUTPUT SINK TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Compare listing throughput in MB/s with and without the output sink.
+        bool result = false;
+        cout << "\n43) Measuring listing throughput through output sinks..." << endl;
+        result = tester.proveOutputSinkThroughput();
+        if (result == true) {
+            cout << "\n\nOUTPUT SINK THROUGHPUT TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nOUTPUT SINK THROUGHPUT TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test saving, loading and mapping swarm files, and rejecting damaged ones.
+        bool result = false;
+        cout << "\n44) Testing binary swarm files..." << endl;
+        result = tester.testSaveLoad();
+        if (result == true) {
+            cout << "\n\nSWARM FILE TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nSWARM FILE TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Compare restarting from a text roster with loading and mapping a swarm file.
+        bool result = false;
+        cout << "\n45) Measuring restart from a text roster and from a swarm file..." << endl;
+        result = tester.proveLoadTime();
+        if (result == true) {
+            cout << "\n\nSWARM FILE LOAD TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nSWARM FILE LOAD TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test journaling changes and recovering a swarm from a snapshot and its journal.
+        bool result = false;
+        cout << "\n46) Testing the write-ahead journal..." << endl;
+        result = tester.testJournal();
+        if (result == true) {
+            cout << "\n\nJOURNAL TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nJOURNAL TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Measure the throughput cost of journaling at several group-commit windows.
+        bool result = false;
+        cout << "\n47) Measuring the journal overhead..." << endl;
+        result = tester.proveJournalOverhead();
+        if (result == true) {
+            cout << "\n\nJOURNAL OVERHEAD TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nJOURNAL OVERHEAD TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test the iterative insert and remove against the recursive ones.
+        bool result = false;
+        cout << "\n48) Testing iterative insert and remove..." << endl;
+        result = tester.testIterativeUpdates();
+        if (result == true) {
+            cout << "\n\nITERATIVE UPDATE TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nITERATIVE UPDATE TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Measure the iterative insert and remove against the recursive ones.
+        bool result = false;
+        cout << "\n49) Measuring iterative insert and remove..." << endl;
+        result = tester.proveIterativeUpdates();
+        if (result == true) {
+            cout << "\n\nITERATIVE UPDATE PERFORMANCE TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nITERATIVE UPDATE PERFORMANCE TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test the operation counters and the shape statistics of Swarm::stats().
+        bool result = false;
+        cout << "\n50) Testing swarm statistics..." << endl;
+        result = tester.testSwarmStats();
+        if (result == true) {
+            cout << "\n\nSWARM STATISTICS TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nSWARM STATISTICS TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test the latency histograms and their recording from several threads.
+        bool result = false;
+        cout << "\n51) Testing latency histograms..." << endl;
+        result = tester.testLatencyHistograms();
+        if (result == true) {
+            cout << "\n\nLATENCY HISTOGRAM TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nLATENCY HISTOGRAM TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Measure what timing every operation costs.
+        bool result = false;
+        cout << "\n52) Measuring the cost of latency recording..." << endl;
+        result = tester.proveLatencyOverhead();
+        if (result == true) {
+            cout << "\n\nLATENCY RECORDING COST TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nLATENCY RECORDING COST TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test copying and moving swarms, and the rvalue and in-place inserts.
+        bool result = false;
+        cout << "\n53) Testing copy, move and emplace..." << endl;
+        result = tester.testCopyAndMove();
+        if (result == true) {
+            cout << "\n\nCOPY AND MOVE TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nCOPY AND MOVE TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Measure handing a roster from one swarm to another.
+        bool result = false;
+        cout << "\n54) Measuring roster handoff..." << endl;
+        result = tester.proveRosterHandoff();
+        if (result == true) {
+            cout << "\n\nROSTER HANDOFF TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nROSTER HANDOFF TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Test splitting a swarm by ID and joining swarms back together.
+        bool result = false;
+        cout << "\n55) Testing split, join and concat..." << endl;
+        result = tester.testSplitJoinConcat();
+        if (result == true) {
+            cout << "\n\nSPLIT, JOIN AND CONCAT TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nSPLIT, JOIN AND CONCAT TEST FAILED!" << endl;
+        }
+    }
+
+    {
+        // Measure moving an ID range to another swarm and back.
+        bool result = false;
+        cout << "\n56) Measuring split and concat..." << endl;
+        result = tester.proveSplitConcat();
+        if (result == true) {
+            cout << "\n\nSPLIT AND CONCAT TEST PASSED!" << endl;
+        }
+        else {
+            cout << "\n\nSPLIT AND CONCAT TEST FAILED!" << endl;
+        }
+    }
+    return 0;
 }
 
-// Test the removeDead() functionality.
-bool Tester::testRemovedDeadFunction()
+// Test the insertion function
+bool Tester::testInsertionFunction()
 {
     Random idGen(MINID, MAXID);
     Random typeGen(0, 4);
     Robot test;
     Swarm team;
-    int teamSize = 10;
-    int tempID = 0, tempID1 = 0;
+    int teamSize = 15;
+    int tempID = 0;
     int ID = 0;
 
     for (int i = 0; i < teamSize; i++) {
         ID = idGen.getRandNum();
         if (i == teamSize / 2) tempID = ID;//we store this ID for later use
-        if (i == teamSize - 1) tempID1 = ID;
         Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
         team.insert(robot);
     }
     cout << "Dump after inserting " << teamSize << " nodes:\n\n";
     team.dumpTree();
-    team.setState(tempID, DEAD);
-    team.setState(tempID1, DEAD);
-    cout << "\nDump after removing the DEAD nodes: " << tempID << " and " << tempID1 << "\n\n";
-    team.removeDead();
-    cout << "\n\nList of Robots after removing the DEAD nodes: " << tempID << " and " << tempID1 << "\n";
-    team.listRobots();
-    if (team.findThisBot(team.m_root, tempID) == nullptr && team.findThisBot(team.m_root, tempID1) == nullptr) {
+    if (team.treeStatus(team.m_root)) {
         return true;
     }
     return false;
 }
 
-// Test whether the tree allows for storage of duplicates.
-bool Tester::testDuplicates()
+// Test whether the tree is balanced after a decent number of insertions. (Note: this requires visiting all nodes and checking the height values)
+bool Tester::testBalanceOfTree()
 {
     Random idGen(MINID, MAXID);
     Random typeGen(0, 4);
     Robot test;
     Swarm team;
-    int teamSize = 15;
+    int teamSize = 1500;
     int tempID = 0;
     int ID = 0;
-    int count = 0;
 
     for (int i = 0; i < teamSize; i++) {
         ID = idGen.getRandNum();
@@ -582,86 +975,142 @@ bool Tester::testDuplicates()
     }
     cout << "Dump after inserting " << teamSize << " nodes:\n\n";
     team.dumpTree();
-    Robot robot(tempID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-    team.insert(robot);
-    if (team.findThisBot(team.m_root, tempID)) {
-        count += 1;
-    }
-    if (count == 1) {
+    if (team.checkImbalance(team.m_root) >= -1 && team.checkImbalance(team.m_root) <= 1) {
         return true;
     }
     return false;
 }
 
-// Prove that the insertion performs in O(log n).
-bool Tester::proveInsertionTimeComplexity()
+// Test whether the BST property is preserved after all insertions. (Note: this requires visiting all nodes and comparing key values)
+bool Tester::testBSTProperty()
 {
     Random idGen(MINID, MAXID);
     Random typeGen(0, 4);
     Robot test;
     Swarm team;
-    int teamSize = 10000;
+    int teamSize = 15;
     int tempID = 0;
     int ID = 0;
-    int count = 0;
-    double T = 0.0;//to store running times
-    clock_t start, stop;//stores the clock ticks while running the program
-   
+
     for (int i = 0; i < teamSize; i++) {
         ID = idGen.getRandNum();
         if (i == teamSize / 2) tempID = ID;//we store this ID for later use
         Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
         team.insert(robot);
     }
-    start = clock();
-    Robot robot(tempID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-    team.insert(robot);
-    stop = clock();
-    T = stop - start;//number of clock ticks the algorithm took
-    cout << "Insertion of one robot on a " << teamSize << " robots tree took " << T << " clock ticks (" << T / CLOCKS_PER_SEC << " seconds)!" << endl;
-    if ((T / CLOCKS_PER_SEC) < Log2n(teamSize)) {
+    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
+    team.dumpTree();
+    if (team.bstProperty(team.m_root, MINID, MAXID)) {
         return true;
     }
     return false;
 }
 
-// Prove that the insertion performs in O(log n) for increasing insertions
-bool Tester::proveInsertionTimeComplexity2()
+// Test the remove function.
+bool Tester::testRemoveFunction()
 {
     Random idGen(MINID, MAXID);
     Random typeGen(0, 4);
     Robot test;
     Swarm team;
     int teamSize = 10;
-    int tempID = 0;
+    int tempID = 0, tempID1 = 0;
     int ID = 0;
-    int count = 0;
 
-    const int a = 2;//scaling factor for input size, everytime it will double
-    double T = 0.0;//to store running times
-    int numTrials = 7;
-    clock_t start, stop;//stores the clock ticks while running the program
-    start = clock();
-    for (int k = 0; k < numTrials - 1; k++) {
-        for (int i = 0; i < teamSize; i++) {
-            ID = idGen.getRandNum();
-            if (i == teamSize / 2) tempID = ID;//we store this ID for later use
-            Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-            team.insert(robot);
-        }
-        stop = clock();
-        T = stop - start;//number of clock ticks the algorithm took
-        cout << "Insertion of " << teamSize << " robots took " << T << " clock ticks (" << T / CLOCKS_PER_SEC << " seconds)!" << endl;
-        teamSize = teamSize * a;
+    for (int i = 0; i < teamSize; i++) {
+        ID = idGen.getRandNum();
+        if (i == teamSize / 2) tempID = ID;//we store this ID for later use
+        if (i == teamSize / 3) tempID1 = ID;
+        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+    }
+    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
+    team.dumpTree();
+    team.remove(tempID);
+    team.remove(tempID1);
+    cout << "\nDump after removing the nodes with ID: " << tempID << " and " << tempID1 << "\n\n";
+    team.dumpTree();
+    cout << "\n\nList of Robots after removing the nodes with ID: " << tempID << " and " << tempID1 << "\n";
+    team.listRobots();
+    if (team.findThisBot(team.m_root, tempID) == nullptr && team.findThisBot(team.m_root, tempID1) == nullptr) {
+        return true;
+    }
+    return false;
+}
+
+// Test whether the tree is balanced after multiple removals.
+bool Tester::testBalanceAfterMultipleRemovals()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Robot test;
+    Swarm team;
+    int teamSize = 15;
+    int tempID = 0, tempID1 = 0, tempID2 = 0, tempID3 = 0;
+    int ID = 0;
+
+    for (int i = 0; i < teamSize; i++) {
+        ID = idGen.getRandNum();
+        if (i == teamSize - 1) tempID = ID;//we store this ID for later use
+        if (i == teamSize - 2) tempID1 = ID;
+        if (i == teamSize - 3) tempID2 = ID;
+        if (i == teamSize - 4) tempID3 = ID;
+        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+    }
+    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
+    team.dumpTree();
+    team.remove(tempID);
+    team.remove(tempID1);
+    team.remove(tempID2);
+    team.remove(tempID3);
+    cout << "\nDump after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n\n";
+    team.dumpTree();
+    cout << "\n\nList of Robots after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n";
+    team.listRobots();
+    if (team.checkImbalance(team.m_root) >= -1 && team.checkImbalance(team.m_root) <= 1) {
+        return true;
+    }
+    return false;
+}
+// Test whether the BST property is preserved after multiple removals.
+bool Tester::testBSTAfterMultipleRemovals()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Robot test;
+    Swarm team;
+    int teamSize = 15;
+    int tempID = 0, tempID1 = 0, tempID2 = 0, tempID3 = 0;
+    int ID = 0;
+
+    for (int i = 0; i < teamSize; i++) {
+        ID = idGen.getRandNum();
+        if (i == teamSize - 4) tempID = ID;//we store this ID for later use
+        if (i == teamSize - 3) tempID1 = ID;
+        if (i == teamSize - 2) tempID2 = ID;
+        if (i == teamSize - 1) tempID3 = ID;
+        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
     }
-    if ((T / CLOCKS_PER_SEC) < Log2n(teamSize)) {
+    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
+    team.dumpTree();
+    team.remove(tempID);
+    team.remove(tempID1);
+    team.remove(tempID2);
+    team.remove(tempID3);
+    cout << "\nDump after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n\n";
+    team.dumpTree();
+    cout << "\n\nList of Robots after removing the nodes with ID: " << tempID << ", " << tempID1 << ", " << tempID2 << ", and " << tempID3 << "\n";
+    team.listRobots();
+    if (team.bstProperty(team.m_root, MINID, MAXID)) {
         return true;
     }
     return false;
 }
 
-// Prove that the removal operation performs in O(log n).
-bool Tester::proveDeletionTimeComplexity()
+// Test the removeDead() functionality.
+bool Tester::testRemovedDeadFunction()
 {
     Random idGen(MINID, MAXID);
     Random typeGen(0, 4);
@@ -671,41 +1120,125 @@ bool Tester::proveDeletionTimeComplexity()
     int tempID = 0, tempID1 = 0;
     int ID = 0;
 
-    const int a = 2;//scaling factor for input size, everytime it will double
-    double T = 0.0;//to store running times
-    int numTrials = 10;
-    clock_t start, stop;//stores the clock ticks while running the program
-    for (int k = 0; k < numTrials - 1; k++) {
-        for (int i = 0; i < teamSize; i++) {
-            ID = idGen.getRandNum();
-            if (i == teamSize / 2) tempID = ID;//we store this ID for later use
-            if (i == teamSize / 3) tempID = ID;//we store this ID for later use
-            Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
-            team.insert(robot);
-        }
+    for (int i = 0; i < teamSize; i++) {
+        ID = idGen.getRandNum();
+        if (i == teamSize / 2) tempID = ID;//we store this ID for later use
+        if (i == teamSize - 1) tempID1 = ID;
+        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+    }
+    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
+    team.dumpTree();
+    team.setState(tempID, DEAD);
+    team.setState(tempID1, DEAD);
+    cout << "\nDump after removing the DEAD nodes: " << tempID << " and " << tempID1 << "\n\n";
+    team.removeDead();
+    cout << "\n\nList of Robots after removing the DEAD nodes: " << tempID << " and " << tempID1 << "\n";
+    team.listRobots();
+    if (team.findThisBot(team.m_root, tempID) == nullptr && team.findThisBot(team.m_root, tempID1) == nullptr) {
+        return true;
     }
+    return false;
+}
 
-    start = clock();
-    for (int k = 0; k < numTrials - 1; k++) {
+// Test whether the tree allows for storage of duplicates.
+bool Tester::testDuplicates()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Robot test;
+    Swarm team;
+    int teamSize = 15;
+    int tempID = 0;
+    int ID = 0;
+    int count = 0;
+
+    for (int i = 0; i < teamSize; i++) {
+        ID = idGen.getRandNum();
+        if (i == teamSize / 2) tempID = ID;//we store this ID for later use
+        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+    }
+    cout << "Dump after inserting " << teamSize << " nodes:\n\n";
+    team.dumpTree();
+    Robot robot(tempID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+    team.insert(robot);
+    if (team.findThisBot(team.m_root, tempID)) {
+        count += 1;
+    }
+    if (count == 1) {
+        return true;
+    }
+    return false;
+}
+
+// Show that insert/remove cost per operation stays flat as n doubles. Every ID in the key
+// space is distinct, so n can double until MAXID - MINID + 1 (90,000) robots are stored;
+// beyond that every insert would be a duplicate and nothing more would be measured. The growth
+// is reported and only the trees are checked, since timings vary too much between machines and
+// builds to fail on; bench.cpp fits the growth exponent properly.
+bool Tester::proveInsertRemoveScaling()
+{
+    vector<int> ids = shuffledIDs();
+    const int probes = 2000;//robots inserted and removed at every size
+    const int rounds = 5;
+    const int maxSize = (int)ids.size() - probes;
+    double first = 0.0, last = 0.0;
+    bool valid = true;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    for (int teamSize = 1000; teamSize <= maxSize; teamSize *= 2) {
+        Swarm team;
         for (int i = 0; i < teamSize; i++) {
-            team.remove(tempID);
-            team.remove(tempID1);
+            team.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % 5)));
+        }
+        start = clock();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < probes; i++) {
+                team.insert(Robot(ids[teamSize + i]));
+            }
+            for (int i = 0; i < probes; i++) {
+                team.remove(ids[teamSize + i]);
+            }
         }
         stop = clock();
-        T = stop - start;//number of clock ticks the algorithm took
-        cout << "Deletion of robots took " << T << " clock ticks (" << T / CLOCKS_PER_SEC << " seconds)!" << endl;
-        teamSize = teamSize * a;
-    }    
-    if ((T / CLOCKS_PER_SEC) < Log2n(teamSize)) {
-        return true;
+        double nsPerOp = (double)(stop - start) / CLOCKS_PER_SEC * 1e9 / (2.0 * probes * rounds);
+        cout << "n = " << teamSize << ": " << nsPerOp << " ns per insert/remove, height "
+             << team.m_root->m_height << endl;
+        valid = valid && avlHeight(team.m_root) >= 0;
+        if (first == 0.0) first = nsPerOp;
+        last = nsPerOp;
     }
-    return false;
+    // an O(n) update would grow 64 times between the smallest and largest size; O(log n) grows ~1.6 times
+    cout << "cost per operation grew " << last / first << " times from the smallest to the largest size" << endl;
+    return valid;
+}
+
+// Returns the height of the subtree if every node holds its correct height and is AVL balanced,
+// otherwise -2
+int Tester::avlHeight(Robot* aBot)
+{
+    if (aBot == nullptr) {
+        return -1;
+    }
+    int left = avlHeight(aBot->m_left);
+    int right = avlHeight(aBot->m_right);
+    if (left == -2 || right == -2 || left - right > 1 || right - left > 1) {
+        return -2;
+    }
+    int height = (left > right ? left : right) + 1;
+    return (height == aBot->m_height) ? height : -2;
 }
 
-// Log2(n) test function
-unsigned int Tester::Log2n(unsigned int n)
+// All IDs in the key space in a fixed pseudorandom order
+vector<int> Tester::shuffledIDs()
 {
-    return (n > 1) ? 1 + Log2n(n / 2) : 0;
+    vector<int> ids;
+    for (int id = MINID; id <= MAXID; id++) {
+        ids.push_back(id);
+    }
+    shuffle(ids.begin(), ids.end(), std::mt19937(10));
+    return ids;
 }
 
 // Test insertion out of range MINID
@@ -887,4 +1420,2521 @@ bool Tester::testDeleteAllRobots()
         return true;
     }
     return false;
+}
+
+// Test removing all robots of one type with removeIf
+bool Tester::testRemoveIfByType()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Swarm team;
+    int teamSize = 500;
+    int ID = 0;
+
+    for (int i = 0; i < teamSize; i++) {
+        ID = idGen.getRandNum();
+        Robot robot(ID, static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+    }
+    int before = countRobots(team.m_root);
+    team.listRobots();
+    int subs = team.removeIf([](const Robot& robot) { return robot.getType() == SUB; });
+    bool noSubs = true;
+    team.removeIf([&noSubs](const Robot& robot) { if (robot.getType() == SUB) noSubs = false; return false; });
+    cout << "\nRemoved " << subs << " SUB robots out of " << before << "\n";
+    return noSubs && subs > 0 && countRobots(team.m_root) == before - subs &&
+        avlHeight(team.m_root) >= 0 && team.bstProperty(team.m_root, MINID, MAXID);
+}
+
+// Compare removeDead, which rebuilds the tree once, against one remove() per dead robot
+bool Tester::proveRemoveDeadLinear()
+{
+    vector<int> ids = shuffledIDs();
+    const int teamSize = 64000;
+    const int percents[] = { 10, 50, 90 };
+    bool valid = true;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    for (int percent : percents) {
+        int deadCount = teamSize / 100 * percent;
+        Swarm rebuilt, looped;
+        for (int i = 0; i < teamSize; i++) {
+            rebuilt.insert(Robot(ids[i]));
+            looped.insert(Robot(ids[i]));
+        }
+        for (int i = 0; i < deadCount; i++) {
+            rebuilt.setState(ids[i], DEAD);
+            looped.setState(ids[i], DEAD);
+        }
+
+        start = clock();
+        rebuilt.removeDead();
+        stop = clock();
+        double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        for (int i = 0; i < deadCount; i++) {
+            looped.remove(ids[i]);
+        }
+        stop = clock();
+        double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+        cout << percent << "% dead of " << teamSize << ": removeDead " << T1 << " seconds, "
+             << deadCount << " removes " << T2 << " seconds" << endl;
+        valid = valid && countRobots(rebuilt.m_root) == teamSize - deadCount &&
+            countRobots(looped.m_root) == teamSize - deadCount && avlHeight(rebuilt.m_root) >= 0 &&
+            rebuilt.bstProperty(rebuilt.m_root, MINID, MAXID);
+    }
+    return valid;
+}
+
+// Number of robots in the subtree
+int Tester::countRobots(Robot* aBot)
+{
+    if (aBot == nullptr) {
+        return 0;
+    }
+    return countRobots(aBot->m_left) + 1 + countRobots(aBot->m_right);
+}
+
+// Test the bulk-load constructor and assign() against the same robots inserted one by one
+bool Tester::testBulkLoad()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Swarm team;
+    vector<Robot> robots;
+    int teamSize = 2000;
+
+    for (int i = 0; i < teamSize; i++) {
+        robots.push_back(Robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum())));
+    }
+    robots.push_back(Robot(225));
+    robots.push_back(Robot(558855544));
+    robots.push_back(Robot(robots[0].getID(), robots[0].getType() == SUB ? BIRD : SUB, DEAD));
+    for (const Robot& robot : robots) {
+        team.insert(robot);
+    }
+    Swarm loaded(robots.begin(), robots.end());
+    cout << "Dump after loading " << robots.size() << " robots:\n\n";
+    loaded.dumpTree();
+
+    // same robots, with the first copy of a duplicate kept and out of range IDs dropped
+    vector<Robot*> expected, actual;
+    collect(team.m_root, expected);
+    collect(loaded.m_root, actual);
+    bool same = expected.size() == actual.size();
+    for (size_t i = 0; same && i < expected.size(); i++) {
+        same = expected[i]->getID() == actual[i]->getID() && expected[i]->getType() == actual[i]->getType() &&
+            expected[i]->getState() == actual[i]->getState();
+    }
+
+    // already sorted input takes the no-sort path
+    vector<Robot> sorted;
+    for (Robot* aBot : expected) {
+        sorted.push_back(*aBot);
+    }
+    loaded.assign(sorted.begin(), sorted.end());
+    return same && avlHeight(loaded.m_root) >= 0 && countRobots(loaded.m_root) == (int)expected.size() &&
+        loaded.bstProperty(loaded.m_root, MINID, MAXID) && !loaded.findBot(225);
+}
+
+// Compare building a 90,000 robot swarm with the bulk-load constructor and with insert(). The
+// times are printed; the test only checks the tree that the bulk load built.
+bool Tester::proveBulkLoadTime()
+{
+    vector<int> ids = shuffledIDs();
+    vector<Robot> robots;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        robots.push_back(Robot(ids[i], static_cast<ROBOTTYPE>(i % 5)));
+    }
+    start = clock();
+    Swarm inserted;
+    for (const Robot& robot : robots) {
+        inserted.insert(robot);
+    }
+    stop = clock();
+    double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    Swarm loaded(robots.begin(), robots.end());
+    stop = clock();
+    double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    cout << robots.size() << " robots: insert " << T1 << " seconds, bulk load " << T2 << " seconds" << endl;
+    return avlHeight(loaded.m_root) >= 0 && countRobots(loaded.m_root) == (int)robots.size();
+}
+
+// Append the robots of the subtree in order
+void Tester::collect(Robot* aBot, vector<Robot*>& robots)
+{
+    if (aBot == nullptr) {
+        return;
+    }
+    collect(aBot->m_left, robots);
+    robots.push_back(aBot);
+    collect(aBot->m_right, robots);
+}
+
+// Test the arena statistics through inserts, removals, reuse and clear
+bool Tester::testArenaAllocator()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team;
+    int teamSize = 3000;
+    int removed = 500;
+
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i]));
+    }
+    ArenaStats full = team.allocatorStats();
+    for (int i = 0; i < removed; i++) {
+        team.remove(ids[i]);
+    }
+    ArenaStats afterRemove = team.allocatorStats();
+    for (int i = 0; i < removed; i++) {
+        team.insert(Robot(ids[teamSize + i]));
+    }
+    ArenaStats afterReuse = team.allocatorStats();
+    team.clear();
+    ArenaStats afterClear = team.allocatorStats();
+    team.insert(Robot(ids[0]));
+
+    cout << "slabs/live/free: full " << full.slabs << "/" << full.liveNodes << "/" << full.freeNodes
+         << ", after remove " << afterRemove.slabs << "/" << afterRemove.liveNodes << "/" << afterRemove.freeNodes
+         << ", after reuse " << afterReuse.slabs << "/" << afterReuse.liveNodes << "/" << afterReuse.freeNodes
+         << ", after clear " << afterClear.slabs << "/" << afterClear.liveNodes << "/" << afterClear.freeNodes << endl;
+    return full.slabs == (teamSize + ROBOT_SLAB_SIZE - 1) / ROBOT_SLAB_SIZE && full.liveNodes == teamSize &&
+        afterRemove.liveNodes == teamSize - removed && afterRemove.freeNodes == removed &&
+        afterReuse.slabs == full.slabs && afterReuse.freeNodes == 0 && afterReuse.liveNodes == teamSize &&
+        afterClear.slabs == 1 && afterClear.liveNodes == 0 && team.m_root != nullptr &&
+        team.allocatorStats().liveNodes == 1;
+}
+
+// Run the same inserts, removals and state changes on Swarm and CompactSwarm, compare the trees
+// node by node and report the memory used per robot by both layouts
+bool Tester::testCompactSwarm()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Swarm team;
+    CompactSwarm compact;
+    int teamSize = 20000;
+    bool same = true;
+
+    for (int i = 0; i < teamSize; i++) {
+        Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+        compact.insert(robot);
+    }
+    for (int i = 0; i < teamSize / 4; i++) {
+        int ID = idGen.getRandNum();
+        team.remove(ID);
+        compact.remove(ID);
+        ID = idGen.getRandNum();
+        same = same && team.setState(ID, DEAD) == compact.setState(ID, DEAD);
+    }
+    compact.insert(Robot(225));
+    same = same && !compact.findBot(225);
+    ArenaStats arena = team.allocatorStats();
+    double swarmBytes = (double)arena.slabs * ROBOT_SLAB_SIZE * sizeof(Robot) / arena.liveNodes;
+    cout << "Robot node " << sizeof(Robot) << " bytes, " << swarmBytes << " bytes per robot in the arena" << endl;
+    cout << "CompactRobot node " << sizeof(CompactRobot) << " bytes, " << compact.bytesPerRobot()
+         << " bytes per robot in the node array" << endl;
+
+    vector<Robot*> robots;
+    collect(team.m_root, robots);
+    same = same && compact.size() == (int)robots.size() && compareCompact(team.m_root, compact.getRoot());
+    team.removeDead();
+    compact.removeDead();
+    robots.clear();
+    collect(team.m_root, robots);
+    same = same && compact.size() == (int)robots.size();
+    for (Robot* aBot : robots) {
+        same = same && compact.findBot(aBot->getID());
+    }
+    return same && sizeof(CompactRobot) <= 16;
+}
+
+// Compare a Swarm subtree and a CompactSwarm subtree node by node
+bool Tester::compareCompact(Robot* aBot, CompactRobotRef compactBot)
+{
+    if (aBot == nullptr || compactBot == nullptr) {
+        return aBot == nullptr && compactBot == nullptr;
+    }
+    return aBot->getID() == compactBot->getID() && aBot->getType() == compactBot->getType() &&
+        aBot->getState() == compactBot->getState() && aBot->getHeight() == compactBot->getHeight() &&
+        compareCompact(aBot->getLeft(), compactBot->getLeft()) &&
+        compareCompact(aBot->getRight(), compactBot->getRight());
+}
+
+// Test that the index agrees with the tree for every ID after inserts, removals and removeDead
+bool Tester::testDenseIndex()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Swarm indexed, plain;
+    int teamSize = 5000;
+    bool same = true;
+
+    for (int i = 0; i < teamSize / 2; i++) {
+        Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        indexed.insert(robot);
+        plain.insert(robot);
+    }
+    indexed.enableIndex(true);
+    for (int i = 0; i < teamSize; i++) {
+        Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        indexed.insert(robot);
+        plain.insert(robot);
+        int ID = idGen.getRandNum();
+        indexed.remove(ID);
+        plain.remove(ID);
+        ID = idGen.getRandNum();
+        same = same && indexed.setState(ID, DEAD) == plain.setState(ID, DEAD);
+    }
+    indexed.removeDead();
+    plain.removeDead();
+    for (int ID = MINID; ID <= MAXID; ID++) {
+        Robot* aBot = indexed.findThisBot(indexed.m_root, ID);
+        same = same && indexed.findBot(ID) == plain.findBot(ID) && (aBot == nullptr || aBot->getID() == ID);
+    }
+    vector<Robot*> robots;
+    collect(indexed.m_root, robots);
+    for (Robot* aBot : robots) {
+        same = same && indexed.findThisBot(indexed.m_root, aBot->getID()) == aBot;
+    }
+    indexed.clear();
+    same = same && !indexed.findBot(robots[0]->getID()) && indexed.indexEnabled();
+    indexed.enableIndex(false);
+    return same && !indexed.indexEnabled();
+}
+
+// Random findBot and setState throughput on a 64,000 robot swarm with and without the index
+bool Tester::proveDenseIndexThroughput()
+{
+    vector<int> ids = shuffledIDs();
+    Random idGen(MINID, MAXID);
+    Swarm team;
+    const int teamSize = 64000;
+    const int lookups = 1000000;
+    vector<int> probes;
+    clock_t start, stop;//stores the clock ticks while running the program
+    double found[2] = { 0, 0 };
+    double T[2][2];
+
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i]));
+    }
+    for (int i = 0; i < lookups; i++) {
+        probes.push_back(idGen.getRandNum());
+    }
+    for (int indexed = 0; indexed < 2; indexed++) {
+        team.enableIndex(indexed == 1);
+        start = clock();
+        for (int ID : probes) {
+            found[indexed] += team.findBot(ID);
+        }
+        stop = clock();
+        T[indexed][0] = (double)(stop - start) / CLOCKS_PER_SEC;
+        start = clock();
+        for (int ID : probes) {
+            team.setState(ID, (ID & 1) ? DEAD : ALIVE);
+        }
+        stop = clock();
+        T[indexed][1] = (double)(stop - start) / CLOCKS_PER_SEC;
+        cout << (indexed ? "with index: " : "without index: ") << lookups / T[indexed][0] / 1e6
+             << " million findBot/s, " << lookups / T[indexed][1] / 1e6 << " million setState/s" << endl;
+    }
+    return found[0] == found[1];
+}
+
+// Test that scalar and batched lookups on a frozen snapshot agree with the live tree for every
+// ID, INT32_MAX and other IDs the padding could match included, and that the snapshot lists the robots exactly like the live tree
+bool Tester::testFrozenSwarm()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    bool same = true;
+
+    for (int teamSize : { 0, 1, 7, 8, 1000, 50000 }) {
+        Swarm team;
+        for (int i = 0; i < teamSize; i++) {
+            Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+            team.insert(robot);
+            if (i % 3 == 0) team.setState(robot.getID(), DEAD);
+        }
+        FrozenSwarm frozen = team.freeze();
+        vector<int> probes = { INT32_MAX, MAXID + 1, INT32_MIN, INT32_MAX, INT32_MAX - 1, MAXID + 1, INT32_MAX, MINID - 1 };
+        for (int ID = MINID - 5; ID <= MAXID + 5; ID++) {
+            probes.push_back(ID);
+        }
+        vector<char> found(probes.size());
+        frozen.findBots(probes.data(), (bool*)found.data(), probes.size());
+        for (size_t i = 0; i < probes.size(); i++) {
+            bool expected = team.findBot(probes[i]);
+            same = same && frozen.findBot(probes[i]) == expected && (bool)found[i] == expected;
+        }
+        vector<char> scalar(probes.size());
+        vector<char> sse(probes.size());
+        frozen.findBotsScalar(probes.data(), (bool*)scalar.data(), probes.size());
+        frozen.findBotsSSE2(probes.data(), (bool*)sse.data(), probes.size());
+        same = same && scalar == found && sse == found;
+
+        stringstream live, snapshot;
+        streambuf* console = cout.rdbuf(live.rdbuf());
+        team.listRobots();
+        cout.rdbuf(snapshot.rdbuf());
+        frozen.listRobots();
+        cout.rdbuf(console);
+        same = same && live.str() == snapshot.str() && frozen.size() == countRobots(team.m_root);
+        cout << teamSize << " inserts: " << frozen.size() << " robots in " << frozen.m_levels << " levels" << endl;
+    }
+    return same;
+}
+
+// Run the same operations on Swarm and BTreeSwarm, compare the results and check that every
+// B+-tree node is sorted, within its separators and filled at least to the minimum, and that all
+// leaves are at the same depth
+bool Tester::testBTreeSwarm()
+{
+    static_assert(!is_copy_constructible<BTreeSwarm>::value && !is_copy_assignable<BTreeSwarm>::value,
+        "a copied BTreeSwarm would free its nodes twice");
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Swarm team;
+    BTreeSwarm btree;
+    int teamSize = 30000;
+    bool same = true;
+
+    for (int i = 0; i < teamSize; i++) {
+        Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+        btree.insert(robot);
+    }
+    same = same && btreeDepth(btree.m_root, MINID, MAXID, true) >= 0;
+    for (int i = 0; i < teamSize; i++) {
+        int ID = idGen.getRandNum();
+        team.remove(ID);
+        btree.remove(ID);
+        ID = idGen.getRandNum();
+        same = same && team.setState(ID, DEAD) == btree.setState(ID, DEAD);
+        if (i % 2 == 0) {
+            Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+            team.insert(robot);
+            btree.insert(robot);
+        }
+    }
+    same = same && btreeDepth(btree.m_root, MINID, MAXID, true) >= 0;
+    for (int round = 0; round < 2; round++) {
+        stringstream live, other;
+        streambuf* console = cout.rdbuf(live.rdbuf());
+        team.listRobots();
+        cout.rdbuf(other.rdbuf());
+        btree.listRobots();
+        cout.rdbuf(console);
+        same = same && live.str() == other.str() && btree.size() == countRobots(team.m_root);
+        team.removeDead();
+        btree.removeDead();
+        same = same && btreeDepth(btree.m_root, MINID, MAXID, true) >= 0;
+    }
+    vector<Robot*> robots;
+    collect(team.m_root, robots);
+    for (Robot* aBot : robots) {
+        btree.remove(aBot->getID());
+        same = same && !btree.findBot(aBot->getID());
+    }
+    cout << "B+-tree matched the AVL tree through " << teamSize << " inserts, removals and state changes" << endl;
+    return same && btree.size() == 0 && btree.m_root == nullptr;
+}
+
+// Depth of the leaves under node, -1 if a node breaks the B+-tree rules
+int Tester::btreeDepth(BTreeNode* node, long long low, long long high, bool isRoot)
+{
+    if (node == nullptr) {
+        return isRoot ? 0 : -1;
+    }
+    if (node->m_count > BTREE_KEYS || (!isRoot && node->m_count < BTREE_MIN_KEYS) || node->m_count < 1) {
+        return -1;
+    }
+    for (int i = 0; i < BTREE_KEYS; i++) {
+        if (i < node->m_count && (node->m_keys[i] < low || node->m_keys[i] > high ||
+            (i > 0 && node->m_keys[i - 1] >= node->m_keys[i]))) {
+            return -1;
+        }
+        if (i >= node->m_count && node->m_keys[i] != INT32_MAX) {
+            return -1;
+        }
+    }
+    if (node->m_leaf) {
+        return 0;
+    }
+    int depth = -2;
+    for (int i = 0; i <= node->m_count; i++) {
+        long long childLow = (i == 0) ? low : node->m_keys[i - 1];
+        long long childHigh = (i == node->m_count) ? high : node->m_keys[i] - 1;
+        int child = btreeDepth(node->m_children[i], childLow, childHigh, false);
+        if (child < 0 || (depth != -2 && child != depth)) {
+            return -1;
+        }
+        depth = child;
+    }
+    return depth + 1;
+}
+
+// Insert, lookup and ordered scan times of BTreeSwarm and Swarm. The key space holds 90,000 IDs,
+// so the largest size is the full key space instead of 1M.
+bool Tester::proveBTreeAgainstAVL()
+{
+    vector<int> ids = shuffledIDs();
+    Random idGen(MINID, MAXID);
+    const int lookups = 1000000;
+    vector<int> probes;
+    NullBuffer discard;
+    bool same = true;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    for (int i = 0; i < lookups; i++) {
+        probes.push_back(idGen.getRandNum());
+    }
+    for (int teamSize : { 10000, 45000, 90000 }) {
+        Swarm team;
+        BTreeSwarm btree;
+        double T[2][3];
+        int found[2] = { 0, 0 };
+
+        start = clock();
+        for (int i = 0; i < teamSize; i++) team.insert(Robot(ids[i]));
+        stop = clock();
+        T[0][0] = (double)(stop - start) / CLOCKS_PER_SEC;
+        start = clock();
+        for (int i = 0; i < teamSize; i++) btree.insert(Robot(ids[i]));
+        stop = clock();
+        T[1][0] = (double)(stop - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        for (int ID : probes) found[0] += team.findBot(ID);
+        stop = clock();
+        T[0][1] = (double)(stop - start) / CLOCKS_PER_SEC;
+        start = clock();
+        for (int ID : probes) found[1] += btree.findBot(ID);
+        stop = clock();
+        T[1][1] = (double)(stop - start) / CLOCKS_PER_SEC;
+
+        streambuf* console = cout.rdbuf(&discard);
+        start = clock();
+        team.listRobots();
+        stop = clock();
+        T[0][2] = (double)(stop - start) / CLOCKS_PER_SEC;
+        start = clock();
+        btree.listRobots();
+        stop = clock();
+        T[1][2] = (double)(stop - start) / CLOCKS_PER_SEC;
+        cout.rdbuf(console);
+
+        for (int backend = 0; backend < 2; backend++) {
+            cout << (backend ? "B+-tree" : "AVL    ") << " n = " << teamSize << ": insert "
+                 << T[backend][0] * 1e9 / teamSize << " ns/op, findBot " << T[backend][1] * 1e9 / lookups
+                 << " ns/op, ordered scan " << T[backend][2] * 1e9 / teamSize << " ns/robot" << endl;
+        }
+        same = same && found[0] == found[1];
+    }
+    return same;
+}
+
+// Test every balancing policy
+bool Tester::testBalancingPolicies()
+{
+    return testPolicy<AvlPolicy>(&Tester::avlValid) && testPolicy<RedBlackPolicy>(&Tester::redBlackValid) &&
+        testPolicy<WavlPolicy>(&Tester::wavlValid) && testPolicy<TreapPolicy>(&Tester::treapValid);
+}
+
+// Run random operations on a BalancedSwarm and a Swarm, compare them and check the policy's
+// invariants and the order of the IDs along the way
+template <class Policy>
+bool Tester::testPolicy(bool (Tester::*valid)(Robot*))
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Swarm team;
+    BalancedSwarm<Policy> balanced;
+    int teamSize = 20000;
+    bool same = true;
+
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < teamSize; i++) {
+            Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+            if (round % 2 == 0 || i % 3 == 0) {
+                team.insert(robot);
+                balanced.insert(robot);
+            }
+            if (round % 2 == 1 || i % 3 == 0) {
+                int ID = idGen.getRandNum();
+                team.remove(ID);
+                balanced.remove(ID);
+            }
+            if (i % 7 == 0) {
+                int ID = idGen.getRandNum();
+                same = same && team.setState(ID, DEAD) == balanced.setState(ID, DEAD);
+            }
+        }
+        same = same && (this->*valid)(balanced.m_root);
+    }
+    team.removeDead();
+    balanced.removeDead();
+    same = same && (this->*valid)(balanced.m_root);
+
+    vector<Robot*> expected, actual;
+    collect(team.m_root, expected);
+    collect(balanced.m_root, actual);
+    same = same && expected.size() == actual.size() && balanced.size() == (int)actual.size();
+    for (size_t i = 0; same && i < expected.size(); i++) {
+        same = expected[i]->getID() == actual[i]->getID() && expected[i]->getType() == actual[i]->getType() &&
+            expected[i]->getState() == actual[i]->getState();
+    }
+    for (Robot* aBot : expected) {
+        balanced.remove(aBot->getID());
+    }
+    cout << BalancedSwarm<Policy>::policyName() << ": " << (same ? "matches" : "differs from")
+         << " Swarm, " << balanced.rotations() << " rotations" << endl;
+    return same && balanced.size() == 0 && balanced.m_root == nullptr;
+}
+
+// Black height of a left-leaning red-black subtree, -1 if it breaks a rule
+int Tester::blackHeight(Robot* aBot)
+{
+    if (aBot == nullptr) {
+        return 0;
+    }
+    Robot* left = aBot->getLeft();
+    Robot* right = aBot->getRight();
+    if ((right != nullptr && right->getHeight() == RED_LINK) ||
+        (aBot->getHeight() == RED_LINK && left != nullptr && left->getHeight() == RED_LINK)) {
+        return -1;
+    }
+    int leftHeight = blackHeight(left);
+    int rightHeight = blackHeight(right);
+    if (leftHeight < 0 || leftHeight != rightHeight) {
+        return -1;
+    }
+    return leftHeight + (aBot->getHeight() == BLACK_LINK ? 1 : 0);
+}
+
+// True if every rank difference in the subtree is 1 or 2 and every leaf has rank 0
+bool Tester::wavlValid(Robot* aBot)
+{
+    if (aBot == nullptr) {
+        return true;
+    }
+    int leftDiff = aBot->getHeight() - BalancePolicy::rank(aBot->getLeft());
+    int rightDiff = aBot->getHeight() - BalancePolicy::rank(aBot->getRight());
+    bool leaf = aBot->getLeft() == nullptr && aBot->getRight() == nullptr;
+    return leftDiff >= 1 && leftDiff <= 2 && rightDiff >= 1 && rightDiff <= 2 &&
+        (!leaf || aBot->getHeight() == 0) && wavlValid(aBot->getLeft()) && wavlValid(aBot->getRight());
+}
+
+// True if no child has a higher priority than its parent
+bool Tester::treapValid(Robot* aBot)
+{
+    if (aBot == nullptr) {
+        return true;
+    }
+    return BalancePolicy::rank(aBot->getLeft()) <= aBot->getHeight() &&
+        BalancePolicy::rank(aBot->getRight()) <= aBot->getHeight() &&
+        treapValid(aBot->getLeft()) && treapValid(aBot->getRight());
+}
+
+// Rotations per operation and throughput of every policy on three workloads
+bool Tester::proveBalancingPolicies()
+{
+    runPolicyWorkloads<AvlPolicy>();
+    runPolicyWorkloads<RedBlackPolicy>();
+    runPolicyWorkloads<WavlPolicy>();
+    runPolicyWorkloads<TreapPolicy>();
+    return true;
+}
+
+// Insert-heavy: 90% inserts into a growing swarm. Delete-heavy: a full swarm drained with 90%
+// removals. Mixed: 50% inserts and 50% removals on a half full swarm.
+template <class Policy>
+void Tester::runPolicyWorkloads()
+{
+    const char* names[] = { "insert-heavy", "delete-heavy", "mixed" };
+    const int insertPercent[] = { 90, 10, 50 };
+    const int operations = 200000;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    for (int workload = 0; workload < 3; workload++) {
+        Random idGen(MINID, MAXID);
+        Random opGen(0, 99);
+        BalancedSwarm<Policy> balanced;
+        int prefill = (workload == 1) ? MAXID - MINID + 1 : (workload == 2 ? (MAXID - MINID + 1) / 2 : 0);
+        for (int ID : shuffledIDs()) {
+            if (prefill-- <= 0) break;
+            balanced.insert(Robot(ID));
+        }
+        vector<int> ops, ids;
+        for (int i = 0; i < operations; i++) {
+            ops.push_back(opGen.getRandNum());
+            ids.push_back(idGen.getRandNum());
+        }
+        long long before = balanced.rotations();
+        start = clock();
+        for (int i = 0; i < operations; i++) {
+            if (ops[i] < insertPercent[workload]) {
+                balanced.insert(Robot(ids[i]));
+            }
+            else {
+                balanced.remove(ids[i]);
+            }
+        }
+        stop = clock();
+        double T = (double)(stop - start) / CLOCKS_PER_SEC;
+        cout << Policy::name() << " " << names[workload] << ": "
+             << (double)(balanced.rotations() - before) / operations << " rotations/op, "
+             << operations / T / 1e6 << " million ops/s" << endl;
+    }
+}
+
+// One ingest thread inserts and removes robots of its own ID range while readers look up and
+// state writers flip robots that are never removed. Readers must always find those robots and
+// the final states must be the last ones written.
+bool Tester::testConcurrentSwarm()
+{
+    vector<int> ids = shuffledIDs();
+    ConcurrentSwarm team;
+    const int stable = 20000;//robots that stay in the tree
+    const int churn = 20000;//robots the ingest thread adds and removes
+    const int workers = 4;
+    atomic<bool> lost(false);
+    atomic<bool> done(false);
+
+    for (int i = 0; i < stable; i++) {
+        team.insert(Robot(ids[i]));
+    }
+    thread ingest([&]() {
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < churn; i++) team.insert(Robot(ids[stable + i]));
+            for (int i = 0; i < churn; i++) team.remove(ids[stable + i]);
+        }
+        done = true;
+    });
+    vector<thread> threads;
+    for (int w = 0; w < workers; w++) {
+        threads.emplace_back([&, w]() {
+            int i = w;
+            while (!done) {
+                if (!team.findBot(ids[i % stable])) lost = true;
+                // each worker owns the robots i % workers == w, so the last write is known
+                if (!team.setState(ids[i % stable], (i / stable) % 2 ? ALIVE : DEAD)) lost = true;
+                i += workers;
+            }
+            for (int k = w; k < stable; k += workers) team.setState(ids[k], DEAD);
+        });
+    }
+    ingest.join();
+    for (thread& worker : threads) worker.join();
+
+    bool valid = !lost && avlHeight(team.m_swarm.m_root) >= 0 && countRobots(team.m_swarm.m_root) == stable;
+    team.removeDead();
+    cout << "readers " << (lost ? "lost" : "always found") << " the stable robots, "
+         << countRobots(team.m_swarm.m_root) << " robots left after removeDead" << endl;
+    return valid && team.m_swarm.m_root == nullptr;
+}
+
+// Throughput of ConcurrentSwarm and of a Swarm behind one mutex with 1 thread up to all cores.
+// Reads are findBot. Writes are setState, except on thread 0, the ingest thread, which
+// alternates insert and remove.
+bool Tester::proveConcurrentThroughput()
+{
+    vector<int> ids = shuffledIDs();
+    const int teamSize = 64000;
+    const int opsPerThread = 200000;
+    const int readPercents[] = { 95, 50 };
+    vector<unsigned int> threadCounts;
+    unsigned int cores = thread::hardware_concurrency();
+    for (unsigned int threads = 1; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cores > 0 ? cores : 1);
+
+    for (int readPercent : readPercents) {
+        for (unsigned int threads : threadCounts) {
+            ConcurrentSwarm concurrent;
+            Swarm locked;
+            mutex global;
+            for (int i = 0; i < teamSize; i++) {
+                concurrent.insert(Robot(ids[i]));
+                locked.insert(Robot(ids[i]));
+            }
+            double rates[2];
+            for (int variant = 0; variant < 2; variant++) {
+                auto start = chrono::steady_clock::now();
+                vector<thread> workers;
+                for (unsigned int t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t, variant]() {
+                        Random opGen(0, 99);
+                        Random idGen(0, teamSize - 1);
+                        for (int i = 0; i < opsPerThread; i++) {
+                            int ID = ids[idGen.getRandNum()];
+                            bool read = opGen.getRandNum() < readPercent;
+                            if (variant == 0) {
+                                if (read) concurrent.findBot(ID);
+                                else if (t != 0) concurrent.setState(ID, DEAD);
+                                else if (i % 2) concurrent.insert(Robot(ids[teamSize + i % 1000]));
+                                else concurrent.remove(ids[teamSize + i % 1000]);
+                            }
+                            else {
+                                lock_guard<mutex> guard(global);
+                                if (read) locked.findBot(ID);
+                                else if (t != 0) locked.setState(ID, DEAD);
+                                else if (i % 2) locked.insert(Robot(ids[teamSize + i % 1000]));
+                                else locked.remove(ids[teamSize + i % 1000]);
+                            }
+                        }
+                    });
+                }
+                for (thread& worker : workers) worker.join();
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+                rates[variant] = threads * (double)opsPerThread / elapsed.count() / 1e6;
+            }
+            cout << readPercent << "/" << 100 - readPercent << " read/write, " << threads << " threads: concurrent "
+                 << rates[0] << " million ops/s, global mutex " << rates[1] << " million ops/s" << endl;
+        }
+    }
+    return true;
+}
+// Height of a persistent subtree, -2 if it breaks the BST or AVL property
+int Tester::persistentHeight(const PersistentRobot* aBot)
+{
+    if (aBot == nullptr) return -1;
+    int left = persistentHeight(aBot->getLeft());
+    int right = persistentHeight(aBot->getRight());
+    if (left == -2 || right == -2 || abs(left - right) > 1) return -2;
+    if (aBot->getLeft() != nullptr && aBot->getLeft()->getID() >= aBot->getID()) return -2;
+    if (aBot->getRight() != nullptr && aBot->getRight()->getID() <= aBot->getID()) return -2;
+    if (aBot->getHeight() != 1 + max(left, right)) return -2;
+    return aBot->getHeight();
+}
+
+// A snapshot taken before a series of writes must list exactly the robots it saw, and a new
+// snapshot must match a plain Swarm given the same writes. Readers then walk snapshots while a
+// writer churns the tree, and every snapshot must be sorted and hold its recorded size. Once
+// the snapshots are gone the next write frees every retired node.
+bool Tester::testPersistentSwarm()
+{
+    vector<int> ids = shuffledIDs();
+    PersistentSwarm team;
+    Swarm reference;
+    const int teamSize = 5000;
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i]));
+        reference.insert(Robot(ids[i]));
+    }
+
+    bool kept = false;
+    bool matches = false;
+    bool pinned = false;
+    vector<int> current;
+    {
+        SwarmSnapshot before = team.snapshot();
+        vector<pair<int, STATE>> seen;
+        before.forEach([&](const PersistentRobot& aBot) { seen.push_back({aBot.getID(), aBot.getState()}); });
+        for (int i = 0; i < teamSize; i += 3) {
+            team.remove(ids[i]);
+            reference.remove(ids[i]);
+        }
+        for (int i = 1; i < teamSize; i += 3) {
+            team.setState(ids[i], DEAD);
+            reference.setState(ids[i], DEAD);
+        }
+        for (int i = teamSize; i < 2 * teamSize; i++) {
+            team.insert(Robot(ids[i]));
+            reference.insert(Robot(ids[i]));
+        }
+        team.removeDead();
+        reference.removeDead();
+
+        vector<pair<int, STATE>> again;
+        before.forEach([&](const PersistentRobot& aBot) { again.push_back({aBot.getID(), aBot.getState()}); });
+        kept = again == seen && (int)seen.size() == teamSize && before.size() == teamSize
+            && before.findBot(ids[0]) && !before.findBot(ids[teamSize]);
+
+        SwarmSnapshot after = team.snapshot();
+        vector<Robot*> expected;
+        collect(reference.m_root, expected);
+        after.forEach([&](const PersistentRobot& aBot) { current.push_back(aBot.getID()); });
+        matches = (int)current.size() == after.size() && current.size() == expected.size()
+            && persistentHeight(after.m_root) >= 0;
+        for (size_t i = 0; matches && i < current.size(); i++) {
+            matches = current[i] == expected[i]->getID();
+        }
+        pinned = !team.m_retiredNodes.empty();
+    }
+    cout << "old snapshot " << (kept ? "unchanged" : "CHANGED") << ", new snapshot "
+         << (matches ? "matches" : "DIFFERS FROM") << " the plain swarm" << endl;
+
+    atomic<bool> done(false);
+    atomic<bool> broken(false);
+    atomic<int> walks(0);
+    vector<thread> readers;
+    for (int r = 0; r < 3; r++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                SwarmSnapshot view = team.snapshot();
+                int count = 0;
+                int last = 0;
+                view.forEach([&](const PersistentRobot& aBot) {
+                    if (aBot.getID() <= last) broken = true;
+                    last = aBot.getID();
+                    count++;
+                });
+                if (count != view.size()) broken = true;
+                walks++;
+            }
+        });
+    }
+    for (int round = 0; round < 2; round++) {
+        for (int i = 2 * teamSize; i < 4 * teamSize; i++) team.insert(Robot(ids[i]));
+        for (int i = 2 * teamSize; i < 4 * teamSize; i += 2) team.setState(ids[i], DEAD);
+        for (int i = 2 * teamSize; i < 4 * teamSize; i += 4) team.remove(ids[i]);
+        team.removeDead();
+    }
+    done = true;
+    for (thread& reader : readers) reader.join();
+    cout << walks << " snapshot walks during the writes, " << (broken ? "some broken" : "all consistent") << endl;
+
+    bool valid = false;
+    {
+        SwarmSnapshot last = team.snapshot();
+        valid = persistentHeight(last.m_root) >= 0 && last.size() == (int)current.size() + teamSize;
+    }
+    team.insert(Robot(ids[4 * teamSize]));
+    bool reclaimed = team.m_retiredNodes.empty() && team.m_retiredVersions.empty();
+    cout << "retired nodes " << (reclaimed ? "freed" : "NOT freed") << " once the snapshots were released" << endl;
+    return kept && matches && pinned && !broken && valid && reclaimed;
+}
+
+// Apply the same robots through insertBatch and through looped insert, duplicates and out of
+// range IDs included, then the same IDs through removeBatch and looped remove. Both trees must
+// hold the same robots and the batched one must stay a valid AVL tree with a correct index.
+bool Tester::testBatchOperations()
+{
+    Random idGen(MINID, MAXID);
+    Random typeGen(0, 4);
+    Swarm team;
+    Swarm reference;
+    team.enableIndex(true);
+    int teamSize = 3000;
+    int batchSize = 2000;
+
+    for (int i = 0; i < teamSize; i++) {
+        Robot robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum()));
+        team.insert(robot);
+        reference.insert(robot);
+    }
+    vector<Robot> batch;
+    for (int i = 0; i < batchSize; i++) {
+        batch.push_back(Robot(idGen.getRandNum(), static_cast<ROBOTTYPE>(typeGen.getRandNum())));
+    }
+    batch.push_back(Robot(225));
+    batch.push_back(Robot(558855544));
+    batch.push_back(Robot(batch[0].getID(), batch[0].getType() == SUB ? BIRD : SUB, DEAD));
+    int before = countRobots(team.m_root);
+    int added = team.insertBatch(batch.begin(), batch.end());
+    for (const Robot& robot : batch) {
+        reference.insert(robot);
+    }
+
+    vector<int> ids;
+    for (int i = 0; i < batchSize; i++) {
+        ids.push_back(i % 2 ? batch[i].getID() : idGen.getRandNum());//mostly in the tree, some not
+        ids.push_back(ids.back());
+    }
+    int middle = countRobots(team.m_root);
+    int removed = team.removeBatch(ids.begin(), ids.end());
+    for (int id : ids) {
+        reference.remove(id);
+    }
+
+    vector<Robot*> expected, actual;
+    collect(reference.m_root, expected);
+    collect(team.m_root, actual);
+    bool same = expected.size() == actual.size();
+    for (size_t i = 0; same && i < expected.size(); i++) {
+        same = expected[i]->getID() == actual[i]->getID() && expected[i]->getType() == actual[i]->getType() &&
+            expected[i]->getState() == actual[i]->getState() && team.m_index[actual[i]->getID() - MINID] == actual[i];
+    }
+    for (int id : ids) {
+        same = same && !team.findBot(id);
+    }
+    cout << "added " << added << " of " << batch.size() << ", removed " << removed << " of " << ids.size()
+         << ", " << actual.size() << " robots left" << endl;
+    bool counted = added == middle - before && removed == middle - (int)actual.size();
+
+    // a batch into an empty tree and a batch removing everything
+    Swarm empty;
+    empty.insertBatch(batch.begin(), batch.begin() + 16);
+    vector<int> all;
+    for (int i = 0; i < 16; i++) {
+        all.push_back(batch[i].getID());
+    }
+    bool built = avlHeight(empty.m_root) >= 0 && countRobots(empty.m_root) > 0;
+    empty.removeBatch(all.begin(), all.end());
+    return same && counted && built && empty.m_root == nullptr && avlHeight(team.m_root) >= 0 &&
+        team.bstProperty(team.m_root, MINID, MAXID);
+}
+
+// Per-robot cost of insertBatch/removeBatch against looped insert/remove. 65,536 new robots are
+// added to a swarm of 20,000 in batches of each size and then removed in the same batches.
+// The ID range caps the largest batch at 65,536 instead of 100k.
+bool Tester::proveBatchCost()
+{
+    vector<int> ids = shuffledIDs();
+    const int teamSize = 20000;
+    const int total = 65536;
+    clock_t start, stop;//stores the clock ticks while running the program
+    bool valid = true;
+
+    for (int batchSize = 16; batchSize <= total; batchSize *= 8) {
+        double ns[4];//looped insert, batched insert, looped remove, batched remove
+        for (int batched = 0; batched < 2; batched++) {
+            Swarm team(ids.begin(), ids.begin() + teamSize);
+            start = clock();
+            for (int b = teamSize; b < teamSize + total; b += batchSize) {
+                if (batched) {
+                    vector<Robot> batch(ids.begin() + b, ids.begin() + b + batchSize);
+                    team.insertBatch(batch.begin(), batch.end());
+                }
+                else {
+                    for (int i = b; i < b + batchSize; i++) team.insert(Robot(ids[i]));
+                }
+            }
+            stop = clock();
+            ns[batched] = 1e9 * (double)(stop - start) / CLOCKS_PER_SEC / total;
+            valid = valid && countRobots(team.m_root) == teamSize + total;
+
+            start = clock();
+            for (int b = teamSize; b < teamSize + total; b += batchSize) {
+                if (batched) {
+                    team.removeBatch(ids.begin() + b, ids.begin() + b + batchSize);
+                }
+                else {
+                    for (int i = b; i < b + batchSize; i++) team.remove(ids[i]);
+                }
+            }
+            stop = clock();
+            ns[2 + batched] = 1e9 * (double)(stop - start) / CLOCKS_PER_SEC / total;
+            valid = valid && avlHeight(team.m_root) >= 0 && countRobots(team.m_root) == teamSize;
+        }
+        cout << "batch " << batchSize << ": insert " << ns[0] << " ns/robot looped, " << ns[1] << " batched; remove "
+             << ns[2] << " ns/robot looped, " << ns[3] << " batched" << endl;
+    }
+    return valid;
+}
+
+// Counts by type and state plus an ID histogram, and the list of IDs, which only comes out in
+// order if the partials are combined in order. Each must match a sequential walk for pools of
+// 1, 2 and 4 threads.
+bool Tester::testParallelReduce()
+{
+    vector<int> ids = shuffledIDs();
+    vector<Robot> robots;
+    for (size_t i = 0; i < ids.size(); i++) {
+        robots.push_back(Robot(ids[i], static_cast<ROBOTTYPE>(i % 5), i % 3 ? ALIVE : DEAD));
+    }
+    Swarm team(robots.begin(), robots.end());
+    typedef array<int, 19> Counts;//5 types, 2 states, 12 ID buckets of 8,192
+    auto visit = [](Counts& counts, const Robot& robot) {
+        counts[robot.getType()]++;
+        counts[5 + robot.getState()]++;
+        counts[7 + (robot.getID() - MINID) / 8192]++;
+    };
+    auto add = [](const Counts& first, const Counts& second) {
+        Counts sum;
+        for (size_t i = 0; i < sum.size(); i++) sum[i] = first[i] + second[i];
+        return sum;
+    };
+    Counts expected = {};
+    vector<Robot*> sorted;
+    collect(team.m_root, sorted);
+    for (Robot* aBot : sorted) {
+        visit(expected, *aBot);
+    }
+
+    bool same = true;
+    for (unsigned threads = 1; threads <= 4; threads *= 2) {
+        WorkStealingPool pool(threads);
+        Counts counts = team.parallelReduce(Counts(), visit, add, pool);
+        vector<int> order = team.parallelReduce(vector<int>(),
+            [](vector<int>& list, const Robot& robot) { list.push_back(robot.getID()); },
+            [](const vector<int>& first, const vector<int>& second) {
+                vector<int> joined(first);
+                joined.insert(joined.end(), second.begin(), second.end());
+                return joined;
+            }, pool);
+        bool ordered = order.size() == sorted.size();
+        for (size_t i = 0; ordered && i < order.size(); i++) {
+            ordered = order[i] == sorted[i]->getID();
+        }
+        cout << threads << " threads: counts " << (counts == expected ? "match" : "DIFFER")
+             << ", IDs " << (ordered ? "in order" : "OUT OF ORDER") << endl;
+        same = same && counts == expected && ordered;
+    }
+    Swarm empty;
+    return same && empty.parallelReduce(0, [](int& n, const Robot&) { n++; }, plus<int>()) == 0 &&
+        team.parallelReduce(0, [](int& n, const Robot&) { n++; }, plus<int>()) == (int)ids.size();
+}
+
+// Time 200 reductions of the type, state and ID histogram over 90,000 robots with pools of 1
+// thread up to all cores. The ID range caps the swarm at 90,000 robots instead of millions.
+bool Tester::proveParallelReduceSpeedup()
+{
+    vector<int> ids = shuffledIDs();
+    vector<Robot> robots;
+    for (size_t i = 0; i < ids.size(); i++) {
+        robots.push_back(Robot(ids[i], static_cast<ROBOTTYPE>(i % 5), i % 3 ? ALIVE : DEAD));
+    }
+    Swarm team(robots.begin(), robots.end());
+    typedef array<int, 19> Counts;
+    auto visit = [](Counts& counts, const Robot& robot) {
+        counts[robot.getType()]++;
+        counts[5 + robot.getState()]++;
+        counts[7 + (robot.getID() - MINID) / 8192]++;
+    };
+    auto add = [](const Counts& first, const Counts& second) {
+        Counts sum;
+        for (size_t i = 0; i < sum.size(); i++) sum[i] = first[i] + second[i];
+        return sum;
+    };
+    const int rounds = 200;
+    vector<unsigned int> threadCounts;
+    unsigned int cores = thread::hardware_concurrency();
+    for (unsigned int threads = 1; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cores > 0 ? cores : 1);
+
+    bool valid = true;
+    double single = 0;
+    for (unsigned int threads : threadCounts) {
+        WorkStealingPool pool(threads);
+        Counts counts = {};
+        auto start = chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            counts = team.parallelReduce(Counts(), visit, add, pool);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (threads == 1) {
+            single = seconds;
+        }
+        valid = valid && counts[0] + counts[1] + counts[2] + counts[3] + counts[4] == (int)ids.size();
+        cout << threads << " threads: " << seconds << " seconds, speedup " << single / seconds << endl;
+    }
+    return valid;
+}
+
+// Compare the counters of team and the type counts of every node with a full count, and 200
+// random ID ranges of countByType with counting the sorted robots
+bool Tester::countersMatch(Swarm& team)
+{
+    vector<Robot*> robots;
+    collect(team.m_root, robots);
+    int states[STATE_COUNT] = {};
+    int types[TYPE_COUNT] = {};
+    bool nodes = true;
+    for (Robot* aBot : robots) {
+        states[aBot->getState()]++;
+        types[aBot->getType()]++;
+        for (int type = 0; type < TYPE_COUNT; type++) {
+            int below = (aBot->m_left != nullptr ? aBot->m_left->m_typeCounts[type] : 0) +
+                (aBot->m_right != nullptr ? aBot->m_right->m_typeCounts[type] : 0) + (aBot->m_type == type);
+            nodes = nodes && aBot->m_typeCounts[type] == below;
+        }
+    }
+    bool totals = true;
+    for (int state = 0; state < STATE_COUNT; state++) {
+        totals = totals && team.countByState(static_cast<STATE>(state)) == states[state];
+    }
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        totals = totals && team.countByType(static_cast<ROBOTTYPE>(type)) == types[type];
+    }
+    Random idGen(MINID - 10, MAXID + 10);
+    bool ranges = true;
+    for (int i = 0; i < 200; i++) {
+        int low = idGen.getRandNum();
+        int high = idGen.getRandNum();
+        ROBOTTYPE type = static_cast<ROBOTTYPE>(i % TYPE_COUNT);
+        int expected = 0;
+        for (Robot* aBot : robots) {
+            expected += aBot->getID() >= low && aBot->getID() <= high && aBot->getType() == type;
+        }
+        ranges = ranges && team.countByType(type, low, high) == expected;
+    }
+    return nodes && totals && ranges;
+}
+
+// Keep the counters up to date through insert, remove, setState, both removeDead paths, the
+// batch calls, assign and clear, and through a ConcurrentSwarm
+bool Tester::testTypeStateCounters()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team;
+    int teamSize = 4000;
+    bool valid = true;
+
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT)));
+    }
+    valid = valid && countersMatch(team) && team.countByState(ALIVE) == teamSize;
+    for (int i = 0; i < teamSize; i += 7) {
+        team.remove(ids[i]);
+    }
+    for (int i = 1; i < teamSize; i += 3) {
+        team.setState(ids[i], DEAD);
+        team.setState(ids[i], DEAD);//no change the second time
+    }
+    valid = valid && countersMatch(team);
+    team.removeDead();
+    valid = valid && countersMatch(team) && team.countByState(DEAD) == 0;
+
+    Robot* root = team.m_root;
+    team.removeDead();//nothing to remove, the tree is not rebuilt
+    valid = valid && team.m_root == root;
+
+    vector<Robot> batch;
+    for (int i = teamSize; i < 2 * teamSize; i++) {
+        batch.push_back(Robot(ids[i], static_cast<ROBOTTYPE>(i % 3), i % 2 ? ALIVE : DEAD));
+    }
+    team.insertBatch(batch.begin(), batch.end());
+    team.removeBatch(ids.begin() + teamSize / 2, ids.begin() + teamSize + teamSize / 2);
+    team.removeIf([](const Robot& robot) { return robot.getType() == REPTILE; });
+    valid = valid && countersMatch(team);
+    team.assign(batch.begin(), batch.end());
+    valid = valid && countersMatch(team) && team.countByState(DEAD) == teamSize / 2;
+    ROBOTTYPE badType = static_cast<ROBOTTYPE>(7);//unknown types are ignored, never counted out of bounds
+    team.insert(Robot(ids[3 * teamSize], badType));
+    team.emplace(ids[3 * teamSize + 1], badType, DEAD);
+    vector<Robot> strays = { Robot(ids[3 * teamSize + 2], badType), Robot(ids[3 * teamSize + 3], badType, DEAD) };
+    team.insertBatch(strays.begin(), strays.end());
+    valid = valid && team.size() == teamSize && countersMatch(team) && team.countByType(badType) == 0 &&
+        team.countByType(badType, MINID, MAXID) == 0;
+    team.clear();
+    valid = valid && countersMatch(team) && team.countByType(BIRD) == 0;
+
+    ConcurrentSwarm shared;
+    for (int i = 0; i < teamSize; i++) {
+        shared.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT)));
+    }
+    vector<thread> workers;
+    for (int w = 0; w < 4; w++) {
+        workers.emplace_back([&, w]() {
+            for (int i = w; i < teamSize; i += 4) shared.setState(ids[i], i % 2 ? DEAD : ALIVE);
+        });
+    }
+    for (thread& worker : workers) worker.join();
+    valid = valid && shared.countByState(DEAD) == teamSize / 2 && countersMatch(shared.m_swarm) &&
+        shared.countByType(SUB, MINID, MAXID) == teamSize / TYPE_COUNT;
+    shared.removeDead();
+    cout << "counters " << (valid ? "match" : "DO NOT MATCH") << " a full count, " << shared.countByState(ALIVE)
+         << " robots alive after removeDead" << endl;
+    return valid && shared.countByState(DEAD) == 0 && shared.countByState(ALIVE) == teamSize / 2;
+}
+
+// Check every query against the sorted robots after inserts and removals, which rotate the
+// subtree sizes around, and check the size of every node
+bool Tester::testOrderStatistics()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team;
+    int teamSize = 5000;
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT)));
+    }
+    for (int i = 0; i < teamSize; i += 4) {
+        team.remove(ids[i]);
+    }
+    team.insertBatch(ids.begin() + teamSize, ids.begin() + teamSize + 100);
+
+    vector<Robot*> robots;
+    collect(team.m_root, robots);
+    bool sizes = team.size() == (int)robots.size();
+    for (Robot* aBot : robots) {
+        sizes = sizes && aBot->m_size == 1 + (aBot->m_left != nullptr ? aBot->m_left->m_size : 0) +
+            (aBot->m_right != nullptr ? aBot->m_right->m_size : 0);
+    }
+
+    bool ranks = team.select(-1) == nullptr && team.select(team.size()) == nullptr;
+    for (size_t k = 0; k < robots.size(); k++) {
+        ranks = ranks && team.select((int)k) == robots[k] && team.rank(robots[k]->getID()) == (int)k &&
+            team.rank(robots[k]->getID() + 1) == (int)k + 1;
+    }
+
+    Random idGen(MINID - 10, MAXID + 10);
+    bool ranges = team.countInRange(MAXID, MINID) == 0;
+    for (int i = 0; i < 300; i++) {
+        int low = idGen.getRandNum();
+        int high = low + idGen.getRandNum() % 20000;
+        vector<int> expected, actual;
+        for (Robot* aBot : robots) {
+            if (aBot->getID() >= low && aBot->getID() <= high) expected.push_back(aBot->getID());
+        }
+        team.forEachInRange(low, high, [&](const Robot& aBot) { actual.push_back(aBot.getID()); });
+        ranges = ranges && actual == expected && team.countInRange(low, high) == (int)expected.size();
+    }
+
+    // pages of 7 robots, the last one short, printed as listRobots() would
+    bool pages = true;
+    int pageSize = 7;
+    for (int page = 0; page * pageSize < (int)robots.size() + pageSize; page++) {
+        stringstream expected, actual;
+        for (int k = page * pageSize; k < (page + 1) * pageSize && k < (int)robots.size(); k++) {
+            expected << robots[k]->getID() << ":" << robots[k]->getStateStr() << ":" << robots[k]->getTypeStr() << endl;
+        }
+        streambuf* console = cout.rdbuf(actual.rdbuf());
+        team.listRobots(page, pageSize);
+        cout.rdbuf(console);
+        pages = pages && actual.str() == expected.str();
+    }
+    cout << team.size() << " robots: sizes " << (sizes ? "valid" : "INVALID") << ", rank/select "
+         << (ranks ? "agree" : "DISAGREE") << ", ranges " << (ranges ? "match" : "DO NOT MATCH")
+         << ", pages " << (pages ? "match" : "DO NOT MATCH") << endl;
+    return sizes && ranks && ranges && pages;
+}
+
+// Time listing the last page of 50 robots 100 times with listRobots(page, pageSize) and by
+// walking the IDs in order from the smallest, which costs O(n) for the last page. Both must list
+// the same page; how long they take is only reported.
+bool Tester::proveOrderStatistics()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team(ids.begin(), ids.end());
+    const int pageSize = 50;
+    const int rounds = 100;
+    int lastPage = (team.size() - 1) / pageSize;
+    stringstream walked, selected;
+    streambuf* console = cout.rdbuf(walked.rdbuf());
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        int skip = lastPage * pageSize;
+        team.forEachInRange(MINID, MAXID, [&](const Robot& aBot) {
+            if (skip-- <= 0) cout << aBot.getID() << ":" << aBot.getStateStr() << ":" << aBot.getTypeStr() << endl;
+        });
+    }
+    stop = clock();
+    double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    cout.rdbuf(selected.rdbuf());
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        team.listRobots(lastPage, pageSize);
+    }
+    stop = clock();
+    double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+    cout.rdbuf(console);
+
+    cout << "last page of " << team.size() << " robots, " << rounds << " times: walk " << T1
+         << " seconds, select " << T2 << " seconds" << endl;
+    return walked.str() == selected.str() && !selected.str().empty();
+}
+
+// Walk forwards and backwards, resume from lower_bound/upper_bound/find, and feed the iterators
+// to std algorithms; everything must agree with the sorted robots
+bool Tester::testIterators()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team;
+    int teamSize = 3000;
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT)));
+    }
+    for (int i = 0; i < teamSize; i += 5) {
+        team.remove(ids[i]);
+    }
+    vector<Robot*> robots;
+    collect(team.m_root, robots);
+
+    vector<const Robot*> forwards, backwards;
+    for (const Robot& aBot : team) {
+        forwards.push_back(&aBot);
+    }
+    for (Swarm::const_iterator it = team.end(); it != team.begin();) {
+        --it;
+        backwards.push_back(&*it);
+    }
+    reverse(backwards.begin(), backwards.end());
+    bool walks = forwards.size() == robots.size() && backwards.size() == robots.size();
+    for (size_t i = 0; walks && i < robots.size(); i++) {
+        walks = forwards[i] == robots[i] && backwards[i] == robots[i];
+    }
+
+    Random idGen(MINID - 10, MAXID + 10);
+    bool bounds = true;
+    for (int i = 0; i < 500; i++) {
+        int id = idGen.getRandNum();
+        size_t lower = 0;
+        while (lower < robots.size() && robots[lower]->getID() < id) lower++;
+        size_t upper = (lower < robots.size() && robots[lower]->getID() == id) ? lower + 1 : lower;
+        Swarm::const_iterator low = team.lower_bound(id), high = team.upper_bound(id), hit = team.find(id);
+        bounds = bounds && (lower == robots.size() ? low == team.end() : &*low == robots[lower]);
+        bounds = bounds && (upper == robots.size() ? high == team.end() : &*high == robots[upper]);
+        bounds = bounds && (upper == lower ? hit == team.end() : &*hit == robots[lower]);
+        bounds = bounds && distance(low, high) == (int)(upper - lower);
+        if (lower > 0) {
+            bounds = bounds && &*prev(low) == robots[lower - 1];//step back from a resumed position
+        }
+    }
+
+    // std algorithms over the swarm
+    int subs = (int)count_if(team.begin(), team.end(), [](const Robot& aBot) { return aBot.getType() == SUB; });
+    bool sorted = is_sorted(team.begin(), team.end(), [](const Robot& first, const Robot& second) {
+        return first.getID() < second.getID();
+    });
+    auto last = make_reverse_iterator(team.end());
+    bool algorithms = subs == team.countByType(SUB) && sorted && distance(team.begin(), team.end()) == team.size() &&
+        &*last == robots.back() && team.find(robots[0]->getID()) == team.begin();
+
+    Swarm empty;
+    bool emptyWalk = empty.begin() == empty.end() && empty.lower_bound(MINID) == empty.end();
+    cout << "walks " << (walks ? "match" : "DO NOT MATCH") << ", bounds " << (bounds ? "match" : "DO NOT MATCH")
+         << ", " << subs << " SUBs counted with count_if" << endl;
+    return walks && bounds && algorithms && emptyWalk;
+}
+
+// Scan 90,000 robots 20 times with traverseTree and with the iterators, both printing every
+// robot to a null stream, then once more with the iterators summing the IDs, which shows the
+// cost of the walk itself. The ID range caps the tree at 90,000 nodes instead of 1M.
+bool Tester::proveIteratorScan()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team(ids.begin(), ids.end());
+    const int rounds = 20;
+    NullBuffer nothing;
+    streambuf* console = cout.rdbuf(&nothing);
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        team.traverseTree(team.m_root);
+    }
+    stop = clock();
+    double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        for (const Robot& aBot : team) {
+            cout << aBot.getID() << ":" << aBot.getStateStr() << ":" << aBot.getTypeStr() << endl;
+        }
+    }
+    stop = clock();
+    double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+    cout.rdbuf(console);
+
+    long long sum = 0;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        for (const Robot& aBot : team) {
+            sum += aBot.getID();
+        }
+    }
+    stop = clock();
+    double T3 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    long long expected = 0;
+    for (int id : ids) {
+        expected += id;
+    }
+    cout << rounds << " scans of " << team.size() << " robots: traverseTree " << T1 << " seconds, iterators "
+         << T2 << " seconds, iterators without output " << T3 << " seconds" << endl;
+    return sum == expected * rounds;
+}
+
+// The text dumpTree() printed before the output sink, written with ostream operators
+void Tester::dumpText(Robot* aBot, ostream& out)
+{
+    if (aBot != nullptr) {
+        out << "(";
+        dumpText(aBot->m_left, out);
+        out << aBot->m_id << ":" << aBot->m_height;
+        dumpText(aBot->m_right, out);
+        out << ")";
+    }
+}
+
+// List 5,000 robots, more than one sink buffer, through cout, an ostream sink, a file
+// descriptor and caller memory, and dump the tree; all must match the stream-based text. Caller
+// memory that is too small must hold the start of the text and report the overflow. Sinks made
+// one after the other must reuse the staging buffer, and two at once must not share it. Every
+// other backend must list the same robots as the same text, through cout and through a sink.
+bool Tester::testOutputSink()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team;
+    int teamSize = 5000;
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), i % 3 ? ALIVE : DEAD));
+    }
+    stringstream expected, listed, streamed, dumped, expectedDump;
+    streambuf* console = cout.rdbuf(expected.rdbuf());
+    team.traverseTree(team.m_root);
+    cout.rdbuf(listed.rdbuf());
+    team.listRobots();
+    cout.rdbuf(dumped.rdbuf());
+    team.dumpTree();
+    cout.rdbuf(console);
+    dumpText(team.m_root, expectedDump);
+    {
+        OutputSink out(streamed);
+        team.listRobots(out);
+    }
+    string text = expected.str();
+
+    vector<char> memory(text.size() + 10);
+    OutputSink full(memory.data(), memory.size());
+    team.listRobots(full);
+    bool inMemory = !full.overflowed() && full.written() == text.size() && string(memory.data(), full.written()) == text;
+    char small[100];
+    OutputSink partial(small, sizeof(small));
+    team.listRobots(partial);
+    bool truncated = partial.overflowed() && string(small, sizeof(small)) == text.substr(0, sizeof(small));
+
+    FILE* file = tmpfile();
+    {
+        OutputSink out(fileno(file));
+        team.listRobots(out);
+    }
+    string fromFile(text.size() + 10, '\0');
+    fseek(file, 0, SEEK_SET);
+    fromFile.resize(fread(&fromFile[0], 1, fromFile.size(), file));
+    fclose(file);
+
+    const char* staging = nullptr;
+    {
+        OutputSink first(streamed);
+        staging = first.m_buffer;
+    }
+    stringstream outer, inner;
+    bool reused = false;
+    {
+        OutputSink again(outer);//the staging buffer of the thread is lent out again
+        OutputSink nested(inner);//while it is lent, a second sink needs a buffer of its own
+        reused = again.m_buffer == staging && nested.m_buffer != staging;
+        team.listRobots(again);
+        team.listRobots(nested);
+    }
+    reused = reused && outer.str() == text && inner.str() == text;
+
+    CompactSwarm compact;
+    BTreeSwarm btree;
+    BalancedSwarm<> balanced;
+    ConcurrentSwarm concurrent;
+    PersistentSwarm persistent;
+    for (const Robot& aBot : team) {
+        Robot copy(aBot.getID(), aBot.getType(), aBot.getState());
+        compact.insert(copy);
+        btree.insert(copy);
+        balanced.insert(copy);
+        concurrent.insert(copy);
+        persistent.insert(copy);
+    }
+    FrozenSwarm frozen(team);
+    SwarmSnapshot snapshot = persistent.snapshot();
+    bool backends = true;
+    auto listsAsTeam = [&](auto& backend) {
+        stringstream printed, sunk;
+        streambuf* saved = cout.rdbuf(printed.rdbuf());
+        backend.listRobots();
+        cout.rdbuf(saved);
+        {
+            OutputSink out(sunk);
+            backend.listRobots(out);
+        }
+        backends = backends && printed.str() == text && sunk.str() == text;
+    };
+    listsAsTeam(compact);
+    listsAsTeam(frozen);
+    listsAsTeam(btree);
+    listsAsTeam(balanced);
+    listsAsTeam(concurrent);
+    listsAsTeam(persistent);
+    listsAsTeam(snapshot);
+
+    bool same = listed.str() == text && streamed.str() == text && fromFile == text && dumped.str() == expectedDump.str() &&
+        reused && backends;
+    cout << text.size() << " bytes listed: cout, ostream and file descriptor sinks " << (same ? "match" : "DO NOT MATCH")
+         << ", caller memory " << (inMemory ? "matches" : "DOES NOT MATCH") << ", small memory "
+         << (truncated ? "truncated" : "NOT TRUNCATED") << endl;
+    return same && inMemory && truncated && text.size() > SINK_BUFFER_SIZE;
+}
+
+// List 90,000 robots 10 times with the stream-based traverseTree and through sinks to a null
+// stream, /dev/null and caller memory, and report MB/s. The ID range caps the listing at 90,000
+// robots instead of 1M. Only the listing is checked; the rates vary with the machine and under
+// sanitizers, so they are printed for comparison and never fail the test.
+bool Tester::proveOutputSinkThroughput()
+{
+    vector<int> ids = shuffledIDs();
+    vector<Robot> robots;
+    for (size_t i = 0; i < ids.size(); i++) {
+        robots.push_back(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), i % 3 ? ALIVE : DEAD));
+    }
+    Swarm team(robots.begin(), robots.end());
+    const int rounds = 10;
+    NullBuffer nothing;
+    ostream discard(&nothing);
+    clock_t start, stop;//stores the clock ticks while running the program
+    double seconds[4];
+
+    streambuf* console = cout.rdbuf(&nothing);
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        team.traverseTree(team.m_root);
+    }
+    stop = clock();
+    cout.rdbuf(console);
+    seconds[0] = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        OutputSink out(discard);
+        team.listRobots(out);
+    }
+    stop = clock();
+    seconds[1] = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    int devNull = open("/dev/null", O_WRONLY);
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        OutputSink out(devNull);
+        team.listRobots(out);
+    }
+    stop = clock();
+    close(devNull);
+    seconds[2] = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    vector<char> memory(4 * 1024 * 1024);
+    size_t bytes = 0;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        OutputSink out(memory.data(), memory.size());
+        team.listRobots(out);
+        bytes = out.written();
+    }
+    stop = clock();
+    seconds[3] = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    const char* names[] = { "traverseTree with cout", "sink to ostream", "sink to /dev/null", "sink to memory" };
+    for (int i = 0; i < 4; i++) {
+        cout << names[i] << ": " << (double)bytes * rounds / 1e6 / seconds[i] << " MB/s" << endl;
+    }
+    return bytes > 0;
+}
+
+// Create an empty file in /tmp whose name ends in suffix and is unique to this run, so that two
+// test runs at once never share a file. The test that asks for it removes it when done.
+string Tester::scratchFile(const string& suffix)
+{
+    string name = "/tmp/mytest_swarm_XXXXXX" + suffix;
+    vector<char> path(name.begin(), name.end());
+    path.push_back('\0');
+    int fd = mkstemps(path.data(), (int)suffix.size());
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    return string(path.data());
+}
+
+// Save a swarm, load it into another one and map it; both must list the same robots and the
+// mapping must answer every lookup. Files with a flipped record byte, a cut-off end or a bad
+// magic number must be rejected without touching the swarm they are loaded into.
+bool Tester::testSaveLoad()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team;
+    int teamSize = 4000;
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), i % 3 ? ALIVE : DEAD));
+    }
+    string path = scratchFile(".bin");
+    bool saved = team.save(path);
+
+    Swarm loaded;
+    loaded.insert(Robot(ids[teamSize]));//replaced by the load
+    bool restored = loaded.load(path) && avlHeight(loaded.m_root) >= 0 && loaded.size() == teamSize &&
+        loaded.countByState(DEAD) == team.countByState(DEAD) && !loaded.findBot(ids[teamSize]);
+    stringstream expected, actual, mapped;
+    {
+        OutputSink out(expected);
+        team.listRobots(out);
+    }
+    {
+        OutputSink out(actual);
+        loaded.listRobots(out);
+    }
+    MappedSwarm file;
+    bool opened = file.open(path) && file.size() == teamSize;
+    {
+        OutputSink out(mapped);
+        file.listRobots(out);
+    }
+    bool lookups = true;
+    for (int i = 0; i < teamSize + 1000; i++) {
+        Robot aBot;
+        bool found = file.getRobot(ids[i], aBot);
+        lookups = lookups && found == (i < teamSize) && file.findBot(ids[i]) == found;
+        if (found) {
+            lookups = lookups && aBot.getID() == ids[i] && aBot.getType() == i % TYPE_COUNT &&
+                aBot.getState() == (i % 3 ? ALIVE : DEAD);
+        }
+    }
+    file.close();
+    bool same = expected.str() == actual.str() && expected.str() == mapped.str();
+
+    // damaged copies of the file
+    FILE* in = fopen(path.c_str(), "rb");
+    vector<char> bytes(SWARM_HEADER_SIZE + teamSize * SWARM_RECORD_SIZE);
+    bool read = in != nullptr && fread(bytes.data(), 1, bytes.size(), in) == bytes.size();
+    if (in != nullptr) fclose(in);
+    bool rejected = read;
+    for (int damage = 0; damage < 3; damage++) {
+        vector<char> copy(bytes);
+        if (damage == 0) copy[SWARM_HEADER_SIZE + 1234] ^= 4;
+        if (damage == 1) copy.resize(copy.size() - SWARM_RECORD_SIZE);
+        if (damage == 2) copy[0] = 'X';
+        FILE* out = fopen(path.c_str(), "wb");
+        fwrite(copy.data(), 1, copy.size(), out);
+        fclose(out);
+        rejected = rejected && !loaded.load(path) && !file.open(path) && loaded.size() == teamSize &&
+            avlHeight(loaded.m_root) >= 0;
+    }
+
+    Swarm empty;
+    bool emptyFile = empty.save(path) && loaded.load(path) && loaded.size() == 0 && file.open(path) &&
+        file.size() == 0 && !file.findBot(ids[0]);
+    file.close();
+    remove(path.c_str());
+    bool missing = !loaded.load(path) && !file.open(path);
+    cout << "saved " << (saved ? "and" : "but NOT") << " restored " << (restored && same ? "the same robots" : "OTHER ROBOTS")
+         << ", mapped lookups " << (opened && lookups ? "match" : "DO NOT MATCH") << ", damaged files "
+         << (rejected ? "rejected" : "ACCEPTED") << endl;
+    return saved && restored && same && opened && lookups && rejected && emptyFile && missing;
+}
+
+// Restart a swarm of 90,000 robots 10 times: from the text roster of listRobots, parsed and
+// inserted one robot at a time, from a swarm file with load(), and by mapping the file for
+// lookups only. Every restart must bring back all the robots; the times are for reading only.
+bool Tester::proveLoadTime()
+{
+    vector<int> ids = shuffledIDs();
+    vector<Robot> robots;
+    for (size_t i = 0; i < ids.size(); i++) {
+        robots.push_back(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), i % 3 ? ALIVE : DEAD));
+    }
+    Swarm team(robots.begin(), robots.end());
+    string path = scratchFile(".bin");
+    stringstream roster;
+    {
+        OutputSink out(roster);
+        team.listRobots(out);
+    }
+    string text = roster.str();
+    bool saved = team.save(path);
+    const int rounds = 10;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    int parsed = 0;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm restarted;
+        stringstream lines(text);
+        string line;
+        while (getline(lines, line)) {
+            size_t first = line.find(':'), second = line.rfind(':');
+            string state = line.substr(first + 1, second - first - 1), type = line.substr(second + 1);
+            int typeIndex = (int)(find(begin(TYPE_NAMES), end(TYPE_NAMES), type) - begin(TYPE_NAMES));
+            restarted.insert(Robot(stoi(line.substr(0, first)), static_cast<ROBOTTYPE>(typeIndex),
+                state == "DEAD" ? DEAD : ALIVE));
+        }
+        parsed = restarted.size();
+    }
+    stop = clock();
+    double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    int loadedSize = 0;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm restarted;
+        restarted.load(path);
+        loadedSize = restarted.size();
+    }
+    stop = clock();
+    double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    int mappedSize = 0;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        MappedSwarm file;
+        file.open(path);
+        mappedSize = file.size();
+    }
+    stop = clock();
+    double T3 = (double)(stop - start) / CLOCKS_PER_SEC;
+    remove(path.c_str());
+
+    cout << rounds << " restarts of " << team.size() << " robots: text roster " << T1 << " seconds, load "
+         << T2 << " seconds, mapped " << T3 << " seconds" << endl;
+    return saved && parsed == team.size() && loadedSize == team.size() && mappedSize == team.size();
+}
+
+// Listing of team as one string
+string Tester::rosterOf(Swarm& team)
+{
+    stringstream roster;
+    {
+        OutputSink out(roster);
+        team.listRobots(out);
+    }
+    return roster.str();
+}
+
+// A mix of changes on team: count robots from ids[first..] inserted, then every fourth of them
+// set to DEAD and every fifth removed
+void Tester::journaledWork(Swarm& team, const vector<int>& ids, int first, int count)
+{
+    for (int i = first; i < first + count; i++) {
+        team.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT)));
+    }
+    for (int i = first; i < first + count; i += 4) {
+        team.setState(ids[i], DEAD);
+    }
+    for (int i = first + 1; i < first + count; i += 5) {
+        team.remove(ids[i]);
+    }
+}
+
+// Changes made with a journal attached must come back on recovery: from the journal alone, from
+// a checkpoint plus the journal written after it, after a checkpoint cut short before the reset,
+// and from a journal whose last record is torn. Every kind of change is covered, the batch ones
+// and removeDead included, with and without a group-commit window.
+bool Tester::testJournal()
+{
+    vector<int> ids = shuffledIDs();
+    string snapshot = scratchFile(".bin");
+    string path = scratchFile(".jnl");
+    remove(snapshot.c_str());
+    remove(path.c_str());
+
+    Swarm team;
+    SwarmJournal journal;
+    bool opened = journal.open(path, 0);
+    team.attachJournal(&journal);
+    journaledWork(team, ids, 0, 2000);
+    team.removeDead();
+    vector<Robot> batch;
+    for (int i = 2000; i < 2500; i++) {
+        batch.push_back(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), DEAD));
+    }
+    team.insertBatch(batch.begin(), batch.end());
+    team.removeBatch(ids.begin() + 2400, ids.begin() + 2600);
+    team.removeIf([](const Robot& robot) { return robot.getID() % 7 == 0; });
+    // every change is durable already, as after a crash
+    Swarm fromJournal;
+    bool journalOnly = fromJournal.recover(snapshot, path) && rosterOf(fromJournal) == rosterOf(team) &&
+        countersMatch(fromJournal) && journal.durable() == journal.appended();
+
+    bool checkpointed = team.checkpoint(snapshot);
+    journaledWork(team, ids, 3000, 1000);
+    team.save(snapshot);//a checkpoint cut short: new snapshot, journal not reset
+    Swarm afterCheckpoint;
+    bool fromBoth = afterCheckpoint.recover(snapshot, path) && rosterOf(afterCheckpoint) == rosterOf(team) &&
+        countersMatch(afterCheckpoint);
+
+    team.assign(batch.begin(), batch.end());
+    journal.close();
+    FILE* out = fopen(path.c_str(), "ab");
+    fwrite("torn", 1, 4, out);
+    fclose(out);
+    Swarm torn;
+    bool tornTail = torn.recover(snapshot, path) && rosterOf(torn) == rosterOf(team);
+
+    // group commit: reopening drops the torn record and appends after the valid ones
+    bool grouped = journal.open(path, 2000);
+    journaledWork(team, ids, 5000, 2000);
+    journal.commit();
+    grouped = grouped && journal.durable() == journal.appended() && journal.syncs() < journal.appended();
+    journaledWork(team, ids, 8000, 500);
+    team.attachJournal(nullptr);
+    team.insert(Robot(ids[9000]));//not journaled
+    team.remove(ids[9000]);
+    journal.close();
+    Swarm fromGroups;
+    grouped = grouped && fromGroups.recover(snapshot, path) && rosterOf(fromGroups) == rosterOf(team) &&
+        countersMatch(fromGroups) && !journal.failed();
+
+    FILE* bad = fopen(path.c_str(), "wb");
+    fwrite("not a journal", 1, 13, bad);
+    fclose(bad);
+    Swarm rejected;
+    bool badFile = !rejected.recover(snapshot, path) && !journal.open(path, 0);
+    remove(snapshot.c_str());
+    remove(path.c_str());
+    cout << "recovered from the journal " << (journalOnly ? "alone" : "ALONE FAILED") << ", from a checkpoint "
+         << (checkpointed && fromBoth ? "and the journal" : "FAILED") << ", past a torn record "
+         << (tornTail ? "too" : "FAILED") << ", with group commit " << (grouped ? "too" : "FAILED") << endl;
+    return opened && journalOnly && checkpointed && fromBoth && tornTail && grouped && badFile;
+}
+
+// Run the same 5,800 changes on a swarm without a journal, and with a journal synced on every
+// change and at group-commit windows of 0.1, 1 and 10 milliseconds. Syncs wait for the disk,
+// not the CPU, so wall-clock time is measured. Every journal must recover the swarm; the rates
+// depend on the disk and are printed without being judged.
+bool Tester::proveJournalOverhead()
+{
+    vector<int> ids = shuffledIDs();
+    string path = scratchFile(".jnl");
+    const int changes = 4000;//inserts, plus a quarter as many state changes and a fifth as many removals
+    const int windows[] = { -1, 0, 100, 1000, 10000 };//-1 runs without a journal
+    double rate[5] = {};
+    bool recovered = true;
+    for (int run = 0; run < 5; run++) {
+        remove(path.c_str());
+        Swarm team;
+        SwarmJournal journal;
+        if (windows[run] >= 0) {
+            journal.open(path, windows[run]);
+            team.attachJournal(&journal);
+        }
+        auto start = chrono::steady_clock::now();
+        journaledWork(team, ids, 0, changes);
+        journal.commit();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        uint64_t records = journal.appended();
+        uint64_t syncs = journal.syncs();
+        journal.close();
+        rate[run] = (changes + changes / 4 + changes / 5) / elapsed.count();
+        if (windows[run] < 0) {
+            cout << "no journal: " << rate[run] << " changes per second" << endl;
+            continue;
+        }
+        Swarm restarted;
+        recovered = recovered && restarted.recover(path + ".missing", path) &&
+            rosterOf(restarted) == rosterOf(team);
+        cout << "window " << windows[run] << " microseconds: " << rate[run] << " changes per second, "
+             << records << " records in " << syncs << " syncs" << endl;
+    }
+    remove(path.c_str());
+    return recovered;
+}
+
+// Run 20,000 random inserts and removes over 3,000 IDs, so that duplicates, missing IDs and
+// robots with two children all come up, on one swarm through insert() and remove() and on
+// another through the recursive insertRobot() and deleteRobot(). Stopping the retrace early
+// must not change the outcome: both trees must have the same shape and heights, stay AVL
+// trees, and keep sizes, type counts, state counts and the ID index right.
+bool Tester::testIterativeUpdates()
+{
+    Random idGen(MINID, MINID + 3000);
+    Swarm iterative;
+    Swarm recursive;
+    iterative.enableIndex(true);
+    bool same = true;
+    bool valid = true;
+    for (int i = 0; i < 20000; i++) {
+        int id = idGen.getRandNum();
+        if (i % 3 == 2) {
+            iterative.remove(id);
+            recursive.m_root = recursive.deleteRobot(recursive.m_root, id);
+        }
+        else {
+            Robot aBot(id, static_cast<ROBOTTYPE>(id % TYPE_COUNT), (id % 4 == 0) ? DEAD : ALIVE);
+            iterative.insert(aBot);
+            recursive.m_root = recursive.insertRobot(aBot, recursive.m_root);
+        }
+        if (i % 1000 == 999) {
+            stringstream expected, actual;
+            dumpText(recursive.m_root, expected);
+            dumpText(iterative.m_root, actual);
+            same = same && expected.str() == actual.str();
+            vector<Robot*> robots;
+            collect(iterative.m_root, robots);
+            bool sizes = true;
+            for (Robot* aBot : robots) {
+                sizes = sizes && aBot->m_size == 1 + (aBot->m_left != nullptr ? aBot->m_left->m_size : 0) +
+                    (aBot->m_right != nullptr ? aBot->m_right->m_size : 0);
+                sizes = sizes && iterative.findBot(aBot->m_id) && iterative.m_index[aBot->m_id - MINID] == aBot;
+            }
+            int indexed = 0;
+            for (Robot* slot : iterative.m_index) {
+                indexed += slot != nullptr;
+            }
+            valid = valid && avlHeight(iterative.m_root) >= 0 && sizes && indexed == iterative.size() &&
+                countersMatch(iterative);
+        }
+    }
+    // removing everything must leave an empty tree
+    for (int id = MINID; id <= MINID + 3000; id++) {
+        iterative.remove(id);
+    }
+    bool emptied = iterative.m_root == nullptr && iterative.countByState(ALIVE) == 0 &&
+        iterative.countByState(DEAD) == 0 && iterative.allocatorStats().liveNodes == 0;
+    cout << "iterative and recursive trees " << (same ? "match" : "DIFFER") << ", invariants "
+         << (valid ? "hold" : "BROKEN") << endl;
+    return same && valid && emptied;
+}
+
+// Insert 90,000 robots in random order and remove them in another order, 10 times, with the
+// recursive insertRobot() and deleteRobot() and with the iterative insert() and remove(). Both
+// must empty the swarm again; which is faster is shown, not asserted.
+bool Tester::proveIterativeUpdates()
+{
+    vector<int> ids = shuffledIDs();
+    vector<int> order(ids.rbegin(), ids.rend());
+    const int rounds = 10;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    bool emptied = true;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm team;
+        for (int id : ids) {
+            team.m_root = team.insertRobot(Robot(id, static_cast<ROBOTTYPE>(id % TYPE_COUNT)), team.m_root);
+        }
+        for (int id : order) {
+            team.m_root = team.deleteRobot(team.m_root, id);
+        }
+        emptied = emptied && team.m_root == nullptr;
+    }
+    stop = clock();
+    double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm team;
+        for (int id : ids) {
+            team.insert(Robot(id, static_cast<ROBOTTYPE>(id % TYPE_COUNT)));
+        }
+        for (int id : order) {
+            team.remove(id);
+        }
+        emptied = emptied && team.m_root == nullptr;
+    }
+    stop = clock();
+    double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    cout << rounds << " rounds of " << ids.size() << " inserts and removes: recursive " << T1
+         << " seconds, iterative " << T2 << " seconds" << endl;
+    return emptied;
+}
+
+// Insert 10,000 robots in ascending order, which rotates at every other insert, look each one
+// up and remove a third of them. The height must stay within the AVL bound and both dumps must
+// carry the statistics. With SWARM_STATS the counters must add up: one allocation per insert
+// and one free per removal, lookups no deeper than the tree, every insert and remove within
+// twice the bound of nodes, and only right-right rotations for ascending IDs. Without it every
+// counter must be 0.
+bool Tester::testSwarmStats()
+{
+    Swarm team;
+    int teamSize = 10000;
+    for (int i = 0; i < teamSize; i++) {
+        team.insert(Robot(MINID + i, static_cast<ROBOTTYPE>(i % TYPE_COUNT)));
+    }
+    SwarmStats grown = team.stats();
+    int grownHeight = team.m_root->m_height;
+    bool found = true;
+    for (int i = 0; i < teamSize; i++) {
+        found = found && team.findBot(MINID + i);
+    }
+    SwarmStats looked = team.stats();
+    team.resetStats();
+    for (int i = 0; i < teamSize; i += 3) {
+        team.remove(MINID + i);
+    }
+    SwarmStats shrunk = team.stats();
+    bool shape = grown.robots == teamSize && grown.height == grownHeight &&
+        shrunk.robots == team.size() && shrunk.height == team.m_root->m_height && grown.height <= grown.heightBound &&
+        shrunk.height <= shrunk.heightBound && grown.heightBound == 18;
+
+    string json, prometheus;
+    {
+        stringstream text;
+        {
+            OutputSink out(text);
+            shrunk.writeJSON(out);
+        }
+        json = text.str();
+    }
+    {
+        stringstream text;
+        {
+            OutputSink out(text);
+            shrunk.writePrometheus(out);
+        }
+        prometheus = text.str();
+    }
+    string robots = to_string(shrunk.robots);
+    bool dumps = json.find("\"robots\":" + robots + ",") != string::npos && json.find("\"rotations\":{") != string::npos &&
+        prometheus.find("\nswarm_robots " + robots + "\n") != string::npos &&
+        prometheus.find("# TYPE swarm_rotations_total counter\n") != string::npos &&
+        prometheus.find("swarm_rotations_total{kind=\"right_right\"} ") != string::npos;
+
+    bool counters = true;
+#ifdef SWARM_STATS
+    uint64_t removed = (uint64_t)(teamSize - shrunk.robots);
+    counters = grown.enabled && grown.allocations == (uint64_t)teamSize && grown.frees == 0 &&
+        grown.inserts == (uint64_t)teamSize && grown.rotationsRightRight > 0 && grown.rotationsLeftLeft == 0 &&
+        grown.rotationsLeftRight == 0 && grown.rotationsRightLeft == 0 && grown.heightUpdates > 0 &&
+        grown.nodesVisited <= (uint64_t)teamSize * 2 * (grown.heightBound + 1) &&
+        looked.lookups == (uint64_t)teamSize && looked.comparisons <= looked.lookups * (looked.height + 1) &&
+        shrunk.removes == removed && shrunk.frees == removed && shrunk.allocations == 0 && shrunk.lookups == 0 &&
+        shrunk.nodesVisited <= removed * 2 * (grown.heightBound + 1);
+    cout << "comparisons per lookup " << (double)looked.comparisons / looked.lookups << ", nodes per insert "
+         << (double)grown.nodesVisited / grown.inserts << ", nodes per remove "
+         << (double)shrunk.nodesVisited / shrunk.removes << ", bound " << grown.heightBound + 1 << endl;
+#else
+    counters = !grown.enabled && looked.lookups == 0 && looked.comparisons == 0 && grown.allocations == 0 &&
+        grown.rotationsRightRight == 0 && grown.heightUpdates == 0 && shrunk.frees == 0 && shrunk.nodesVisited == 0;
+    cout << "built without SWARM_STATS, counters off" << endl;
+#endif
+    cout << "height " << shrunk.height << " of at most " << shrunk.heightBound << endl;
+    return found && shape && dumps && counters;
+}
+
+// Check the buckets: every value falls into a bucket that holds it and is at most 1/32 of its
+// values wide. Percentiles of 1..100,000 must be within one bucket of the exact ones, merged
+// halves must equal the whole, and four threads recording through one recorder while another
+// thread keeps exporting must lose nothing. A swarm with timing on must count every call of
+// each timed operation, and one with timing off nothing.
+bool Tester::testLatencyHistograms()
+{
+    bool buckets = true;
+    for (uint64_t ns = 0; ns < 2000000; ns += (ns < 5000 ? 1 : 997)) {
+        int bucket = LatencyHistogram::bucketOf(ns);
+        uint64_t highest = LatencyHistogram::bucketHighest(bucket);
+        uint64_t lowest = (bucket == 0) ? 0 : LatencyHistogram::bucketHighest(bucket - 1) + 1;
+        buckets = buckets && lowest <= ns && ns <= highest &&
+            (ns < LATENCY_SUB_BUCKETS ? highest == ns : (highest - lowest + 1) * LATENCY_SUB_BUCKETS <= lowest);
+    }
+    buckets = buckets && LatencyHistogram::bucketOf(UINT64_MAX) == LATENCY_BUCKETS - 1;
+
+    LatencyHistogram whole, low, high;
+    for (uint64_t ns = 1; ns <= 100000; ns++) {
+        whole.record(ns);
+        (ns % 2 == 0 ? low : high).record(ns);
+    }
+    low.merge(high);
+    bool percentiles = true;
+    const double percents[] = { 50, 99, 99.9, 100 };
+    for (double percent : percents) {
+        uint64_t exact = (uint64_t)(percent * 1000);
+        uint64_t reported = whole.percentile(percent);
+        percentiles = percentiles && reported >= exact && reported <= exact + exact / 32 &&
+            low.percentile(percent) == reported;
+    }
+    percentiles = percentiles && whole.count() == 100000 && whole.max() == 100000 && low.count() == whole.count() &&
+        low.max() == whole.max() && whole.mean() == 50000.5 && LatencyHistogram().percentile(50) == 0;
+
+    LatencyRecorder recorder;
+    atomic<bool> done(false);
+    uint64_t exported = 0;
+    thread exporter([&]() {
+        while (!done.load()) {
+            uint64_t seen = recorder.snapshot(OP_FIND_BOT).count();
+            exported = (seen > exported) ? seen : exported;
+        }
+    });
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&recorder, t]() {
+            for (uint64_t i = 0; i < 50000; i++) {
+                recorder.record(OP_FIND_BOT, 100 + i % 1000);
+                recorder.record(OP_INSERT, (uint64_t)t * 1000000 + i);
+            }
+        });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    done.store(true);
+    exporter.join();
+    LatencyHistogram finds = recorder.snapshot(OP_FIND_BOT);
+    LatencyHistogram inserts = recorder.snapshot(OP_INSERT);
+    bool concurrent = finds.count() == 200000 && inserts.count() == 200000 && finds.max() == 1099 &&
+        inserts.max() == 3049999 && exported <= 200000 && recorder.snapshot(OP_REMOVE).count() == 0;
+
+    Swarm team;
+    bool off = !team.latencyEnabled();
+    team.insert(Robot(MINID));
+    team.enableLatency(true);
+    for (int i = 0; i < 1000; i++) {
+        team.insert(Robot(MINID + i));//the first one is a duplicate
+    }
+    for (int i = 0; i < 500; i++) {
+        team.findBot(MINID + 2 * i);
+        team.setState(MINID + i, DEAD);
+    }
+    team.remove(MINID + 999);
+    team.removeDead();
+    stringstream json;
+    {
+        OutputSink out(json);
+        team.writeLatency(out);
+    }
+    bool timed = team.latencyEnabled() && team.latency(OP_INSERT).count() == 1000 &&
+        team.latency(OP_FIND_BOT).count() == 500 && team.latency(OP_SET_STATE).count() == 500 &&
+        team.latency(OP_REMOVE).count() == 1 && team.latency(OP_REMOVE_DEAD).count() == 1 &&
+        json.str().find("\"insert\":{\"count\":1000,") == 1 && json.str().find("\"removeDead\":{\"count\":1,") != string::npos;
+    team.enableLatency(false);
+    team.findBot(MINID);
+    off = off && !team.latencyEnabled() && team.latency(OP_FIND_BOT).count() == 0;
+    cout << "buckets " << (buckets ? "hold their values" : "WRONG") << ", percentiles " << (percentiles ? "match" : "DO NOT MATCH")
+         << ", concurrent recording " << (concurrent ? "complete" : "LOST VALUES") << ", swarm timing "
+         << (timed && off ? "counts every call" : "MISCOUNTS") << endl;
+    return buckets && percentiles && concurrent && timed && off;
+}
+
+// Insert 90,000 robots, look each one up and remove them all, with timing off and on, and show
+// the insert latency tail. Timing reads the clock twice per call, which should cost well below
+// 1 microsecond per operation; the overhead is printed, and only the recorded count is checked.
+bool Tester::proveLatencyOverhead()
+{
+    vector<int> ids = shuffledIDs();
+    double seconds[2] = {};
+    LatencyHistogram inserts;
+    for (int timed = 0; timed < 2; timed++) {
+        Swarm team;
+        team.enableLatency(timed == 1);
+        auto start = chrono::steady_clock::now();
+        for (int id : ids) {
+            team.insert(Robot(id));
+        }
+        for (int id : ids) {
+            team.findBot(id);
+        }
+        for (int id : ids) {
+            team.remove(id);
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        seconds[timed] = elapsed.count();
+        inserts = team.latency(OP_INSERT);
+    }
+    double overhead = (seconds[1] - seconds[0]) * 1e9 / (3.0 * ids.size());
+    cout << ids.size() << " inserts, lookups and removes: " << seconds[0] << " seconds untimed, " << seconds[1]
+         << " seconds timed, " << overhead << " ns per operation" << endl;
+    cout << "insert latency: p50 " << inserts.percentile(50) << " ns, p99 " << inserts.percentile(99) << " ns, p99.9 "
+         << inserts.percentile(99.9) << " ns, max " << inserts.max() << " ns" << endl;
+    return inserts.count() == ids.size();
+}
+
+// A copy must have the same shape, heights and counts as the original in nodes of its own, with
+// an index pointing at those nodes, and must not change when the original does. A move must
+// hand over everything, journal included, and leave an empty swarm that still works. Self
+// assignment must change nothing, and emplace and insert(Robot&&) must behave as insert does.
+bool Tester::testCopyAndMove()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm team;
+    team.enableIndex(true);
+    int teamSize = 3000;
+    for (int i = 0; i < teamSize; i++) {
+        team.emplace(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), i % 4 ? ALIVE : DEAD);
+    }
+    team.insert(Robot(ids[0], QUADRUPED));//duplicates are ignored either way
+    team.emplace(ids[1], QUADRUPED);
+    team.emplace(MINID - 1);
+    Robot spare(ids[teamSize]);
+    team.insert(move(spare));
+    team.remove(ids[teamSize]);
+    stringstream shape;
+    dumpText(team.m_root, shape);
+    bool inserted = team.size() == teamSize && team.findBot(ids[0]) && !team.findBot(MINID - 1) &&
+        avlHeight(team.m_root) >= 0 && countersMatch(team);
+
+    Swarm copy(team);
+    stringstream copyShape;
+    dumpText(copy.m_root, copyShape);
+    vector<Robot*> originals, copies;
+    collect(team.m_root, originals);
+    collect(copy.m_root, copies);
+    bool ownNodes = originals.size() == copies.size();
+    for (size_t i = 0; ownNodes && i < copies.size(); i++) {
+        ownNodes = copies[i] != originals[i] && copies[i]->m_size == originals[i]->m_size &&
+            copy.m_index[copies[i]->m_id - MINID] == copies[i];
+    }
+    bool copied = copyShape.str() == shape.str() && ownNodes && copy.indexEnabled() && countersMatch(copy) &&
+        copy.countByState(DEAD) == team.countByState(DEAD) && copy.allocatorStats().liveNodes == teamSize;
+    copy.removeDead();
+    copy.emplace(ids[teamSize + 1]);
+    stringstream after;
+    dumpText(team.m_root, after);
+    bool independent = after.str() == shape.str() && team.countByState(DEAD) > 0 && copy.countByState(DEAD) == 0 &&
+        !team.findBot(ids[teamSize + 1]) && countersMatch(team) && countersMatch(copy);
+
+    Swarm assigned;
+    assigned.emplace(ids[teamSize + 2]);
+    assigned = team;
+    assigned = assigned;
+    stringstream assignedShape;
+    dumpText(assigned.m_root, assignedShape);
+    bool assignedCopy = assignedShape.str() == shape.str() && !assigned.findBot(ids[teamSize + 2]) &&
+        assigned.allocatorStats().liveNodes == teamSize && countersMatch(assigned);
+
+    string path = scratchFile(".jnl");
+    remove(path.c_str());
+    SwarmJournal journal;
+    journal.open(path, 0);
+    team.attachJournal(&journal);
+    Swarm moved(move(team));
+    moved.emplace(ids[teamSize + 3]);//journaled by the new owner
+    team.emplace(ids[teamSize + 4]);//the emptied swarm still works, without the journal
+    stringstream movedShape;
+    dumpText(moved.m_root, movedShape);
+    bool handedOver = moved.size() == teamSize + 1 && moved.indexEnabled() && moved.findBot(ids[teamSize + 3]) &&
+        countersMatch(moved) && team.size() == 1 && !team.indexEnabled() && team.findBot(ids[teamSize + 4]) &&
+        team.countByState(ALIVE) == 1 && team.countByState(DEAD) == 0 && countersMatch(team) &&
+        journal.appended() == 1;
+
+    assigned = move(moved);
+    assigned = move(assigned);
+    bool moveAssigned = assigned.size() == teamSize + 1 && countersMatch(assigned) && moved.size() == 0 &&
+        moved.m_root == nullptr && moved.allocatorStats().liveNodes == 0 && assigned.allocatorStats().liveNodes == teamSize + 1;
+    assigned.remove(ids[teamSize + 3]);
+    moveAssigned = moveAssigned && journal.appended() == 2;
+    journal.close();
+    remove(path.c_str());
+    cout << "copy " << (copied && independent && assignedCopy ? "is an independent clone" : "IS NOT A CLONE") << ", move "
+         << (handedOver && moveAssigned ? "hands everything over" : "LOSES STATE") << endl;
+    return inserted && copied && independent && assignedCopy && handedOver && moveAssigned;
+}
+
+// Hand a roster of 90,000 robots to another swarm 10 times by inserting every robot again, the
+// only way before, by copying and by moving it; then build it with emplace against insert. Every
+// handoff must deliver the whole roster; the times are reported only.
+bool Tester::proveRosterHandoff()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm roster;
+    for (size_t i = 0; i < ids.size(); i++) {
+        roster.emplace(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT));
+    }
+    const int rounds = 10;
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    bool same = true;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm receiver;
+        for (const Robot& robot : roster) {
+            receiver.insert(robot);
+        }
+        same = same && receiver.size() == roster.size();
+    }
+    stop = clock();
+    double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm receiver(roster);
+        same = same && receiver.size() == roster.size();
+    }
+    stop = clock();
+    double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm receiver(move(roster));
+        roster = move(receiver);
+        same = same && roster.size() == (int)ids.size();
+    }
+    stop = clock();
+    double T3 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm built;
+        for (size_t i = 0; i < ids.size(); i++) {
+            built.insert(Robot(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT)));
+        }
+    }
+    stop = clock();
+    double T4 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm built;
+        for (size_t i = 0; i < ids.size(); i++) {
+            built.emplace(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT));
+        }
+    }
+    stop = clock();
+    double T5 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    cout << rounds << " handoffs of " << roster.size() << " robots: re-insert " << T1 << " seconds, copy " << T2
+         << " seconds, move " << T3 << " seconds" << endl;
+    cout << rounds << " builds: insert(Robot(...)) " << T4 << " seconds, emplace " << T5 << " seconds" << endl;
+    return same;
+}
+
+// Split swarms of mixed states, with and without the index, at IDs in the tree, between its
+// robots and past either end. Both parts must be AVL trees with the right robots, counts, index
+// entries and live nodes, and must keep working on nodes they share the slabs of. The type
+// counts of the parts come from the subtree roots, while the dead robots or, with the index on,
+// the index entries of the smaller part are visited one by one, which costs O(k). Joining and
+// concatenating the parts must restore the swarm, reject IDs out of order without changing
+// anything, and journal the adopted robots.
+bool Tester::testSplitJoinConcat()
+{
+    vector<int> ids = shuffledIDs();
+    int teamSize = 5000;
+    bool valid = true;
+    for (int indexed = 0; indexed < 2; indexed++) {
+        Swarm team;
+        team.enableIndex(indexed == 1);
+        for (int i = 0; i < teamSize; i++) {
+            team.emplace(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), i % 5 ? ALIVE : DEAD);
+        }
+        vector<int> sorted(ids.begin(), ids.begin() + teamSize);
+        sort(sorted.begin(), sorted.end());
+        int cuts[] = { sorted[teamSize / 3], sorted[teamSize / 2] + 1, sorted[0], MAXID + 1, MINID - 1 };
+        for (int cut : cuts) {
+            pair<Swarm, Swarm> parts = team.split(cut);
+            Swarm* halves[] = { &parts.first, &parts.second };
+            int below = (int)(std::lower_bound(sorted.begin(), sorted.end(), cut) - sorted.begin());
+            bool split = team.size() == 0 && team.m_root == nullptr && countersMatch(team) &&
+                team.indexEnabled() == (indexed == 1) && parts.first.size() == below &&
+                parts.second.size() == teamSize - below;
+            for (Swarm* half : halves) {
+                vector<Robot*> robots;
+                collect(half->m_root, robots);
+                bool sides = true;
+                for (Robot* aBot : robots) {
+                    sides = sides && (half == &parts.first ? aBot->m_id < cut : aBot->m_id >= cut) &&
+                        (indexed == 0 || half->m_index[aBot->m_id - MINID] == aBot);
+                }
+                split = split && sides && avlHeight(half->m_root) >= -1 && countersMatch(*half) &&
+                    half->indexEnabled() == (indexed == 1) && half->allocatorStats().liveNodes == half->size();
+            }
+            int extra = ids[teamSize];//a spare ID, inserted and removed on both sides of the shared slabs
+            Swarm& owner = (extra < cut) ? parts.first : parts.second;
+            owner.emplace(extra);
+            if (owner.m_root != nullptr && owner.m_root->m_id != extra) {
+                Robot root = *owner.m_root;
+                owner.remove(root.m_id);
+                owner.emplace(root.m_id, root.m_type, root.m_state);
+            }
+            owner.remove(extra);
+            split = split && countersMatch(owner) && owner.allocatorStats().liveNodes == owner.size();
+
+            bool rejected = !parts.first.concat(parts.first) &&
+                (parts.first.size() == 0 || parts.second.size() == 0 ||
+                 (!parts.second.concat(parts.first) && !parts.first.join(Robot(sorted[below]), parts.second) &&
+                  !parts.first.join(Robot(sorted[below - 1] - 1), parts.second))) &&
+                parts.first.size() == below && parts.second.size() == teamSize - below;
+            bool joined = false;
+            bool spare = below > 0 && below < teamSize && sorted[below] - sorted[below - 1] > 1;
+            if (spare) {//the cut falls between two robots, so there is room for a pivot
+                int pivot = sorted[below] - 1;
+                joined = parts.first.join(Robot(pivot, BIRD, DEAD), parts.second) &&
+                    parts.first.size() == teamSize + 1 && parts.first.findBot(pivot);
+                parts.first.remove(pivot);
+            }
+            else {
+                joined = parts.first.concat(parts.second) && parts.first.size() == teamSize;
+            }
+            team = move(parts.first);
+            joined = joined && parts.second.size() == 0 && countersMatch(parts.second) && avlHeight(team.m_root) >= 0 &&
+                countersMatch(team) && team.allocatorStats().liveNodes == teamSize;
+            vector<Robot*> robots;
+            collect(team.m_root, robots);
+            for (int i = 0; joined && i < teamSize; i++) {
+                joined = robots[i]->m_id == sorted[i] && (indexed == 0 || team.m_index[sorted[i] - MINID] == robots[i]);
+            }
+            valid = valid && split && rejected && joined;
+        }
+    }
+
+    string path = scratchFile(".jnl");
+    remove(path.c_str());
+    SwarmJournal journal;
+    journal.open(path, 0);
+    Swarm journaled;
+    journaled.attachJournal(&journal);
+    Swarm team;
+    for (int i = 0; i < 100; i++) {
+        team.emplace(MINID + i, static_cast<ROBOTTYPE>(i % TYPE_COUNT));
+    }
+    pair<Swarm, Swarm> parts = team.split(MINID + 50);
+    bool adopted = journaled.concat(parts.second) && journaled.join(Robot(MINID + 200), parts.first) == false &&
+        journal.appended() == 50;
+    journal.close();
+    Swarm replayed;
+    bool replay = SwarmJournal::replay(path, replayed) == 50 && replayed.size() == 50 && replayed.findBot(MINID + 99) &&
+        countersMatch(replayed);
+    remove(path.c_str());
+    cout << "split, join and concat " << (valid ? "keep" : "DO NOT KEEP") << " both swarms valid, the journal "
+         << (adopted && replay ? "records" : "DOES NOT RECORD") << " adopted robots" << endl;
+    return valid && adopted && replay;
+}
+
+// Move the upper half of the IDs of 90,000 robots, a third of them dead, to another swarm and
+// back 10 times, robot by robot as before and with split and concat, checking the sizes after
+// every trip and printing the times. Split counts the dead robots of the moved half, and a last
+// run with the ID index on also moves their index entries; both cost O(k).
+bool Tester::proveSplitConcat()
+{
+    vector<int> ids = shuffledIDs();
+    Swarm fleet;
+    for (size_t i = 0; i < ids.size(); i++) {
+        fleet.emplace(ids[i], static_cast<ROBOTTYPE>(i % TYPE_COUNT), i % 3 ? ALIVE : DEAD);
+    }
+    const int rounds = 10;
+    const int cut = (MINID + MAXID) / 2;
+    int dead = fleet.countByState(DEAD);
+    clock_t start, stop;//stores the clock ticks while running the program
+
+    bool same = true;
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        Swarm depot;
+        for (int id = cut; id <= MAXID; id++) {
+            const Robot* robot = &*fleet.find(id);
+            depot.emplace(id, robot->getType(), robot->getState());
+            fleet.remove(id);
+        }
+        same = same && depot.size() + fleet.size() == (int)ids.size();
+        for (const Robot& robot : depot) {
+            fleet.emplace(robot.getID(), robot.getType(), robot.getState());
+        }
+    }
+    stop = clock();
+    double T1 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        pair<Swarm, Swarm> parts = fleet.split(cut);
+        same = same && parts.second.size() == MAXID - cut + 1 && parts.first.size() + parts.second.size() == (int)ids.size();
+        fleet = move(parts.first);
+        same = same && fleet.concat(parts.second);
+    }
+    stop = clock();
+    double T2 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    fleet.enableIndex(true);
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        pair<Swarm, Swarm> parts = fleet.split(cut);
+        fleet = move(parts.first);
+        same = same && fleet.concat(parts.second);
+    }
+    stop = clock();
+    double T3 = (double)(stop - start) / CLOCKS_PER_SEC;
+
+    same = same && fleet.size() == (int)ids.size() && fleet.countByState(DEAD) == dead && avlHeight(fleet.m_root) >= 0;
+    cout << rounds << " round trips of " << MAXID - cut + 1 << " robots: robot by robot " << T1
+         << " seconds, split and concat " << T2 << " seconds, with the index " << T3 << " seconds" << endl;
+    return same;
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "outputsink.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <unistd.h>
+
+// Staging buffer of the current thread, allocated by its first stream or descriptor sink and
+// lent to one sink at a time
+static thread_local unique_ptr<char[]> t_staging;
+static thread_local bool t_stagingTaken = false;
+
+// Sink writing to an ostream, which still goes through its stream buffer
+OutputSink::OutputSink(ostream& out) {
+    m_stream = &out;
+    m_fd = -1;
+    takeStaging();
+    m_capacity = SINK_BUFFER_SIZE;
+    m_used = 0;
+    m_flushed = 0;
+    m_overflow = false;
+}
+
+// Sink writing to a file descriptor with write(2), bypassing any stream buffering
+OutputSink::OutputSink(int fd) {
+    m_stream = nullptr;
+    m_fd = fd;
+    takeStaging();
+    m_capacity = SINK_BUFFER_SIZE;
+    m_used = 0;
+    m_flushed = 0;
+    m_overflow = false;
+}
+
+// Sink filling capacity bytes of caller memory; nothing is allocated
+OutputSink::OutputSink(char* buffer, size_t capacity) {
+    m_stream = nullptr;
+    m_fd = -1;
+    m_buffer = buffer;
+    m_borrowed = false;
+    m_capacity = capacity;
+    m_used = 0;
+    m_flushed = 0;
+    m_overflow = false;
+}
+
+// Hand over what is left and give the staging buffer back
+OutputSink::~OutputSink() {
+    flush();
+    if (m_borrowed) {
+        t_stagingTaken = false;
+    }
+}
+
+// Borrow the staging buffer of the thread, allocating it the first time, or allocate one of our
+// own if another sink holds it. Neither is zeroed; only the bytes written are ever read.
+void OutputSink::takeStaging() {
+    m_borrowed = !t_stagingTaken;
+    if (m_borrowed) {
+        if (t_staging == nullptr) {
+            t_staging.reset(new char[SINK_BUFFER_SIZE]);
+        }
+        t_stagingTaken = true;
+        m_buffer = t_staging.get();
+    }
+    else {
+        m_own.reset(new char[SINK_BUFFER_SIZE]);
+        m_buffer = m_own.get();
+    }
+}
+
+// Hand the buffered text to the stream or descriptor and start the buffer over. Caller memory
+// is the target itself, so it is left alone.
+void OutputSink::flush() {
+    if (m_stream != nullptr) {
+        m_stream->write(m_buffer, (streamsize)m_used);
+        m_stream->flush();
+    }
+    else if (m_fd >= 0) {
+        size_t done = 0;
+        while (done < m_used) {
+            ssize_t count = ::write(m_fd, m_buffer + done, m_used - done);
+            if (count < 0 && errno == EINTR) {
+                continue;//interrupted by a signal before writing anything
+            }
+            if (count <= 0) {
+                break;
+            }
+            done += (size_t)count;
+        }
+    }
+    else {
+        return;
+    }
+    m_flushed += m_used;
+    m_used = 0;
+}
+
+// Make sure bytes more fit into the buffer, flushing it when they do not
+void OutputSink::makeRoom(size_t bytes) {
+    if (m_used + bytes > m_capacity && (m_stream != nullptr || m_fd >= 0)) {
+        flush();
+    }
+}
+
+// Append one character
+void OutputSink::put(char c) {
+    makeRoom(1);
+    if (m_used < m_capacity) {
+        m_buffer[m_used++] = c;
+    }
+    else {
+        m_overflow = true;
+    }
+}
+
+// Append text; text longer than the buffer is written in pieces
+void OutputSink::write(string_view text) {
+    while (!text.empty()) {
+        makeRoom(min(text.size(), m_capacity));
+        size_t count = min(text.size(), m_capacity - m_used);
+        if (count == 0) {
+            m_overflow = true;
+            return;
+        }
+        memcpy(m_buffer + m_used, text.data(), count);
+        m_used += count;
+        text.remove_prefix(count);
+    }
+}
+
+// Append value in decimal without going through a string or locale
+void OutputSink::writeInt(long long value) {
+    char digits[24];
+    to_chars_result result = to_chars(digits, digits + sizeof(digits), value);
+    write(string_view(digits, (size_t)(result.ptr - digits)));
+}
+
+// Bytes accepted so far, flushed or not
+size_t OutputSink::written() const {
+    return m_flushed + m_used;
+}
+
+// True if text was dropped because caller memory was full
+bool OutputSink::overflowed() const {
+    return m_overflow;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+#include <iostream>
+#include <string_view>
+#include <cstddef>
+#include <memory>
+using namespace std;
+#define SINK_BUFFER_SIZE (64 * 1024) //bytes collected before one write to the target
+
+// Buffered text output for the listings. Text is formatted into one buffer and handed to the
+// target in a single write when it fills up and when the sink is flushed or destroyed. The
+// target is an ostream, a file descriptor, or memory the caller provides; in the last case the
+// text goes straight into that memory and whatever does not fit is dropped and reported by
+// overflowed(). Stream and descriptor sinks borrow a staging buffer that each thread allocates
+// once and keeps, so a listing allocates nothing after the first one on its thread; only a sink
+// made while another one on the same thread holds that buffer allocates its own. A sink must be
+// destroyed on the thread that made it.
+class OutputSink {
+public:
+    friend class Grader;
+    friend class Tester;
+    explicit OutputSink(ostream& out);
+    explicit OutputSink(int fd);
+    OutputSink(char* buffer, size_t capacity);
+    ~OutputSink();//flushes
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+    void put(char c);
+    void write(string_view text);
+    void writeInt(long long value);//decimal, formatted with to_chars
+    void flush();//hands the buffered text to the target
+    size_t written() const;//bytes accepted so far, flushed or not
+    bool overflowed() const;//caller memory only: some text did not fit
+
+private:
+    ostream* m_stream;
+    int m_fd;
+    unique_ptr<char[]> m_own;//staging buffer of its own, when the thread's one is taken
+    bool m_borrowed;//m_buffer is the staging buffer of the thread
+    char* m_buffer;
+    size_t m_capacity;
+    size_t m_used;
+    size_t m_flushed;//bytes handed to the target by earlier flushes
+    bool m_overflow;
+
+    void makeRoom(size_t bytes);
+    void takeStaging();
+};
+#endif
@@ -0,0 +1,431 @@
+#include "persistentswarm.h"
+#include "outputsink.h"
+#include <thread>
+
+// Robot with id in one version, nullptr if it is not there
+static const PersistentRobot* findInVersion(const PersistentRobot* aBot, int id) {
+    while (aBot != nullptr && aBot->m_id != id) {
+        aBot = (id < aBot->m_id) ? aBot->m_left : aBot->m_right;
+    }
+    return aBot;
+}
+
+// Empty swarm at epoch 1; 0 marks a free snapshot slot
+PersistentSwarm::PersistentSwarm() {
+    m_current.store(new Version{nullptr, 0});
+    m_epoch.store(1);
+    for (atomic<uint64_t>& pin : m_pins) {
+        pin.store(0);
+    }
+    m_writeVersion = 0;
+}
+
+// Frees the current version and everything still retired. No snapshot may be alive.
+PersistentSwarm::~PersistentSwarm() {
+    Version* current = m_current.load();
+    vector<PersistentRobot*> robots;
+    collectAll(current->m_root, robots);
+    for (PersistentRobot* aBot : robots) {
+        delete aBot;
+    }
+    delete current;
+    for (pair<uint64_t, PersistentRobot*>& retired : m_retiredNodes) {
+        delete retired.second;
+    }
+    for (pair<uint64_t, Version*>& retired : m_retiredVersions) {
+        delete retired.second;
+    }
+}
+
+// Node created by the write in progress; it stays writable until the write publishes.
+PersistentRobot* PersistentSwarm::newRobot(int id, ROBOTTYPE type, STATE state) {
+    return new PersistentRobot{id, type, state, 0, nullptr, nullptr, m_writeVersion};
+}
+
+// Writable version of aBot. A node of a published version is copied and the original is
+// remembered for retirement; a node made by this write is returned as it is.
+PersistentRobot* PersistentSwarm::own(PersistentRobot* aBot) {
+    if (aBot->m_version == m_writeVersion) {
+        return aBot;
+    }
+    PersistentRobot* copy = new PersistentRobot(*aBot);
+    copy->m_version = m_writeVersion;
+    m_replaced.push_back(aBot);
+    return copy;
+}
+
+// Height of a subtree, -1 for nullptr
+int PersistentSwarm::height(const PersistentRobot* aBot) {
+    return (aBot == nullptr) ? -1 : aBot->m_height;
+}
+
+// Height of aBot from the heights of its children, as in Swarm::updateHeight
+void PersistentSwarm::updateHeight(PersistentRobot* aBot) {
+    aBot->m_height = 1 + max(height(aBot->m_left), height(aBot->m_right));
+}
+
+// Fix the height of the writable node aBot and restore the AVL property at it. The rotations
+// take ownership of the children they relink, so sibling subtrees are copied only when a
+// rotation actually reaches them.
+PersistentRobot* PersistentSwarm::rebalance(PersistentRobot* aBot) {
+    updateHeight(aBot);
+    int balance = height(aBot->m_left) - height(aBot->m_right);
+    if (balance > 1) {
+        if (height(aBot->m_left->m_left) < height(aBot->m_left->m_right)) {
+            aBot->m_left = singleLeftRotation(aBot->m_left);
+        }
+        return singleRightRotation(aBot);
+    }
+    if (balance < -1) {
+        if (height(aBot->m_right->m_right) < height(aBot->m_right->m_left)) {
+            aBot->m_right = singleRightRotation(aBot->m_right);
+        }
+        return singleLeftRotation(aBot);
+    }
+    return aBot;
+}
+
+// Right rotation at aBot on writable copies of aBot and its left child
+PersistentRobot* PersistentSwarm::singleRightRotation(PersistentRobot* aBot) {
+    aBot = own(aBot);
+    PersistentRobot* top = own(aBot->m_left);
+    aBot->m_left = top->m_right;
+    top->m_right = aBot;
+    updateHeight(aBot);
+    updateHeight(top);
+    return top;
+}
+
+// Left rotation at aBot on writable copies of aBot and its right child
+PersistentRobot* PersistentSwarm::singleLeftRotation(PersistentRobot* aBot) {
+    aBot = own(aBot);
+    PersistentRobot* top = own(aBot->m_right);
+    aBot->m_right = top->m_left;
+    top->m_left = aBot;
+    updateHeight(aBot);
+    updateHeight(top);
+    return top;
+}
+
+// Insert robot below aBot, which must not hold its ID yet. Only the search path is copied.
+PersistentRobot* PersistentSwarm::insertRobot(const Robot& robot, PersistentRobot* aBot) {
+    if (aBot == nullptr) {
+        return newRobot(robot.getID(), robot.getType(), robot.getState());
+    }
+    if (robot.getID() < aBot->m_id) {
+        PersistentRobot* left = insertRobot(robot, aBot->m_left);
+        aBot = own(aBot);
+        aBot->m_left = left;
+    }
+    else {
+        PersistentRobot* right = insertRobot(robot, aBot->m_right);
+        aBot = own(aBot);
+        aBot->m_right = right;
+    }
+    return rebalance(aBot);
+}
+
+// Remove id, which must be below aBot. A node with two children takes over the payload of its
+// successor, whose removal then copies the path down to it.
+PersistentRobot* PersistentSwarm::deleteRobot(PersistentRobot* aBot, int id) {
+    if (id < aBot->m_id) {
+        PersistentRobot* left = deleteRobot(aBot->m_left, id);
+        aBot = own(aBot);
+        aBot->m_left = left;
+    }
+    else if (id > aBot->m_id) {
+        PersistentRobot* right = deleteRobot(aBot->m_right, id);
+        aBot = own(aBot);
+        aBot->m_right = right;
+    }
+    else if (aBot->m_left != nullptr && aBot->m_right != nullptr) {
+        const PersistentRobot* successor = aBot->m_right;
+        while (successor->m_left != nullptr) {
+            successor = successor->m_left;
+        }
+        aBot = own(aBot);
+        aBot->m_id = successor->m_id;
+        aBot->m_type = successor->m_type;
+        aBot->m_state = successor->m_state;
+        aBot->m_right = deleteRobot(aBot->m_right, aBot->m_id);
+    }
+    else {
+        PersistentRobot* child = (aBot->m_left != nullptr) ? aBot->m_left : aBot->m_right;
+        if (aBot->m_version == m_writeVersion) {
+            delete aBot;
+        }
+        else {
+            m_replaced.push_back(aBot);
+        }
+        return child;
+    }
+    return rebalance(aBot);
+}
+
+// Copy the path down to id, which must be below aBot, and set the state of the copy
+PersistentRobot* PersistentSwarm::setRobotState(PersistentRobot* aBot, int id, STATE state) {
+    PersistentRobot* copy = own(aBot);
+    if (id < aBot->m_id) {
+        copy->m_left = setRobotState(aBot->m_left, id, state);
+    }
+    else if (id > aBot->m_id) {
+        copy->m_right = setRobotState(aBot->m_right, id, state);
+    }
+    else {
+        copy->m_state = state;
+    }
+    return copy;
+}
+
+// Link robots[low..high], sorted by ID, into a perfectly balanced subtree
+PersistentRobot* PersistentSwarm::buildBalanced(vector<PersistentRobot*>& robots, int low, int high) {
+    if (low > high) {
+        return nullptr;
+    }
+    int middle = low + (high - low) / 2;
+    PersistentRobot* aBot = robots[middle];
+    aBot->m_left = buildBalanced(robots, low, middle - 1);
+    aBot->m_right = buildBalanced(robots, middle + 1, high);
+    updateHeight(aBot);
+    return aBot;
+}
+
+// Append the nodes below aBot in ID order
+void PersistentSwarm::collectAll(PersistentRobot* aBot, vector<PersistentRobot*>& robots) {
+    vector<PersistentRobot*> stack;
+    while (aBot != nullptr || !stack.empty()) {
+        while (aBot != nullptr) {
+            stack.push_back(aBot);
+            aBot = aBot->m_left;
+        }
+        aBot = stack.back();
+        stack.pop_back();
+        robots.push_back(aBot);
+        aBot = aBot->m_right;
+    }
+}
+
+// Make root the current version, then retire what the write replaced with the epoch it was
+// visible in and advance the epoch. A snapshot that could still reach those nodes pinned that
+// epoch or an earlier one before it loaded the old version.
+void PersistentSwarm::publish(PersistentRobot* root, int size) {
+    Version* old = m_current.load();
+    m_current.store(new Version{root, size});
+    uint64_t epoch = m_epoch.fetch_add(1);
+    for (PersistentRobot* aBot : m_replaced) {
+        m_retiredNodes.push_back({epoch, aBot});
+    }
+    m_replaced.clear();
+    m_retiredVersions.push_back({epoch, old});
+    reclaim();
+}
+
+// Free everything retired before the oldest pinned epoch. Retirement epochs only grow, so the
+// retired lists are ordered and freeing stops at the first entry still visible.
+void PersistentSwarm::reclaim() {
+    uint64_t oldest = m_epoch.load();
+    for (atomic<uint64_t>& pin : m_pins) {
+        uint64_t pinned = pin.load();
+        if (pinned != 0 && pinned < oldest) {
+            oldest = pinned;
+        }
+    }
+    while (!m_retiredNodes.empty() && m_retiredNodes.front().first < oldest) {
+        delete m_retiredNodes.front().second;
+        m_retiredNodes.pop_front();
+    }
+    while (!m_retiredVersions.empty() && m_retiredVersions.front().first < oldest) {
+        delete m_retiredVersions.front().second;
+        m_retiredVersions.pop_front();
+    }
+}
+
+// Insert a robot; duplicates and IDs outside MINID..MAXID are ignored
+void PersistentSwarm::insert(const Robot& robot) {
+    if (robot.getID() < MINID || robot.getID() > MAXID) {
+        return;
+    }
+    lock_guard<mutex> guard(m_writeLock);
+    Version* current = m_current.load();
+    if (findInVersion(current->m_root, robot.getID()) != nullptr) {
+        return;
+    }
+    m_writeVersion++;
+    PersistentRobot* root = insertRobot(robot, current->m_root);
+    publish(root, current->m_size + 1);
+}
+
+// Publish an empty version; the old nodes are freed once no snapshot can reach them
+void PersistentSwarm::clear() {
+    lock_guard<mutex> guard(m_writeLock);
+    Version* current = m_current.load();
+    if (current->m_root == nullptr) {
+        return;
+    }
+    collectAll(current->m_root, m_replaced);
+    publish(nullptr, 0);
+}
+
+// Remove the robot with id if it is in the tree
+void PersistentSwarm::remove(int id) {
+    lock_guard<mutex> guard(m_writeLock);
+    Version* current = m_current.load();
+    if (findInVersion(current->m_root, id) == nullptr) {
+        return;
+    }
+    m_writeVersion++;
+    PersistentRobot* root = deleteRobot(current->m_root, id);
+    publish(root, current->m_size - 1);
+}
+
+// Prints the current version in ascending order of IDs
+void PersistentSwarm::listRobots() const {
+    snapshot().listRobots();
+}
+
+// Writes the listing of listRobots() to out
+void PersistentSwarm::listRobots(OutputSink& out) const {
+    snapshot().listRobots(out);
+}
+
+// Set the state of the robot with id; returns false if it is not in the tree. Setting the
+// state it already has publishes nothing.
+bool PersistentSwarm::setState(int id, STATE state) {
+    lock_guard<mutex> guard(m_writeLock);
+    Version* current = m_current.load();
+    const PersistentRobot* aBot = findInVersion(current->m_root, id);
+    if (aBot == nullptr) {
+        return false;
+    }
+    if (aBot->m_state == state) {
+        return true;
+    }
+    m_writeVersion++;
+    PersistentRobot* root = setRobotState(current->m_root, id, state);
+    publish(root, current->m_size);
+    return true;
+}
+
+// Rebuild the tree from copies of the surviving robots, O(n). Every node of the old version is
+// retired since snapshots may still be walking it.
+void PersistentSwarm::removeDead() {
+    lock_guard<mutex> guard(m_writeLock);
+    Version* current = m_current.load();
+    vector<PersistentRobot*> robots;
+    collectAll(current->m_root, robots);
+    m_writeVersion++;
+    vector<PersistentRobot*> survivors;
+    for (PersistentRobot* aBot : robots) {
+        if (aBot->m_state == ALIVE) {
+            survivors.push_back(newRobot(aBot->m_id, aBot->m_type, aBot->m_state));
+        }
+    }
+    if (survivors.size() == robots.size()) {
+        for (PersistentRobot* aBot : survivors) {
+            delete aBot;
+        }
+        return;
+    }
+    m_replaced.swap(robots);
+    PersistentRobot* root = buildBalanced(survivors, 0, (int)survivors.size() - 1);
+    publish(root, (int)survivors.size());
+}
+
+// This function returns true if it finds the robot with id in the current version.
+bool PersistentSwarm::findBot(int id) const {
+    return snapshot().findBot(id);
+}
+
+// Pin the current epoch in a free slot, then load the current version. The pin is re-read
+// until the epoch stays put, so no write can have retired the version between the two loads.
+// Threads start their slot search at different places; when every slot is taken it yields and
+// tries again.
+SwarmSnapshot PersistentSwarm::snapshot() const {
+    size_t start = hash<thread::id>()(this_thread::get_id());
+    for (size_t attempt = 0; ; attempt++) {
+        int slot = (int)((start + attempt) % SNAPSHOT_SLOTS);
+        uint64_t epoch = m_epoch.load();
+        uint64_t unpinned = 0;
+        if (m_pins[slot].compare_exchange_strong(unpinned, epoch)) {
+            uint64_t now = m_epoch.load();
+            while (now != epoch) {
+                epoch = now;
+                m_pins[slot].store(epoch);
+                now = m_epoch.load();
+            }
+            Version* current = m_current.load();
+            return SwarmSnapshot(this, slot, current->m_root, current->m_size);
+        }
+        if ((attempt + 1) % SNAPSHOT_SLOTS == 0) {
+            this_thread::yield();
+        }
+    }
+}
+
+// Unpin a snapshot slot
+void PersistentSwarm::release(int slot) const {
+    m_pins[slot].store(0);
+}
+
+// Handle on a version whose epoch is pinned in slot
+SwarmSnapshot::SwarmSnapshot(const PersistentSwarm* owner, int slot, const PersistentRobot* root, int size) {
+    m_owner = owner;
+    m_slot = slot;
+    m_root = root;
+    m_size = size;
+}
+
+// Take over the pin of other
+SwarmSnapshot::SwarmSnapshot(SwarmSnapshot&& other) noexcept {
+    m_owner = other.m_owner;
+    m_slot = other.m_slot;
+    m_root = other.m_root;
+    m_size = other.m_size;
+    other.m_owner = nullptr;
+}
+
+// Unpin the epoch so the writers can free this version
+SwarmSnapshot::~SwarmSnapshot() {
+    if (m_owner != nullptr) {
+        m_owner->release(m_slot);
+    }
+}
+
+// This function returns true if it finds the robot with id in this version.
+bool SwarmSnapshot::findBot(int id) const {
+    return findInVersion(m_root, id) != nullptr;
+}
+
+// Prints every robot of this version in ascending order of IDs
+void SwarmSnapshot::listRobots() const {
+    OutputSink out(cout);
+    listRobots(out);
+}
+
+// Writes the listing of listRobots() to out
+void SwarmSnapshot::listRobots(OutputSink& out) const {
+    forEach([&out](const PersistentRobot& aBot) {
+        Swarm::writeRobot(aBot.getID(), aBot.getState(), aBot.getType(), out);
+    });
+}
+
+// Visit every robot of this version in ascending order of IDs
+void SwarmSnapshot::forEach(const function<void(const PersistentRobot&)>& visit) const {
+    vector<const PersistentRobot*> stack;
+    const PersistentRobot* aBot = m_root;
+    while (aBot != nullptr || !stack.empty()) {
+        while (aBot != nullptr) {
+            stack.push_back(aBot);
+            aBot = aBot->m_left;
+        }
+        aBot = stack.back();
+        stack.pop_back();
+        visit(*aBot);
+        aBot = aBot->m_right;
+    }
+}
+
+// Number of robots in this version
+int SwarmSnapshot::size() const {
+    return m_size;
+}
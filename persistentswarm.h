@@ -0,0 +1,111 @@
+#pragma once
+#ifndef PERSISTENTSWARM_H
+#define PERSISTENTSWARM_H
+#include "swarm.h"
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <cstdint>
+#define SNAPSHOT_SLOTS 128 //snapshots that can be held at the same time
+
+// Node of a PersistentSwarm. Once a version is published its nodes never change again; a
+// write copies the nodes it would modify. m_version is the write that created the node, which
+// may keep modifying it until it publishes.
+struct PersistentRobot {
+    int m_id;
+    ROBOTTYPE m_type;
+    STATE m_state;
+    int m_height;
+    PersistentRobot* m_left;
+    PersistentRobot* m_right;
+    uint64_t m_version;
+
+    int getID() const { return m_id; }
+    ROBOTTYPE getType() const { return m_type; }
+    STATE getState() const { return m_state; }
+    int getHeight() const { return m_height; }
+    const PersistentRobot* getLeft() const { return m_left; }
+    const PersistentRobot* getRight() const { return m_right; }
+};
+
+class PersistentSwarm;
+
+// Read-only view of one version of a PersistentSwarm. Taking it pins the current epoch, which
+// keeps every node of that version alive until the snapshot is destroyed; reading it takes no
+// lock. A snapshot must not outlive its swarm.
+class SwarmSnapshot {
+public:
+    friend class PersistentSwarm;
+    friend class Tester;
+    SwarmSnapshot(SwarmSnapshot&& other) noexcept;
+    SwarmSnapshot(const SwarmSnapshot&) = delete;
+    SwarmSnapshot& operator=(const SwarmSnapshot&) = delete;
+    ~SwarmSnapshot();
+    bool findBot(int id) const;//returns true if the bot is in this version
+    void listRobots() const;//same output as Swarm::listRobots
+    void listRobots(OutputSink& out) const;//same text as listRobots(), written to out
+    void forEach(const function<void(const PersistentRobot&)>& visit) const;//in ID order
+    int size() const;
+
+private:
+    const PersistentSwarm* m_owner;
+    int m_slot;
+    const PersistentRobot* m_root;
+    int m_size;
+
+    SwarmSnapshot(const PersistentSwarm* owner, int slot, const PersistentRobot* root, int size);
+};
+
+// Persistent AVL swarm for consistent reports under writes. insert, remove, setState and
+// removeDead copy the path from the changed node to a new root and publish it atomically;
+// readers take a snapshot() and traverse it without locks. Writers are serialized by a mutex.
+// Replaced nodes are retired with the current epoch and freed once no snapshot pinned at or
+// before that epoch remains (epoch-based reclamation).
+class PersistentSwarm {
+public:
+    friend class Grader;
+    friend class Tester;
+    friend class SwarmSnapshot;
+    PersistentSwarm();
+    ~PersistentSwarm();
+    void insert(const Robot& robot);
+    void clear();
+    void remove(int id);
+    void listRobots() const;
+    void listRobots(OutputSink& out) const;//same text as listRobots(), written to out
+    bool setState(int id, STATE state);
+    void removeDead();//removes all dead robots from the tree
+    bool findBot(int id) const;//returns true if the bot is in tree
+    SwarmSnapshot snapshot() const;//read-only handle on the current version
+
+private:
+    struct Version {
+        PersistentRobot* m_root;
+        int m_size;
+    };
+    atomic<Version*> m_current;//published version, replaced as a whole by every write
+    mutable atomic<uint64_t> m_epoch;
+    mutable atomic<uint64_t> m_pins[SNAPSHOT_SLOTS];//epoch pinned by each snapshot, 0 when free
+    mutex m_writeLock;
+    uint64_t m_writeVersion;//version of the write in progress
+    vector<PersistentRobot*> m_replaced;//nodes of the published version the write replaced
+    deque<pair<uint64_t, PersistentRobot*>> m_retiredNodes;//with the epoch they were retired in
+    deque<pair<uint64_t, Version*>> m_retiredVersions;
+
+    PersistentRobot* newRobot(int id, ROBOTTYPE type, STATE state);
+    PersistentRobot* own(PersistentRobot* aBot);
+    static int height(const PersistentRobot* aBot);
+    static void updateHeight(PersistentRobot* aBot);
+    PersistentRobot* rebalance(PersistentRobot* aBot);
+    PersistentRobot* singleRightRotation(PersistentRobot* aBot);
+    PersistentRobot* singleLeftRotation(PersistentRobot* aBot);
+    PersistentRobot* insertRobot(const Robot& robot, PersistentRobot* aBot);
+    PersistentRobot* deleteRobot(PersistentRobot* aBot, int id);
+    PersistentRobot* setRobotState(PersistentRobot* aBot, int id, STATE state);
+    PersistentRobot* buildBalanced(vector<PersistentRobot*>& robots, int low, int high);
+    void collectAll(PersistentRobot* aBot, vector<PersistentRobot*>& robots);
+    void publish(PersistentRobot* root, int size);
+    void reclaim();
+    void release(int slot) const;
+};
+#endif
@@ -1,28 +1,435 @@
 //UMBC - CSEE - CMSC 341 - Fall 2021 - Proj2
 #include "swarm.h"
+#include "frozenswarm.h"
+#include "outputsink.h"
+#include "mappedswarm.h"
+#include "swarmjournal.h"
+#include <algorithm>
+#include <thread>
+#include <new>
+#include <unistd.h>
+#include <cmath>
+
+// Number of slots of the direct-addressed ID index
+const int INDEX_SLOTS = MAXID - MINID + 1;
+
+// Below this many robots a single thread sorts faster than splitting the work
+const size_t PARALLEL_SORT_MIN = 1 << 16;
+
+// Order robots by ID only
+static bool lessByID(const Robot& first, const Robot& second) {
+    return first.getID() < second.getID();
+}
+
+// Stable sort of robots by ID. Large inputs are cut into one chunk per core, the chunks are
+// sorted in parallel and then merged pairwise, each merge level also running in parallel.
+static void sortByID(vector<Robot>& robots) {
+    size_t chunks = thread::hardware_concurrency();
+    if (robots.size() < PARALLEL_SORT_MIN || chunks < 2) {
+        stable_sort(robots.begin(), robots.end(), lessByID);
+        return;
+    }
+    vector<size_t> bounds;
+    for (size_t i = 0; i <= chunks; i++) {
+        bounds.push_back(robots.size() * i / chunks);
+    }
+    vector<thread> workers;
+    for (size_t i = 0; i < chunks; i++) {
+        workers.emplace_back([&robots, &bounds, i]() {
+            stable_sort(robots.begin() + bounds[i], robots.begin() + bounds[i + 1], lessByID);
+        });
+    }
+    for (thread& worker : workers) worker.join();
+
+    for (size_t width = 1; width < chunks; width *= 2) {
+        workers.clear();
+        for (size_t i = 0; i + width < chunks; i += 2 * width) {
+            size_t low = bounds[i], middle = bounds[i + width], high = bounds[min(i + 2 * width, chunks)];
+            workers.emplace_back([&robots, low, middle, high]() {
+                inplace_merge(robots.begin() + low, robots.begin() + middle, robots.begin() + high, lessByID);
+            });
+        }
+        for (thread& worker : workers) worker.join();
+    }
+}
+// True for a type and a state the swarm keeps counts of. Robots of any other type or state are
+// ignored like robots with an ID out of range, since their counts would be written out of bounds.
+static bool knownKind(ROBOTTYPE type, STATE state) {
+    return type >= 0 && type < TYPE_COUNT && state >= 0 && state < STATE_COUNT;
+}
+
+// Drop the robots with an ID outside MINID..MAXID or an unknown type or state, then sort the rest
+// by ID keeping only the first robot of each ID. Input that is already strictly ascending is left
+// as it is.
+static void sortUnique(vector<Robot>& robots) {
+    robots.erase(remove_if(robots.begin(), robots.end(), [](const Robot& robot) {
+        return robot.getID() < MINID || robot.getID() > MAXID || !knownKind(robot.getType(), robot.getState());
+    }), robots.end());
+    bool sorted = true;
+    for (size_t i = 1; i < robots.size() && sorted; i++) {
+        sorted = robots[i - 1].getID() < robots[i].getID();
+    }
+    if (!sorted) {
+        sortByID(robots);
+        robots.erase(unique(robots.begin(), robots.end(), [](const Robot& first, const Robot& second) {
+            return first.getID() == second.getID();
+        }), robots.end());
+    }
+}
+
+// Height of a subtree, -1 for nullptr
+static int subtreeHeight(const Robot* aBot) {
+    return (aBot == nullptr) ? -1 : aBot->getHeight();
+}
+
+
+// Arena starts without any slab; the first allocation creates one.
+RobotArena::RobotArena() {
+    m_used = ROBOT_SLAB_SIZE;
+    m_freeList = nullptr;
+    m_live = 0;
+    m_free = 0;
+}
+
+// Releases the slabs and with them every robot still allocated.
+RobotArena::~RobotArena() {
+    for (Robot* slab : m_slabs) {
+        ::operator delete(slab);
+    }
+}
+
+// Take over the slabs and free list of other
+RobotArena::RobotArena(RobotArena&& other) noexcept {
+    m_slabs = move(other.m_slabs);
+    m_kept = move(other.m_kept);
+    m_used = other.m_used;
+    m_freeList = other.m_freeList;
+    m_live = other.m_live;
+    m_free = other.m_free;
+    other.m_slabs.clear();
+    other.m_kept.clear();
+    other.m_used = ROBOT_SLAB_SIZE;
+    other.m_freeList = nullptr;
+    other.m_live = 0;
+    other.m_free = 0;
+}
+
+// Free the slabs of this arena and take over those of other
+RobotArena& RobotArena::operator=(RobotArena&& other) noexcept {
+    if (this != &other) {
+        for (Robot* slab : m_slabs) {
+            ::operator delete(slab);
+        }
+        m_slabs = move(other.m_slabs);
+        m_kept = move(other.m_kept);
+        m_used = other.m_used;
+        m_freeList = other.m_freeList;
+        m_live = other.m_live;
+        m_free = other.m_free;
+        other.m_slabs.clear();
+        other.m_kept.clear();
+        other.m_used = ROBOT_SLAB_SIZE;
+        other.m_freeList = nullptr;
+        other.m_live = 0;
+        other.m_free = 0;
+    }
+    return *this;
+}
+
+// Construct a robot in the arena, reusing a released one when possible
+Robot* RobotArena::allocate(int id, ROBOTTYPE type, STATE state) {
+    Robot* aBot = nullptr;
+    if (m_freeList != nullptr) {
+        aBot = m_freeList;
+        m_freeList = m_freeList->m_left;
+        m_free--;
+    }
+    else {
+        if (m_used == ROBOT_SLAB_SIZE) {
+            m_slabs.push_back(static_cast<Robot*>(::operator new(sizeof(Robot) * ROBOT_SLAB_SIZE)));
+            m_used = 0;
+        }
+        aBot = m_slabs.back() + m_used;
+        m_used++;
+    }
+    m_live++;
+    return new (aBot) Robot(id, type, state);
+}
+
+// Put a robot on the free list
+void RobotArena::release(Robot* aBot) {
+    aBot->m_left = m_freeList;
+    m_freeList = aBot;
+    m_live--;
+    m_free++;
+}
+
+// Drop every robot at once, keeping the first slab for the next allocations
+void RobotArena::reset() {
+    for (size_t i = 1; i < m_slabs.size(); i++) {
+        ::operator delete(m_slabs[i]);
+    }
+    if (m_slabs.size() > 1) {
+        m_slabs.resize(1);
+    }
+    m_kept.clear();
+    m_used = m_slabs.empty() ? ROBOT_SLAB_SIZE : 0;
+    m_freeList = nullptr;
+    m_live = 0;
+    m_free = 0;
+}
+
+// Hand nodes of the live robots over to other, which shares every slab of this arena from now
+// on. The robots stay where they are; only who releases them changes.
+void RobotArena::share(RobotArena& other, int nodes) {
+    retire();
+    other.keep(m_kept);
+    m_live -= nodes;
+    other.m_live += nodes;
+}
+
+// Take over every live robot of other together with its slabs. Robots on the free list of
+// other are not reused; their memory goes when the kept slabs do.
+void RobotArena::adopt(RobotArena& other) {
+    other.retire();
+    keep(other.m_kept);
+    m_live += other.m_live;
+    other.m_kept.clear();
+    other.m_freeList = nullptr;
+    other.m_live = 0;
+    other.m_free = 0;
+}
+
+// Move the slabs of this arena into a kept arena, so that other arenas can hold on to them too
+void RobotArena::retire() {
+    if (m_slabs.empty()) {
+        return;
+    }
+    shared_ptr<RobotArena> retired = make_shared<RobotArena>();
+    retired->m_slabs = move(m_slabs);
+    m_slabs.clear();
+    m_used = ROBOT_SLAB_SIZE;
+    m_kept.push_back(retired);
+}
+
+// Hold on to the kept arenas of kept as well, each of them once
+void RobotArena::keep(const vector<shared_ptr<RobotArena>>& kept) {
+    m_kept.insert(m_kept.end(), kept.begin(), kept.end());
+    sort(m_kept.begin(), m_kept.end());
+    m_kept.erase(unique(m_kept.begin(), m_kept.end()), m_kept.end());
+}
+
+// Current slab, live robot and free list counts
+ArenaStats RobotArena::stats() const {
+    ArenaStats stats;
+    stats.slabs = (int)m_slabs.size();
+    for (const shared_ptr<RobotArena>& kept : m_kept) {
+        stats.slabs += (int)kept->m_slabs.size();
+    }
+    stats.liveNodes = m_live;
+    stats.freeNodes = m_free;
+    return stats;
+}
+
 // Constructor, performs the required initializations.
 Swarm::Swarm() {
     m_root = nullptr;
+    m_journal = nullptr;
+    resetStats();
+    for (int state = 0; state < STATE_COUNT; state++) {
+        m_stateCounts[state].store(0);
+    }
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        m_typeCounts[type] = 0;
+    }
 }
 
 // Destructor, performs the required cleanup including memory deallocations.
 Swarm::~Swarm() {
+    m_journal = nullptr;//going away is not a change to record
     clear();
 }
 
+// Copy other: same robots in the same shape, with its own nodes, counts and index. The copy is
+// a new roster, so it has no journal and its operations are not timed.
+Swarm::Swarm(const Swarm& other) {
+    m_root = nullptr;
+    m_journal = nullptr;
+    resetStats();
+    for (int state = 0; state < STATE_COUNT; state++) {
+        m_stateCounts[state].store(0);
+    }
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        m_typeCounts[type] = 0;
+    }
+    enableIndex(other.indexEnabled());
+    m_root = cloneTree(other.m_root);
+}
+
+// Replace the robots with a copy of those of other. This swarm keeps its journal, which records
+// the change as a clear followed by the copied robots, and its latency timing.
+Swarm& Swarm::operator=(const Swarm& other) {
+    if (this != &other) {
+        clear();
+        enableIndex(other.indexEnabled());
+        m_root = cloneTree(other.m_root);
+    }
+    return *this;
+}
+
+// Take over the tree of other along with everything that belongs to it: nodes, counts, index,
+// journal and latency recorder. other is left an empty swarm.
+Swarm::Swarm(Swarm&& other) noexcept {
+    m_root = nullptr;
+    takeOver(other);
+}
+
+// Drop the robots of this swarm, and its journal and latency recorder, and take over those of
+// other as the move constructor does
+Swarm& Swarm::operator=(Swarm&& other) noexcept {
+    if (this != &other) {
+        takeOver(other);
+    }
+    return *this;
+}
+
+// Move every member of other into this swarm and leave other empty. The nodes stay where they
+// are; only the arena that owns them changes hands.
+void Swarm::takeOver(Swarm& other) {
+    m_root = other.m_root;
+    other.m_root = nullptr;
+    m_arena = move(other.m_arena);
+    m_index = move(other.m_index);
+    m_present = move(other.m_present);
+    other.m_index.clear();
+    other.m_present.clear();
+    for (int state = 0; state < STATE_COUNT; state++) {
+        m_stateCounts[state].store(other.m_stateCounts[state].load());
+        other.m_stateCounts[state].store(0);
+    }
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        m_typeCounts[type] = other.m_typeCounts[type];
+        other.m_typeCounts[type] = 0;
+    }
+    m_journal = other.m_journal;
+    other.m_journal = nullptr;
+    m_latency = move(other.m_latency);
+#ifdef SWARM_STATS
+    SwarmStats counters = other.stats();
+    other.resetStats();
+    m_counters.lookups.store(counters.lookups);
+    m_counters.comparisons.store(counters.comparisons);
+    m_counters.inserts.store(counters.inserts);
+    m_counters.removes.store(counters.removes);
+    m_counters.nodesVisited.store(counters.nodesVisited);
+    m_counters.rotationsLeftLeft.store(counters.rotationsLeftLeft);
+    m_counters.rotationsRightRight.store(counters.rotationsRightRight);
+    m_counters.rotationsLeftRight.store(counters.rotationsLeftRight);
+    m_counters.rotationsRightLeft.store(counters.rotationsRightLeft);
+    m_counters.heightUpdates.store(counters.heightUpdates);
+    m_counters.allocations.store(counters.allocations);
+    m_counters.frees.store(counters.frees);
+#endif
+}
+
+// Copy the subtree of aBot into new nodes of this swarm and return the copy of aBot. Heights,
+// sizes and type counts are copied as they are, so nothing is recomputed or rebalanced.
+Robot* Swarm::cloneTree(const Robot* aBot) {
+    if (aBot == nullptr) {
+        return nullptr;
+    }
+    Robot* copy = newRobot(aBot->m_id, aBot->m_type, aBot->m_state);
+    copy->m_left = cloneTree(aBot->m_left);
+    copy->m_right = cloneTree(aBot->m_right);
+    copy->m_height = aBot->m_height;
+    copy->m_size = aBot->m_size;
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        copy->m_typeCounts[type] = aBot->m_typeCounts[type];
+    }
+    return copy;
+}
+
 // This function inserts a Robot object into the tree in the proper position. The Robot::m_id 
 // should be used as the key to traverse the Swarm tree and abide by BST traversal rules. 
 // The comparison operators (>, <, ==, !=) work with the int type in C++. A Robot id is a 
 // unique number, i.e. we do not allow duplicate id in the tree.
 void Swarm::insert(const Robot& robot) {
-    m_root = insertRobot(robot, m_root);
+    emplace(robot.m_id, robot.m_type, robot.m_state);
+}
+
+// Insert a robot the caller is done with; only its ID, type and state are needed
+void Swarm::insert(Robot&& robot) {
+    emplace(robot.m_id, robot.m_type, robot.m_state);
+}
+
+// Insert a robot with id, type and state. The node is built in place in the arena, so no Robot
+// is made and copied on the way.
+void Swarm::emplace(int id, ROBOTTYPE type, STATE state) {
+    LatencyTimer timer(m_latency.get(), OP_INSERT);
+    SWARM_COUNT(inserts, 1);
+    if (!knownKind(type, state)) {
+        return;
+    }
+    m_root = insertAlongPath(id, type, state, m_root);
+}
+
+// Insert a robot into the subtree of root without recursion and return the new root. The descent
+// is recorded in a fixed array, which is enough since an AVL tree of n robots is at most about
+// 1.44 log2(n) high; a deeper tree falls back to insertRobot(). On the way back up, heights
+// are retraced and rebalanced only until a subtree keeps its old height, after which nothing
+// above can change shape and only the size and type count of each ancestor is bumped.
+// The ID range checks match insertRobot().
+Robot* Swarm::insertAlongPath(int id, ROBOTTYPE type, STATE state, Robot* root)
+{
+    Robot* path[SWARM_PATH_MAX];
+    int depth = 0;
+    for (Robot* aBot = root; aBot != nullptr; depth++) {
+        if (depth == SWARM_PATH_MAX) {
+            return insertRobot(Robot(id, type, state), root);
+        }
+        path[depth] = aBot;
+        if (aBot->m_id > id && !(id < MINID)) {
+            aBot = aBot->m_left;
+        }
+        else if (aBot->m_id < id && !(id > MAXID)) {
+            aBot = aBot->m_right;
+        }
+        else {
+            SWARM_COUNT(nodesVisited, depth + 1);
+            return root;//duplicate
+        }
+    }
+    SWARM_COUNT(nodesVisited, 2 * depth);//down the path and back up
+    Robot* child = newRobot(id, type, state);
+    bool retracing = true;
+    while (depth > 0) {
+        Robot* aBot = path[--depth];
+        if (id < aBot->m_id) {
+            aBot->m_left = child;
+        }
+        else {
+            aBot->m_right = child;
+        }
+        if (retracing) {
+            int height = aBot->m_height;
+            updateHeight(aBot);
+            child = rebalance(aBot);
+            retracing = child->m_height != height;
+        }
+        else {
+            aBot->m_size++;
+            aBot->m_typeCounts[type]++;
+            child = aBot;
+        }
+    }
+    return child;
 }
 
 // Insert robot using recursion function
 Robot* Swarm::insertRobot(const Robot& robot, Robot* &aBot)
 {
     if (aBot == nullptr) {
-        Robot* anotherBot = new Robot(robot.getID(), robot.m_type, robot.m_state);
+        Robot* anotherBot = newRobot(robot.getID(), robot.m_type, robot.m_state);
         return anotherBot;
     }
     else if (aBot->m_id > robot.getID() && !(robot.getID() < MINID)) {
@@ -32,7 +439,7 @@ Robot* Swarm::insertRobot(const Robot& robot, Robot* &aBot)
     }
     else if (aBot->m_id < robot.getID() && !(robot.getID() > MAXID)) {
         aBot->m_right = insertRobot(robot, aBot->m_right);
-        updateHeight(m_root);
+        updateHeight(aBot);
         return rebalance(aBot);
     }
     else {
@@ -42,19 +449,645 @@ Robot* Swarm::insertRobot(const Robot& robot, Robot* &aBot)
 }
 
 // The clear function deallocates all memory in the tree and makes it an empty tree.
+// Every node lives in the arena, so resetting it releases the whole tree without visiting it.
 void Swarm::clear() {
-    clearFromNode(m_root);
+    if (m_journal != nullptr) {
+        m_journal->append(JOURNAL_CLEAR, 0);
+    }
+    m_root = nullptr;
+    m_arena.reset();
+    for (int state = 0; state < STATE_COUNT; state++) {
+        m_stateCounts[state].store(0);
+    }
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        m_typeCounts[type] = 0;
+    }
+    if (indexEnabled()) {
+        fill(m_index.begin(), m_index.end(), nullptr);
+        fill(m_present.begin(), m_present.end(), 0);
+    }
 }
 
-// Clear from a specific node in the tree
-void Swarm::clearFromNode(Robot* &aBot)
-{
-    if (aBot == nullptr) return;
+// Allocator statistics for the nodes of this swarm
+ArenaStats Swarm::allocatorStats() const {
+    return m_arena.stats();
+}
+
+// Operation counters since the last resetStats() and the current shape of the tree. The AVL
+// bound is 1.4405 log2(n + 2) - 0.3277; a height above it means the tree is out of balance.
+SwarmStats Swarm::stats() const {
+    SwarmStats stats = {};
+    stats.robots = size();
+    stats.height = (m_root != nullptr) ? m_root->m_height : -1;
+    stats.heightBound = (m_root != nullptr) ? (int)floor(1.4405 * log2(stats.robots + 2.0) - 0.3277) : -1;
+#ifdef SWARM_STATS
+    stats.enabled = true;
+    stats.lookups = m_counters.lookups.load(memory_order_relaxed);
+    stats.comparisons = m_counters.comparisons.load(memory_order_relaxed);
+    stats.inserts = m_counters.inserts.load(memory_order_relaxed);
+    stats.removes = m_counters.removes.load(memory_order_relaxed);
+    stats.nodesVisited = m_counters.nodesVisited.load(memory_order_relaxed);
+    stats.rotationsLeftLeft = m_counters.rotationsLeftLeft.load(memory_order_relaxed);
+    stats.rotationsRightRight = m_counters.rotationsRightRight.load(memory_order_relaxed);
+    stats.rotationsLeftRight = m_counters.rotationsLeftRight.load(memory_order_relaxed);
+    stats.rotationsRightLeft = m_counters.rotationsRightLeft.load(memory_order_relaxed);
+    stats.heightUpdates = m_counters.heightUpdates.load(memory_order_relaxed);
+    stats.allocations = m_counters.allocations.load(memory_order_relaxed);
+    stats.frees = m_counters.frees.load(memory_order_relaxed);
+#endif
+    return stats;
+}
+
+// Start every operation counter over from 0
+void Swarm::resetStats() {
+#ifdef SWARM_STATS
+    atomic<uint64_t>* counters[] = { &m_counters.lookups, &m_counters.comparisons, &m_counters.inserts,
+        &m_counters.removes, &m_counters.nodesVisited, &m_counters.rotationsLeftLeft,
+        &m_counters.rotationsRightRight, &m_counters.rotationsLeftRight, &m_counters.rotationsRightLeft,
+        &m_counters.heightUpdates, &m_counters.allocations, &m_counters.frees };
+    for (atomic<uint64_t>* counter : counters) {
+        counter->store(0, memory_order_relaxed);
+    }
+#endif
+}
+
+// Start or stop timing the public operations. Turning it on starts from empty histograms. The
+// recorder is swapped without synchronization, so no other operation may run meanwhile; reading
+// the histograms with latency() or writeLatency() is safe at any time.
+void Swarm::enableLatency(bool enable) {
+    if (enable && m_latency == nullptr) {
+        m_latency.reset(new LatencyRecorder());
+    }
+    else if (!enable) {
+        m_latency.reset();
+    }
+}
+
+// True while the public operations are timed
+bool Swarm::latencyEnabled() const {
+    return m_latency != nullptr;
+}
+
+// Latencies of op since timing was turned on, merged over every recording thread
+LatencyHistogram Swarm::latency(SWARMOP op) const {
+    return (m_latency != nullptr) ? m_latency->snapshot(op) : LatencyHistogram();
+}
+
+// The latencies of every operation as one JSON object keyed by operation, in nanoseconds
+void Swarm::writeLatency(OutputSink& out) const {
+    out.put('{');
+    for (int op = 0; op < SWARMOP_COUNT; op++) {
+        LatencyHistogram histogram = latency(static_cast<SWARMOP>(op));
+        out.write(op == 0 ? "\"" : ",\"");
+        out.write(SWARMOP_NAMES[op]);
+        out.write("\":{\"count\":");
+        out.writeInt((long long)histogram.count());
+        out.write(",\"mean\":");
+        out.writeInt((long long)llround(histogram.mean()));
+        out.write(",\"p50\":");
+        out.writeInt((long long)histogram.percentile(50));
+        out.write(",\"p99\":");
+        out.writeInt((long long)histogram.percentile(99));
+        out.write(",\"p99.9\":");
+        out.writeInt((long long)histogram.percentile(99.9));
+        out.write(",\"max\":");
+        out.writeInt((long long)histogram.max());
+        out.put('}');
+    }
+    out.write("}\n");
+}
+
+// The statistics as one JSON object
+void SwarmStats::writeJSON(OutputSink& out) const {
+    const pair<const char*, uint64_t> counters[] = { { "lookups", lookups }, { "comparisons", comparisons },
+        { "inserts", inserts }, { "removes", removes }, { "nodesVisited", nodesVisited },
+        { "heightUpdates", heightUpdates }, { "allocations", allocations }, { "frees", frees } };
+    out.write("{\"enabled\":");
+    out.write(enabled ? "true" : "false");
+    out.write(",\"robots\":");
+    out.writeInt(robots);
+    out.write(",\"height\":");
+    out.writeInt(height);
+    out.write(",\"heightBound\":");
+    out.writeInt(heightBound);
+    for (const auto& counter : counters) {
+        out.write(",\"");
+        out.write(counter.first);
+        out.write("\":");
+        out.writeInt((long long)counter.second);
+    }
+    out.write(",\"rotations\":{\"leftLeft\":");
+    out.writeInt((long long)rotationsLeftLeft);
+    out.write(",\"rightRight\":");
+    out.writeInt((long long)rotationsRightRight);
+    out.write(",\"leftRight\":");
+    out.writeInt((long long)rotationsLeftRight);
+    out.write(",\"rightLeft\":");
+    out.writeInt((long long)rotationsRightLeft);
+    out.write("}}\n");
+}
+
+// One Prometheus sample line, name{labels} value
+static void writeSample(OutputSink& out, string_view name, string_view labels, long long value) {
+    out.write(name);
+    out.write(labels);
+    out.put(' ');
+    out.writeInt(value);
+    out.put('\n');
+}
+
+// The statistics in the Prometheus text exposition format: gauges for the shape of the tree and
+// counters for the operations, rotations labelled by kind
+void SwarmStats::writePrometheus(OutputSink& out) const {
+    const struct { const char* name; const char* help; const char* type; long long value; } metrics[] = {
+        { "swarm_stats_enabled", "1 if the swarm was built with SWARM_STATS.", "gauge", enabled ? 1 : 0 },
+        { "swarm_robots", "Robots in the swarm.", "gauge", robots },
+        { "swarm_height", "Height of the tree, -1 when empty.", "gauge", height },
+        { "swarm_height_bound", "Largest height an AVL tree of this size can have.", "gauge", heightBound },
+        { "swarm_lookups_total", "Lookups by ID.", "counter", (long long)lookups },
+        { "swarm_comparisons_total", "ID comparisons made by lookups.", "counter", (long long)comparisons },
+        { "swarm_inserts_total", "Insert calls.", "counter", (long long)inserts },
+        { "swarm_removes_total", "Remove calls.", "counter", (long long)removes },
+        { "swarm_nodes_visited_total", "Nodes visited by inserts and removes.", "counter", (long long)nodesVisited },
+        { "swarm_height_updates_total", "Node height and count updates.", "counter", (long long)heightUpdates },
+        { "swarm_allocations_total", "Robots taken from the arena.", "counter", (long long)allocations },
+        { "swarm_frees_total", "Robots given back to the arena.", "counter", (long long)frees } };
+    for (const auto& metric : metrics) {
+        out.write("# HELP ");
+        out.write(metric.name);
+        out.put(' ');
+        out.write(metric.help);
+        out.write("\n# TYPE ");
+        out.write(metric.name);
+        out.put(' ');
+        out.write(metric.type);
+        out.put('\n');
+        writeSample(out, metric.name, "", metric.value);
+    }
+    out.write("# HELP swarm_rotations_total Rotations done by rebalance, by kind of imbalance.\n");
+    out.write("# TYPE swarm_rotations_total counter\n");
+    writeSample(out, "swarm_rotations_total", "{kind=\"left_left\"}", (long long)rotationsLeftLeft);
+    writeSample(out, "swarm_rotations_total", "{kind=\"right_right\"}", (long long)rotationsRightRight);
+    writeSample(out, "swarm_rotations_total", "{kind=\"left_right\"}", (long long)rotationsLeftRight);
+    writeSample(out, "swarm_rotations_total", "{kind=\"right_left\"}", (long long)rotationsRightLeft);
+}
+
+// Build the direct-addressed index over MINID..MAXID from the current tree, or drop it. While it
+// is enabled, findBot and setState for an ID in range are one array access instead of a descent.
+void Swarm::enableIndex(bool enable) {
+    if (enable == indexEnabled()) {
+        return;
+    }
+    if (enable) {
+        m_index.assign(INDEX_SLOTS, nullptr);
+        m_present.assign((INDEX_SLOTS + 63) / 64, 0);
+        indexTree(m_root);
+    }
     else {
-        clearFromNode(aBot->m_left);
-        clearFromNode(aBot->m_right);
-        delete aBot;
-        aBot = nullptr;
+        vector<Robot*>().swap(m_index);
+        vector<uint64_t>().swap(m_present);
+    }
+}
+
+// True when the direct-addressed index is maintained
+bool Swarm::indexEnabled() const {
+    return !m_index.empty();
+}
+
+// Add every robot of the subtree to the index
+void Swarm::indexTree(Robot* aBot) {
+    if (aBot != nullptr) {
+        indexTree(aBot->m_left);
+        indexRobot(aBot);
+        indexTree(aBot->m_right);
+    }
+}
+
+// Record aBot as the node of its ID. IDs outside MINID..MAXID are only found through the tree.
+void Swarm::indexRobot(Robot* aBot) {
+    if (!indexEnabled() || aBot->m_id < MINID || aBot->m_id > MAXID) {
+        return;
+    }
+    int slot = aBot->m_id - MINID;
+    m_index[slot] = aBot;
+    m_present[slot / 64] |= uint64_t(1) << (slot % 64);
+}
+
+// Forget the node of id
+void Swarm::unindexRobot(int id) {
+    if (!indexEnabled() || id < MINID || id > MAXID) {
+        return;
+    }
+    int slot = id - MINID;
+    m_index[slot] = nullptr;
+    m_present[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+}
+
+// Allocate a node from the arena, index it, count it and journal it. Every robot that joins the
+// tree comes through here, whichever operation adds it.
+Robot* Swarm::newRobot(int id, ROBOTTYPE type, STATE state) {
+    SWARM_COUNT(allocations, 1);
+    if (m_journal != nullptr) {
+        m_journal->append(JOURNAL_INSERT, id, type, state);
+    }
+    Robot* aBot = m_arena.allocate(id, type, state);
+    indexRobot(aBot);
+    countRobot(aBot, 1);
+    return aBot;
+}
+
+// Drop a node from the index and the counts and return it to the arena
+void Swarm::releaseRobot(Robot* aBot) {
+    SWARM_COUNT(frees, 1);
+    unindexRobot(aBot->m_id);
+    countRobot(aBot, -1);
+    m_arena.release(aBot);
+}
+
+// Add delta to the swarm-wide counts of the type and state of aBot
+void Swarm::countRobot(const Robot* aBot, int delta) {
+    m_stateCounts[aBot->m_state].fetch_add(delta, memory_order_relaxed);
+    m_typeCounts[aBot->m_type] += delta;
+}
+
+// Write the robots to a binary swarm file at path
+bool Swarm::save(const string& path) const {
+    return MappedSwarm::save(path, *this);
+}
+
+// Map a swarm file and build the tree from its sorted records in one O(n) pass, as the bulk
+// load does. The file is checked before the current robots are dropped.
+bool Swarm::load(const string& path) {
+    MappedSwarm file;
+    if (!file.open(path)) {
+        return false;
+    }
+    clear();
+    vector<Robot*> nodes;
+    nodes.reserve(file.size());
+    for (size_t i = 0; i < (size_t)file.size(); i++) {
+        nodes.push_back(newRobot(file.idAt(i), file.typeAt(i), file.stateAt(i)));
+    }
+    m_root = buildBalanced(nodes, 0, (int)nodes.size() - 1);
+    return true;
+}
+
+// Record every later change of the swarm in journal, or stop recording with nullptr. The journal
+// is not owned and must stay open while it is attached.
+void Swarm::attachJournal(SwarmJournal* journal) {
+    m_journal = journal;
+}
+
+// Save a swarm file at path and then reset the attached journal, so recovery starts from the
+// file. A crash between the two replays the old journal on the new file, which its records
+// allow, see swarmjournal.h.
+bool Swarm::checkpoint(const string& path) {
+    if (m_journal != nullptr) {
+        m_journal->commit();
+    }
+    if (!save(path)) {
+        return false;
+    }
+    return m_journal == nullptr || m_journal->reset();
+}
+
+// Rebuild the swarm after a restart: load the swarm file at snapshotPath, or start empty if
+// there is none, and replay the journal at journalPath on top. Nothing replayed is journaled
+// again. Returns false if either file is damaged.
+bool Swarm::recover(const string& snapshotPath, const string& journalPath) {
+    SwarmJournal* journal = m_journal;
+    m_journal = nullptr;
+    bool loaded = load(snapshotPath);
+    if (!loaded && access(snapshotPath.c_str(), F_OK) != 0) {
+        clear();
+        loaded = true;
+    }
+    bool replayed = loaded && SwarmJournal::replay(journalPath, *this) >= 0;
+    m_journal = journal;
+    return replayed;
+}
+
+// Build a read-only Eytzinger snapshot of the current robots in O(n)
+FrozenSwarm Swarm::freeze() const {
+    return FrozenSwarm(*this);
+}
+
+// Replace the tree with the given robots. Robots with an ID outside MINID..MAXID are dropped and,
+// as with insert(), only the first robot of each ID is kept. Unsorted input is sorted first; the
+// tree itself is then built in O(n) without any descent or rotation.
+void Swarm::assignRobots(vector<Robot>& robots) {
+    clear();
+    sortUnique(robots);
+    vector<Robot*> nodes;
+    nodes.reserve(robots.size());
+    for (const Robot& robot : robots) {
+        nodes.push_back(newRobot(robot.getID(), robot.m_type, robot.m_state));
+    }
+    m_root = buildBalanced(nodes, 0, (int)nodes.size() - 1);
+}
+
+// Insert a batch of robots. The batch is prepared as in assignRobots() and then merged into the
+// tree by unionBatch(), which descends into a subtree only with the part of the batch that
+// belongs there. Path prefixes shared by several robots are walked once, and subtrees that
+// receive no robot are not visited at all. Robots whose ID is already in the tree are ignored.
+int Swarm::insertRobots(vector<Robot>& robots) {
+    sortUnique(robots);
+    int live = m_arena.stats().liveNodes;
+    m_root = unionBatch(m_root, robots, 0, (int)robots.size() - 1);
+    return m_arena.stats().liveNodes - live;
+}
+
+// Remove a batch of IDs in one pass of differenceBatch(). IDs that are not in the tree are ignored.
+int Swarm::removeIDs(vector<int>& ids) {
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    int live = m_arena.stats().liveNodes;
+    if (m_journal != nullptr) {
+        for (int id : ids) {
+            m_journal->append(JOURNAL_REMOVE, id);//removing a missing robot replays as a no-op
+        }
+    }
+    m_root = differenceBatch(m_root, ids, 0, (int)ids.size() - 1);
+    return live - m_arena.stats().liveNodes;
+}
+
+// Merge robots[low..high], sorted by ID, into the subtree of aBot. The batch is split around
+// aBot, both halves are merged into the children and aBot joins the results again. A single
+// robot takes the ordinary insert path, which is cheaper than joining at every level.
+Robot* Swarm::unionBatch(Robot* aBot, const vector<Robot>& robots, int low, int high)
+{
+    if (low > high) {
+        return aBot;
+    }
+    if (aBot == nullptr) {
+        return buildBatch(robots, low, high);
+    }
+    if (low == high) {
+        return insertAlongPath(robots[low].m_id, robots[low].m_type, robots[low].m_state, aBot);
+    }
+    int middle = (int)(std::lower_bound(robots.begin() + low, robots.begin() + high + 1, aBot->m_id,
+        [](const Robot& robot, int id) { return robot.getID() < id; }) - robots.begin());
+    int skip = (middle <= high && robots[middle].getID() == aBot->m_id) ? 1 : 0;//duplicate of aBot
+    Robot* left = unionBatch(aBot->m_left, robots, low, middle - 1);
+    Robot* right = unionBatch(aBot->m_right, robots, middle + skip, high);
+    return joinRobots(left, aBot, right);
+}
+
+// Remove ids[low..high], sorted, from the subtree of aBot, splitting the IDs around aBot as in
+// unionBatch(). A removed aBot leaves two subtrees that are joined through the largest robot
+// of the left one. A single ID takes the ordinary remove path.
+Robot* Swarm::differenceBatch(Robot* aBot, const vector<int>& ids, int low, int high)
+{
+    if (aBot == nullptr || low > high) {
+        return aBot;
+    }
+    if (low == high) {
+        return deleteAlongPath(aBot, ids[low]);
+    }
+    int middle = (int)(std::lower_bound(ids.begin() + low, ids.begin() + high + 1, aBot->m_id) - ids.begin());
+    bool hit = middle <= high && ids[middle] == aBot->m_id;
+    Robot* left = differenceBatch(aBot->m_left, ids, low, middle - 1);
+    Robot* right = differenceBatch(aBot->m_right, ids, middle + (hit ? 1 : 0), high);
+    if (hit) {
+        releaseRobot(aBot);
+        return joinTrees(left, right);
+    }
+    return joinRobots(left, aBot, right);
+}
+
+// Balanced subtree of new nodes for robots[low..high], sorted by ID
+Robot* Swarm::buildBatch(const vector<Robot>& robots, int low, int high)
+{
+    if (low > high) {
+        return nullptr;
+    }
+    int middle = low + (high - low) / 2;
+    Robot* aBot = newRobot(robots[middle].getID(), robots[middle].m_type, robots[middle].m_state);
+    aBot->m_left = buildBatch(robots, low, middle - 1);
+    aBot->m_right = buildBatch(robots, middle + 1, high);
+    updateHeight(aBot);
+    return aBot;
+}
+
+// Join two AVL trees and the node middle, with every ID of left below middle and every ID of
+// right above it. The taller tree is descended along its inner spine until the heights are
+// within one, middle is linked there and the path back up is rebalanced. This costs
+// O(|height(left) - height(right)| + 1).
+Robot* Swarm::joinRobots(Robot* left, Robot* middle, Robot* right)
+{
+    if (subtreeHeight(left) > subtreeHeight(right) + 1) {
+        left->m_right = joinRobots(left->m_right, middle, right);
+        updateHeight(left);
+        return rebalance(left);
+    }
+    if (subtreeHeight(right) > subtreeHeight(left) + 1) {
+        right->m_left = joinRobots(left, middle, right->m_left);
+        updateHeight(right);
+        return rebalance(right);
+    }
+    middle->m_left = left;
+    middle->m_right = right;
+    updateHeight(middle);
+    return middle;
+}
+
+// Join two AVL trees, every ID of left below every ID of right
+Robot* Swarm::joinTrees(Robot* left, Robot* right)
+{
+    if (left == nullptr) {
+        return right;
+    }
+    Robot* last = nullptr;
+    left = splitLast(left, last);
+    return joinRobots(left, last, right);
+}
+
+// Unlink the robot with the largest ID from the subtree of aBot into last and return the
+// rebalanced rest
+Robot* Swarm::splitLast(Robot* aBot, Robot*& last)
+{
+    if (aBot->m_right == nullptr) {
+        last = aBot;
+        return aBot->m_left;
+    }
+    aBot->m_right = splitLast(aBot->m_right, last);
+    updateHeight(aBot);
+    return rebalance(aBot);
+}
+
+// Split the robots into those with an ID below id and the rest, one swarm each, by cutting the
+// tree along the search path for id and joining the pieces on either side, see splitTree(). No
+// robot is copied: the larger part takes over the nodes, arena, counts and index of this swarm,
+// and the smaller part shares the arena for its nodes. The type counts of both parts come from
+// the subtree roots, but the k robots of the smaller part are visited when the ID index is on,
+// to move their entries, or when the swarm holds both alive and dead robots, to count the dead
+// ones; split costs O(log n + k) then. This swarm is left empty, with its journal, which records
+// a clear, and its latency timing; the parts have neither.
+pair<Swarm, Swarm> Swarm::split(int id) {
+    pair<Swarm, Swarm> parts;
+    Robot* rest = nullptr;
+    Robot* below = splitTree(m_root, id, rest);
+    m_root = nullptr;
+    bool restLarger = (rest != nullptr ? rest->m_size : 0) > (below != nullptr ? below->m_size : 0);
+    Swarm& large = restLarger ? parts.second : parts.first;
+    Swarm& small = restLarger ? parts.first : parts.second;
+    Robot* smallRoot = restLarger ? below : rest;
+    large.m_root = restLarger ? rest : below;
+    large.m_arena = move(m_arena);
+    large.m_index.swap(m_index);
+    large.m_present.swap(m_present);
+    for (int state = 0; state < STATE_COUNT; state++) {
+        large.m_stateCounts[state].store(m_stateCounts[state].load());
+        m_stateCounts[state].store(0);
+    }
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        large.m_typeCounts[type] = m_typeCounts[type];
+        m_typeCounts[type] = 0;
+    }
+    enableIndex(large.indexEnabled());
+    small.enableIndex(large.indexEnabled());
+    if (smallRoot != nullptr) {
+        large.m_arena.share(small.m_arena, smallRoot->m_size);
+        large.handOver(smallRoot, small);
+        small.m_root = smallRoot;
+    }
+    if (m_journal != nullptr) {
+        m_journal->append(JOURNAL_CLEAR, 0);
+    }
+    return parts;
+}
+
+// Add pivot and every robot of right, whose IDs must all be above pivot while those of this
+// swarm are below it. The two trees and the pivot are joined by joinRobots() in O(log n) and
+// the nodes of right are adopted as they are, see adoptTree(). Returns false and changes
+// nothing if the IDs are not in that order or the pivot is outside MINID..MAXID or of an unknown
+// type or state; right is left empty otherwise. Index entries and journal records of the robots
+// of right add O(|right|) when either swarm is indexed or this one is journaled.
+bool Swarm::join(const Robot& pivot, Swarm& right) {
+    int id = pivot.getID();
+    if (&right == this || id < MINID || id > MAXID || !knownKind(pivot.m_type, pivot.m_state) ||
+        (m_root != nullptr && findMax(m_root)->m_id >= id) || (right.m_root != nullptr && findMin(right.m_root)->m_id <= id)) {
+        return false;
+    }
+    Robot* middle = newRobot(id, pivot.m_type, pivot.m_state);
+    m_root = joinRobots(m_root, middle, adoptTree(right));
+    return true;
+}
+
+// Add every robot of right, whose IDs must all be above those of this swarm, by joining the two
+// trees through the largest robot here in O(log n), plus O(|right|) under the same conditions as
+// join(). Returns false and changes nothing if the ID ranges overlap; right is left empty
+// otherwise.
+bool Swarm::concat(Swarm& right) {
+    if (&right == this) {
+        return false;
+    }
+    if (right.m_root == nullptr) {
+        return true;
+    }
+    if (m_root != nullptr && findMax(m_root)->m_id >= findMin(right.m_root)->m_id) {
+        return false;
+    }
+    m_root = joinTrees(m_root, adoptTree(right));
+    return true;
+}
+
+// Cut the subtree of aBot along the search path for id. Returns the robots below id as one AVL
+// tree and puts the rest into rest. Each node on the path is joined with the piece split off
+// below it and its subtree on the far side; the height differences of those joins add up to
+// O(log n) over the whole path.
+Robot* Swarm::splitTree(Robot* aBot, int id, Robot*& rest)
+{
+    if (aBot == nullptr) {
+        rest = nullptr;
+        return nullptr;
+    }
+    Robot* left = aBot->m_left;
+    Robot* right = aBot->m_right;
+    if (aBot->m_id < id) {
+        Robot* below = splitTree(right, id, rest);
+        return joinRobots(left, aBot, below);
+    }
+    Robot* above = nullptr;
+    Robot* below = splitTree(left, id, above);
+    rest = joinRobots(above, aBot, right);
+    return below;
+}
+
+// Take the tree of other over into this swarm and return its root, leaving other empty. The
+// arena of other is adopted whole, its counts and index entries are handed over, and the
+// journal here records every adopted robot while that of other records a clear.
+Robot* Swarm::adoptTree(Swarm& other)
+{
+    Robot* root = other.m_root;
+    if (m_journal != nullptr) {
+        journalTree(root);
+    }
+    if (other.m_journal != nullptr) {
+        other.m_journal->append(JOURNAL_CLEAR, 0);
+    }
+    m_arena.adopt(other.m_arena);
+    other.handOver(root, *this);
+    other.m_root = nullptr;
+    return root;
+}
+
+// Move the counts and index entries of the robots in the subtree of aBot from this swarm to
+// to. Index entries have to move one robot at a time. Without the index the type counts kept in
+// aBot are enough, and so are the state counts here when aBot is the whole tree or every robot
+// has the same state; otherwise the dead robots of the subtree are counted.
+void Swarm::handOver(Robot* aBot, Swarm& to)
+{
+    if (aBot == nullptr) {
+        return;
+    }
+    if (indexEnabled() || to.indexEnabled()) {
+        moveRobots(aBot, to);
+        return;
+    }
+    int dead = m_stateCounts[DEAD].load();
+    if (aBot != m_root && dead != 0) {
+        dead = (m_stateCounts[ALIVE].load() == 0) ? aBot->m_size : countDead(aBot);
+    }
+    m_stateCounts[DEAD].fetch_sub(dead);
+    to.m_stateCounts[DEAD].fetch_add(dead);
+    m_stateCounts[ALIVE].fetch_sub(aBot->m_size - dead);
+    to.m_stateCounts[ALIVE].fetch_add(aBot->m_size - dead);
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        m_typeCounts[type] -= aBot->m_typeCounts[type];
+        to.m_typeCounts[type] += aBot->m_typeCounts[type];
+    }
+}
+
+// Move the counts and index entries of every robot in the subtree, one robot at a time
+void Swarm::moveRobots(Robot* aBot, Swarm& to)
+{
+    if (aBot != nullptr) {
+        moveRobots(aBot->m_left, to);
+        unindexRobot(aBot->m_id);
+        countRobot(aBot, -1);
+        to.indexRobot(aBot);
+        to.countRobot(aBot, 1);
+        moveRobots(aBot->m_right, to);
+    }
+}
+
+// Count the DEAD robots in the subtree
+int Swarm::countDead(const Robot* aBot)
+{
+    if (aBot == nullptr) {
+        return 0;
+    }
+    return countDead(aBot->m_left) + ((aBot->m_state == DEAD) ? 1 : 0) + countDead(aBot->m_right);
+}
+
+// Journal an insert of every robot in the subtree, in ID order
+void Swarm::journalTree(const Robot* aBot)
+{
+    if (aBot != nullptr) {
+        journalTree(aBot->m_left);
+        m_journal->append(JOURNAL_INSERT, aBot->m_id, aBot->m_type, aBot->m_state);
+        journalTree(aBot->m_right);
     }
 }
 
@@ -62,8 +1095,13 @@ void Swarm::clearFromNode(Robot* &aBot)
 // (Note: After a removal, we should also update the height of each node on the path traversed down 
 // the tree as well as check for an imbalance at each node in this path.)
 void Swarm::remove(int id) {
-    Robot* aBot = m_root;
-    deleteRobot(aBot, id);
+    LatencyTimer timer(m_latency.get(), OP_REMOVE);
+    SWARM_COUNT(removes, 1);
+    int before = size();
+    m_root = deleteAlongPath(m_root, id);
+    if (m_journal != nullptr && size() < before) {
+        m_journal->append(JOURNAL_REMOVE, id);
+    }
 }
 
 // Delete a robot using recursion  
@@ -81,7 +1119,7 @@ Robot* Swarm::deleteRobot(Robot* aBot, int id)
     else {
         // Case 1: no child
         if (aBot->getLeft() == nullptr && aBot->getRight() == nullptr) {
-            delete aBot;
+            releaseRobot(aBot);
             aBot = nullptr;
         }
 
@@ -89,19 +1127,25 @@ Robot* Swarm::deleteRobot(Robot* aBot, int id)
         else if (aBot->getLeft() == nullptr) {
             Robot* temp = aBot;
             aBot = aBot->getRight();
-            delete temp;
+            releaseRobot(temp);
         }
         else if (aBot->getRight() == nullptr) {
             Robot* temp = aBot;
             aBot = aBot->getLeft();
-            delete temp;
+            releaseRobot(temp);
         }
 
         // Case 3: two children
         else {
             Robot* temp = findMin(aBot->m_right);
+            unindexRobot(aBot->m_id);
+            countRobot(aBot, -1);
             aBot->m_id = temp->m_id;
+            aBot->m_type = temp->m_type;
+            aBot->m_state = temp->m_state;
             aBot->m_right = deleteRobot(aBot->m_right, temp->m_id);
+            indexRobot(aBot);
+            countRobot(aBot, 1);//the successor node was uncounted when it was released
         }
     }
     updateHeight(aBot);
@@ -109,8 +1153,88 @@ Robot* Swarm::deleteRobot(Robot* aBot, int id)
     return aBot;
 }
 
+// Remove the robot with id from the subtree of root without recursion and return the new root.
+// As in deleteRobot(), a robot with two children takes over the payload of its successor and
+// the successor's node is the one unlinked, so the path runs down to the successor. The way up
+// retraces heights only until a subtree keeps its old height, as in insertAlongPath(), and then
+// just takes the removed robot out of the sizes and type counts of the ancestors: below the
+// robot whose payload changed that is the successor's type, from there up the removed one's.
+Robot* Swarm::deleteAlongPath(Robot* root, int id)
+{
+    Robot* path[SWARM_PATH_MAX];
+    int depth = 0;
+    Robot* target = root;
+    while (target != nullptr && target->m_id != id) {
+        if (depth == SWARM_PATH_MAX) {
+            return deleteRobot(root, id);
+        }
+        path[depth++] = target;
+        target = (id < target->m_id) ? target->m_left : target->m_right;
+    }
+    if (target == nullptr) {
+        SWARM_COUNT(nodesVisited, depth);
+        return root;
+    }
+    int targetDepth = depth;
+    ROBOTTYPE removedType = target->m_type;
+    Robot* victim = target;
+    if (target->m_left != nullptr && target->m_right != nullptr) {
+        if (depth == SWARM_PATH_MAX) {
+            return deleteRobot(root, id);
+        }
+        path[depth++] = target;
+        victim = target->m_right;
+        while (victim->m_left != nullptr) {
+            if (depth == SWARM_PATH_MAX) {
+                return deleteRobot(root, id);
+            }
+            path[depth++] = victim;
+            victim = victim->m_left;
+        }
+        unindexRobot(target->m_id);
+        countRobot(target, -1);
+        target->m_id = victim->m_id;
+        target->m_type = victim->m_type;
+        target->m_state = victim->m_state;
+    }
+    SWARM_COUNT(nodesVisited, 2 * depth + 1);//down to the node unlinked and back up
+    ROBOTTYPE successorType = victim->m_type;
+    Robot* child = (victim->m_left != nullptr) ? victim->m_left : victim->m_right;
+    Robot* below = victim;
+    releaseRobot(victim);
+    if (victim != target) {
+        indexRobot(target);
+        countRobot(target, 1);//the successor node was uncounted when it was released
+    }
+    bool retracing = true;
+    while (depth > 0) {
+        Robot* aBot = path[--depth];
+        if (aBot->m_left == below) {
+            aBot->m_left = child;
+        }
+        else {
+            aBot->m_right = child;
+        }
+        below = aBot;
+        if (retracing) {
+            int height = aBot->m_height;
+            updateHeight(aBot);
+            child = rebalance(aBot);
+            retracing = child->m_height != height;
+        }
+        else {
+            aBot->m_size--;
+            aBot->m_typeCounts[depth > targetDepth ? successorType : removedType]--;
+            child = aBot;
+        }
+    }
+    return child;
+}
+
 // This function updates the height of the node passed in. The height of a leaf node is 0. The height
 // of all internal nodes can be calculated based on the heights of their immediate children.
+// Only the node itself is updated: its children must already hold correct heights, which is
+// guaranteed when it is called bottom-up along the search path. This keeps it O(1).
 void Swarm::updateHeight(Robot* aBot) {
     int heightLeft = 0; // Height of the left robot
     int heightRight = 0; // Height of the right robot
@@ -119,8 +1243,7 @@ void Swarm::updateHeight(Robot* aBot) {
     if (aBot == nullptr) {
         return;
     }
-    updateHeight(aBot->m_left);
-    updateHeight(aBot->m_right);
+    SWARM_COUNT(heightUpdates, 1);
 
     // Case where aBot is not null
     if (aBot->m_left == nullptr) {
@@ -149,6 +1272,15 @@ void Swarm::updateHeight(Robot* aBot) {
     else {
         return;
     } 
+
+    // Update the size and the type counts of the subtree the same way
+    aBot->m_size = 1 + (aBot->m_left != nullptr ? aBot->m_left->m_size : 0) +
+        (aBot->m_right != nullptr ? aBot->m_right->m_size : 0);
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        aBot->m_typeCounts[type] = (aBot->m_left != nullptr ? aBot->m_left->m_typeCounts[type] : 0) +
+            (aBot->m_right != nullptr ? aBot->m_right->m_typeCounts[type] : 0);
+    }
+    aBot->m_typeCounts[aBot->m_type]++;
 }
 
 // This function checks if there is an imbalance at the node passed in. For an imbalance to occur, 
@@ -174,37 +1306,33 @@ int Swarm::checkImbalance(Robot* aBot) {
 // This function begins and manages the rebalancing process. It is recommended to write additional 
 // helper functions to implement left and right rotations. You can use rebalance() function to
 // determine which combination of rotations is necessary.
+// Only aBot and the nodes touched by the rotations are updated; the caller retraces the rest of
+// the search path, so rebalancing costs O(1) per node on the path.
 Robot* Swarm::rebalance(Robot* aBot) {
-    Robot* anotherBot = nullptr;
-    // Case of left imbalance 
+    if (aBot == nullptr) {
+        return aBot;
+    }
+    // Case of left - left imbalance
     if ((checkImbalance(aBot) > 1) && (checkImbalance(aBot->m_left) >= 0)) {
-        anotherBot = singleRightRotation(aBot);
-        updateHeight(m_root);
-        rebalance(m_root);
-        return anotherBot;
+        SWARM_COUNT(rotationsLeftLeft, 1);
+        return singleRightRotation(aBot);
     }
-    // Case of right imbalance 
+    // Case of right - right imbalance
     else if ((checkImbalance(aBot) < -1) && (checkImbalance(aBot->m_right) <= 0)) {
-        anotherBot = singleLeftRotation(aBot);
-        updateHeight(m_root);
-        rebalance(m_root);
-        return anotherBot;
+        SWARM_COUNT(rotationsRightRight, 1);
+        return singleLeftRotation(aBot);
     }
-    // Case of right - left imbalance
-    else if ((checkImbalance(aBot) > 1) && (checkImbalance(aBot->m_left) <= 0)) {
+    // Case of left - right imbalance
+    else if (checkImbalance(aBot) > 1) {
+        SWARM_COUNT(rotationsLeftRight, 1);
         aBot->m_left = singleLeftRotation(aBot->m_left); // Rebalance to the left
-        anotherBot = singleRightRotation(aBot);
-        updateHeight(m_root);
-        rebalance(m_root);
-        return anotherBot;
+        return singleRightRotation(aBot);
     }
-    // Case of left - right imbalance
-    else if ((checkImbalance(aBot) < -1) && (checkImbalance(aBot->m_left) >= 0)) {
+    // Case of right - left imbalance
+    else if (checkImbalance(aBot) < -1) {
+        SWARM_COUNT(rotationsRightLeft, 1);
         aBot->m_right = singleRightRotation(aBot->m_right); // Rebalance to the right
-        anotherBot = singleLeftRotation(aBot);
-        updateHeight(m_root);
-        rebalance(m_root);
-        return anotherBot;
+        return singleLeftRotation(aBot);
     }
     return aBot;
 }
@@ -212,23 +1340,19 @@ Robot* Swarm::rebalance(Robot* aBot) {
 // Find node that contains the leaf on the left of the BST
 Robot* Swarm::findMin(Robot* aBot)
 {
-    if (aBot == nullptr)
-        return nullptr;
-    else if (aBot->m_left == nullptr)
-        return aBot;
-    else
-        return findMin(aBot->m_left);
+    while (aBot != nullptr && aBot->m_left != nullptr) {
+        aBot = aBot->m_left;
+    }
+    return aBot;
 }
 
 // Find node that contains the leaf on the right of the BST
 Robot* Swarm::findMax(Robot* aBot)
 {
-    if (aBot == nullptr)
-        return nullptr;
-    else if (aBot->m_right == nullptr)
-        return aBot;
-    else
-        return findMax(aBot->m_right);
+    while (aBot != nullptr && aBot->m_right != nullptr) {
+        aBot = aBot->m_right;
+    }
+    return aBot;
 }
 
 // Single right rotation
@@ -256,8 +1380,83 @@ Robot* Swarm::singleLeftRotation(Robot* aBot)
 // This function prints a list of all robots in the tree to the standard output in the ascending 
 // order of IDs. The information for every Robot object will be printed in a new line. For the 
 // format of output please refer to the sample output file, i.e. driver.txt.
+// The text goes through an OutputSink, which sends it to cout in large pieces.
 void Swarm::listRobots() const {
-    Robot* aBot = traverseTree(m_root);
+    OutputSink out(cout);
+    listRobots(out);
+}
+
+// Writes the listing of listRobots() to out
+void Swarm::listRobots(OutputSink& out) const {
+    for (const Robot& aBot : *this) {
+        writeRobot(aBot, out);
+    }
+}
+
+// One line of a listing, ID:STATE:TYPE
+void Swarm::writeRobot(const Robot& aBot, OutputSink& out) {
+    writeRobot(aBot.getID(), aBot.getState(), aBot.getType(), out);
+}
+
+// One line of a listing from its fields, so that every backend lists robots the same way
+void Swarm::writeRobot(int id, STATE state, ROBOTTYPE type, OutputSink& out) {
+    out.writeInt(id);
+    out.put(':');
+    out.write((state >= 0 && state < STATE_COUNT) ? STATE_NAMES[state] : "UNKOWN");
+    out.put(':');
+    out.write((type >= 0 && type < TYPE_COUNT) ? TYPE_NAMES[type] : "UNKNOWN");
+    out.put('\n');
+}
+
+// Iterator on the robot with the smallest ID
+Swarm::const_iterator Swarm::begin() const {
+    const_iterator it(m_root);
+    it.descend(m_root, &Robot::m_left);
+    return it;
+}
+
+// Iterator past the robot with the largest ID
+Swarm::const_iterator Swarm::end() const {
+    return const_iterator(m_root);
+}
+
+// Iterator on the first robot with an ID not below id
+Swarm::const_iterator Swarm::lower_bound(int id) const {
+    return boundOf(id, true);
+}
+
+// Iterator on the first robot with an ID above id
+Swarm::const_iterator Swarm::upper_bound(int id) const {
+    return boundOf(id, false);
+}
+
+// Iterator on the robot with id, end() if it is not in the tree
+Swarm::const_iterator Swarm::find(int id) const {
+    const_iterator it = lower_bound(id);
+    if (it != end() && it->getID() != id) {
+        return end();
+    }
+    return it;
+}
+
+// Descend towards id recording the whole path, then cut the path back to the last node that
+// qualifies: an ID not below id when inclusive, above id otherwise.
+Swarm::const_iterator Swarm::boundOf(int id, bool inclusive) const {
+    const_iterator it(m_root);
+    int found = 0;
+    const Robot* aBot = m_root;
+    while (aBot != nullptr) {
+        it.m_path[it.m_depth++] = aBot;
+        if (aBot->m_id > id || (inclusive && aBot->m_id == id)) {
+            found = it.m_depth;
+            aBot = aBot->m_left;
+        }
+        else {
+            aBot = aBot->m_right;
+        }
+    }
+    it.m_depth = found;
+    return it;
 }
 
 // Traverse the whole tree and display information
@@ -275,49 +1474,243 @@ Robot* Swarm::traverseTree(Robot* aBot) const
 // to state. If the operation is successful, the function returns true otherwise it returns false. 
 // For example, when the robot with id does not exist in the tree the function returns false.
 bool Swarm::setState(int id, STATE state) {
+    LatencyTimer timer(m_latency.get(), OP_SET_STATE);
     Robot* aBot = findThisBot(m_root, id);
-    bool status = findBot(id);
-    if (aBot == nullptr) {
+    if (aBot == nullptr || !knownKind(aBot->m_type, state)) {
         return false;
     }
-    else if (status) {
+    if (aBot->m_state != state) {
+        if (m_journal != nullptr) {
+            m_journal->append(JOURNAL_SET_STATE, id, aBot->m_type, state);
+        }
+        m_stateCounts[aBot->m_state].fetch_sub(1, memory_order_relaxed);
+        m_stateCounts[state].fetch_add(1, memory_order_relaxed);
         aBot->setState(state);
-        return true;
     }
-    else {
-        return false;
+    return true;
+}
+
+// Number of robots in state, kept up to date by every change of the tree
+int Swarm::countByState(STATE state) const {
+    if (state < 0 || state >= STATE_COUNT) {
+        return 0;
     }
-    return false;
+    return m_stateCounts[state].load(memory_order_relaxed);
+}
+
+// Number of robots of type, kept up to date by every change of the tree
+int Swarm::countByType(ROBOTTYPE type) const {
+    if (type < 0 || type >= TYPE_COUNT) {
+        return 0;
+    }
+    return m_typeCounts[type];
+}
+
+// Number of robots of type with an ID in idLo..idHi: those below idHi + 1 minus those below idLo
+int Swarm::countByType(ROBOTTYPE type, int idLo, int idHi) const {
+    if (idLo > idHi || type < 0 || type >= TYPE_COUNT) {
+        return 0;
+    }
+    return countTypeBelow(type, (long long)idHi + 1) - countTypeBelow(type, idLo);
+}
+
+// Number of robots in the tree
+int Swarm::size() const {
+    return (m_root != nullptr) ? m_root->m_size : 0;
+}
+
+// Robots with an ID below id, which is the position of id in the ID order when it is in the tree
+int Swarm::rank(int id) const {
+    return countBelow(id);
+}
+
+// Robot k of the ID order, counting from 0. The subtree sizes tell at each node whether robot k
+// is on the left, the node itself or on the right, so one descent finds it.
+const Robot* Swarm::select(int k) const {
+    const Robot* aBot = m_root;
+    while (aBot != nullptr) {
+        int left = (aBot->m_left != nullptr) ? aBot->m_left->m_size : 0;
+        if (k < left) {
+            aBot = aBot->m_left;
+        }
+        else if (k == left) {
+            return aBot;
+        }
+        else {
+            k -= left + 1;
+            aBot = aBot->m_right;
+        }
+    }
+    return nullptr;
+}
+
+// Robots with an ID in lo..hi: those below hi + 1 minus those below lo
+int Swarm::countInRange(int lo, int hi) const {
+    if (lo > hi) {
+        return 0;
+    }
+    return countBelow((long long)hi + 1) - countBelow(lo);
+}
+
+// Calls fn for every robot with an ID in lo..hi in ascending order of IDs
+void Swarm::forEachInRange(int lo, int hi, const function<void(const Robot&)>& fn) const {
+    visitInOrder(lo, hi, INT32_MAX, fn);
+}
+
+// Prints the robots at positions page * pageSize up to (page + 1) * pageSize - 1 of the ID order,
+// in the format of listRobots(). select() finds the first one and the walk stops after pageSize.
+void Swarm::listRobots(int page, int pageSize) const {
+    if (page < 0 || pageSize <= 0 || (long long)page * pageSize >= size()) {
+        return;
+    }
+    const Robot* first = select(page * pageSize);
+    OutputSink out(cout);
+    visitInOrder(first->m_id, INT64_MAX, pageSize, [&out](const Robot& aBot) {
+        writeRobot(aBot, out);
+    });
+}
+
+// Robots with an ID below id, from one descent as in countTypeBelow()
+int Swarm::countBelow(long long id) const {
+    int count = 0;
+    const Robot* aBot = m_root;
+    while (aBot != nullptr) {
+        if (aBot->m_id < id) {
+            count += (aBot->m_left != nullptr ? aBot->m_left->m_size : 0) + 1;
+            aBot = aBot->m_right;
+        }
+        else {
+            aBot = aBot->m_left;
+        }
+    }
+    return count;
+}
+
+// In-order walk that starts at the first ID not below lo and stops after count robots or at the
+// first ID above hi. The stack starts with the path to lo without the nodes below lo, so only
+// O(log n) nodes are visited besides the ones passed to fn.
+void Swarm::visitInOrder(long long lo, long long hi, int count, const function<void(const Robot&)>& fn) const {
+    vector<const Robot*> stack;
+    const Robot* aBot = m_root;
+    while (aBot != nullptr) {
+        if (aBot->m_id >= lo) {
+            stack.push_back(aBot);
+            aBot = aBot->m_left;
+        }
+        else {
+            aBot = aBot->m_right;
+        }
+    }
+    while (!stack.empty() && count > 0) {
+        aBot = stack.back();
+        stack.pop_back();
+        if (aBot->m_id > hi) {
+            return;
+        }
+        fn(*aBot);
+        count--;
+        aBot = aBot->m_right;
+        while (aBot != nullptr) {
+            stack.push_back(aBot);
+            aBot = aBot->m_left;
+        }
+    }
+}
+
+// Robots of type with an ID below id, from one descent: whenever the path turns right, the
+// node and its left subtree are all below id and their count is read off the augmentation.
+int Swarm::countTypeBelow(ROBOTTYPE type, long long id) const {
+    int count = 0;
+    const Robot* aBot = m_root;
+    while (aBot != nullptr) {
+        if (aBot->m_id < id) {
+            count += (aBot->m_left != nullptr ? aBot->m_left->m_typeCounts[type] : 0) + (aBot->m_type == type);
+            aBot = aBot->m_right;
+        }
+        else {
+            aBot = aBot->m_left;
+        }
+    }
+    return count;
 }
 
 // This function traverses the tree, finds all robots with DEAD state and removes them from the 
 // tree. The final tree must be a balanced AVL tree.
 void Swarm::removeDead() {
-    Robot* aBot = removeDeadRobot(m_root);
+    LatencyTimer timer(m_latency.get(), OP_REMOVE_DEAD);
+    if (countByState(DEAD) == 0) {
+        return;
+    }
+    removeIf([](const Robot& robot) { return robot.getState() == DEAD; });
+}
+
+// Removes every robot for which pred returns true and returns how many were removed. Instead of
+// one root-to-leaf deletion per robot, the survivors are collected in order and relinked into a
+// perfectly balanced tree, so the whole operation is O(n) and no surviving node is reallocated.
+int Swarm::removeIf(const function<bool(const Robot&)>& pred) {
+    vector<Robot*> survivors;
+    int removed = collectSurvivors(m_root, pred, survivors);
+    if (removed > 0) {
+        m_root = buildBalanced(survivors, 0, (int)survivors.size() - 1);
+    }
+    return removed;
 }
 
-// Remove dead robots using recursion
-Robot* Swarm::removeDeadRobot(Robot* aBot)
+// Visit the tree in order, append the robots pred rejects to survivors and delete the others.
+// The tree is left unlinked when any robot was removed; the caller rebuilds it from survivors.
+int Swarm::collectSurvivors(Robot* aBot, const function<bool(const Robot&)>& pred, vector<Robot*>& survivors)
 {
-   if (aBot != nullptr) {
-        removeDeadRobot(aBot->m_left);
-        cout << aBot->getID() << ":" << aBot->getStateStr() << ":" << aBot->getTypeStr() << endl;
-        removeDeadRobot(aBot->m_right);
-        if (aBot->getState() == DEAD) {
-            remove(aBot->m_id);
+    if (aBot == nullptr) {
+        return 0;
+    }
+    int removed = collectSurvivors(aBot->m_left, pred, survivors);
+    Robot* right = aBot->m_right;
+    if (pred(*aBot)) {
+        if (m_journal != nullptr) {
+            m_journal->append(JOURNAL_REMOVE, aBot->m_id);
         }
-   }
-   return nullptr;
+        releaseRobot(aBot);
+        removed++;
+    }
+    else {
+        survivors.push_back(aBot);
+    }
+    return removed + collectSurvivors(right, pred, survivors);
+}
+
+// Link robots[low..high], which are sorted by ID, into a perfectly balanced tree and return its
+// root. Heights are set bottom-up, so the result is a valid AVL tree without any rotation.
+Robot* Swarm::buildBalanced(vector<Robot*>& robots, int low, int high)
+{
+    if (low > high) {
+        return nullptr;
+    }
+    int middle = low + (high - low) / 2;
+    Robot* aBot = robots[middle];
+    aBot->m_left = buildBalanced(robots, low, middle - 1);
+    aBot->m_right = buildBalanced(robots, middle + 1, high);
+    updateHeight(aBot);
+    return aBot;
 }
 
 // This function returns true if it finds the node with id in the tree, otherwise it returns false.
 bool Swarm::findBot(int id) const {
+    LatencyTimer timer(m_latency.get(), OP_FIND_BOT);
+    if (indexEnabled() && id >= MINID && id <= MAXID) {
+        int slot = id - MINID;
+        SWARM_COUNT(lookups, 1);
+        return (m_present[slot / 64] >> (slot % 64)) & 1;
+    }
+    SWARM_COUNT(lookups, 1);
+    int compared = 0;//ID comparisons, counted once at the end
     Robot* aBot = m_root; // Start search from m_root
     if (aBot == nullptr) {
         return false;
     }
     while (aBot != nullptr) {
+        compared++;
         if (aBot->m_id == id) {
+            SWARM_COUNT(comparisons, compared);
             return true;
         }
         else if (aBot->m_id < id) {
@@ -327,18 +1720,27 @@ bool Swarm::findBot(int id) const {
             aBot = aBot->m_left;
         }
     }
+    SWARM_COUNT(comparisons, compared);
     return false; // Return false if id was not found
 }
 
 // Return the robot corresponding to the id we are looking for
 Robot* Swarm::findThisBot(Robot* aBot, int id)
 {
+    if (indexEnabled() && id >= MINID && id <= MAXID) {
+        SWARM_COUNT(lookups, 1);
+        return m_index[id - MINID];
+    }
+    SWARM_COUNT(lookups, 1);
+    int compared = 0;
     aBot = m_root; // Start search from m_root
     if (aBot == nullptr) {
         return nullptr;
     }
     while (aBot != nullptr) {
+        compared++;
         if (aBot->m_id == id) {
+            SWARM_COUNT(comparisons, compared);
             return aBot;
         }
         else if (aBot->m_id < id) {
@@ -348,22 +1750,31 @@ Robot* Swarm::findThisBot(Robot* aBot, int id)
             aBot = aBot->m_left;
         }
     }
+    SWARM_COUNT(comparisons, compared);
     return nullptr;
 }
 
 // Display tree
 void Swarm::dumpTree() const {
-    dump(m_root);
+    OutputSink out(cout);
+    dump(m_root, out);
+}
+
+// Display tree on out
+void Swarm::dumpTree(OutputSink& out) const {
+    dump(m_root, out);
 }
 
 // Display tree
-void Swarm::dump(Robot* aBot) const {
+void Swarm::dump(const Robot* aBot, OutputSink& out) const {
     if (aBot != nullptr) {
-        cout << "(";
-        dump(aBot->m_left);//first visit the left child
-        cout << aBot->m_id << ":" << aBot->m_height;//second visit the node itself
-        dump(aBot->m_right);//third visit the right child
-        cout << ")";
+        out.put('(');
+        dump(aBot->m_left, out);//first visit the left child
+        out.writeInt(aBot->m_id);//second visit the node itself
+        out.put(':');
+        out.writeInt(aBot->m_height);
+        dump(aBot->m_right, out);//third visit the right child
+        out.put(')');
     }
 }
 
@@ -373,13 +1784,8 @@ bool Swarm::treeStatus(Robot* aBot)
     if (aBot == nullptr) {
         return false;
     }
-    if (aBot != nullptr) {
-        cout << "(";
-        dump(aBot->m_left);//first visit the left child
-        cout << aBot->m_id << ":" << aBot->m_height;//second visit the node itself
-        dump(aBot->m_right);//third visit the right child
-        cout << ")";
-    }
+    OutputSink out(cout);
+    dump(aBot, out);
     return true;
 }
 
@@ -3,20 +3,43 @@
 #ifndef SWARM_H
 #define SWARM_H
 #include <iostream>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <atomic>
+#include <iterator>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "threadpool.h"
+#include "latencyhistogram.h"
 using namespace std;
 class Grader;//this class is for grading purposes, no need to do anything
 class Tester;//this is your tester class, you add your test functions in this class
+class FrozenSwarm;//read-only snapshot, see frozenswarm.h
+class OutputSink;//buffered listing output, see outputsink.h
+class SwarmJournal;//write-ahead journal, see swarmjournal.h
 enum STATE { ALIVE, DEAD };
 enum ROBOTTYPE { BIRD, DRONE, REPTILE, SUB, QUADRUPED };
+const int STATE_COUNT = DEAD + 1;
+const int TYPE_COUNT = QUADRUPED + 1;
+constexpr string_view STATE_NAMES[STATE_COUNT] = { "ALIVE", "DEAD" };//indexed by STATE
+constexpr string_view TYPE_NAMES[TYPE_COUNT] = { "BIRD", "DRONE", "REPTILE", "SUB", "QUADRUPED" };//indexed by ROBOTTYPE
 const int MINID = 10000;
 const int MAXID = 99999;
 #define DEFAULT_HEIGHT 0
 #define DEFAULT_ID 0
 #define DEFAULT_TYPE DRONE
 #define DEFAULT_STATE ALIVE
+#define ROBOT_SLAB_SIZE 1024 //robots carved out of one arena slab
+#define REDUCE_GRAIN_HEIGHT 10 //subtrees up to this height are reduced by one task
+#define SWARM_PATH_MAX 48 //nodes on a root-to-leaf path; an AVL tree of 2^31 robots has fewer than 46
 class Robot {
 public:
     friend class Swarm;
+    friend class RobotArena;
     friend class Grader;
     friend class Tester;
     Robot(int id, ROBOTTYPE type = DEFAULT_TYPE, STATE state = DEFAULT_STATE)
@@ -24,6 +47,8 @@ public:
         m_left = nullptr;
         m_right = nullptr;
         m_height = DEFAULT_HEIGHT;
+        m_size = 1;
+        countOnlyItself();
     }
     Robot() {
         m_id = DEFAULT_ID;
@@ -32,6 +57,8 @@ public:
         m_left = nullptr;
         m_right = nullptr;
         m_height = DEFAULT_HEIGHT;
+        m_size = 1;
+        countOnlyItself();
     }
     int getID() const { return m_id; }
     STATE getState() const { return m_state; }
@@ -45,7 +72,13 @@ public:
         }
         return text;
     }
+    string_view getStateName() const {//getStateStr() without building a string
+        return (m_state >= 0 && m_state < STATE_COUNT) ? STATE_NAMES[m_state] : "UNKOWN";
+    }
     ROBOTTYPE getType() const { return m_type; }
+    string_view getTypeName() const {//getTypeStr() without building a string
+        return (m_type >= 0 && m_type < TYPE_COUNT) ? TYPE_NAMES[m_type] : "UNKNOWN";
+    }
     string getTypeStr() const {
         string text = "";
         switch (m_type)
@@ -77,27 +110,251 @@ private:
     Robot* m_left;//the pointer to the left child in the BST
     Robot* m_right;//the pointer to the right child in the BST
     int m_height;//the height of node in the BST
+    int m_size;//robots in the subtree, kept by Swarm::updateHeight
+    int m_typeCounts[TYPE_COUNT];//robots of each type in the subtree, kept by Swarm::updateHeight
+
+    void countOnlyItself() {//a robot of an unknown type counts as none, a Swarm never takes it in
+        for (int type = 0; type < TYPE_COUNT; type++) {
+            m_typeCounts[type] = 0;
+        }
+        if (m_type >= 0 && m_type < TYPE_COUNT) {
+            m_typeCounts[m_type] = 1;
+        }
+    }
+};
+
+// Allocator statistics of a RobotArena
+struct ArenaStats {
+    int slabs;//slabs currently held, kept slabs shared with other arenas included
+    int liveNodes;//robots handed out and not released
+    int freeNodes;//released robots waiting on the free list
+};
+
+// Operation counters and tree shape of a Swarm, see Swarm::stats(). The counters are only kept
+// when the program is built with SWARM_STATS defined (make SWARM_FLAGS=-DSWARM_STATS); without
+// it the instrumentation compiles away, enabled is false and every counter reads 0.
+struct SwarmStats {
+    bool enabled;//counters are kept
+    int robots;
+    int height;//height of the tree, -1 when empty
+    int heightBound;//largest height an AVL tree of this many robots can have
+    uint64_t lookups;//findBot and setState
+    uint64_t comparisons;//ID comparisons made by lookups
+    uint64_t inserts;//insert and remove calls, hits or not
+    uint64_t removes;
+    uint64_t nodesVisited;//nodes insert and remove went through, down and back up
+    uint64_t rotationsLeftLeft;//single right rotation
+    uint64_t rotationsRightRight;//single left rotation
+    uint64_t rotationsLeftRight;
+    uint64_t rotationsRightLeft;
+    uint64_t heightUpdates;//calls of Swarm::updateHeight
+    uint64_t allocations;//robots taken from the arena
+    uint64_t frees;//robots given back to the arena
+    void writeJSON(OutputSink& out) const;
+    void writePrometheus(OutputSink& out) const;
+};
+
+#ifdef SWARM_STATS
+#define SWARM_COUNT(counter, n) (m_counters.counter.fetch_add((n), memory_order_relaxed))
+#else
+#define SWARM_COUNT(counter, n) ((void)0)
+#endif
+
+// Per-swarm slab allocator for Robot nodes. Robots are carved out of slabs of ROBOT_SLAB_SIZE
+// and released robots are kept on a free list for the next allocation, so insert/remove never
+// reach the global allocator once the swarm has warmed up. Robot has no destructor to run, so
+// reset() drops every robot at once by releasing the slabs.
+//
+// Swarm::split() and Swarm::concat() move nodes between swarms without copying them, so two
+// arenas can end up with nodes in the same slabs. share() and adopt() then retire the slabs
+// into a kept arena that every arena with nodes in it holds on to; it frees the slabs once the
+// last of them is reset or destroyed. An arena never carves new robots out of kept slabs, but
+// its free list may hold robots from them.
+class RobotArena {
+public:
+    friend class Grader;
+    friend class Tester;
+    RobotArena();
+    ~RobotArena();
+    RobotArena(const RobotArena&) = delete;
+    RobotArena& operator=(const RobotArena&) = delete;
+    RobotArena(RobotArena&& other) noexcept;//takes the slabs over, other is left empty
+    RobotArena& operator=(RobotArena&& other) noexcept;
+    Robot* allocate(int id, ROBOTTYPE type, STATE state);
+    void release(Robot* aBot);
+    void reset();//releases every robot, keeping the first slab for reuse
+    void share(RobotArena& other, int nodes);//nodes of the live robots now belong to other
+    void adopt(RobotArena& other);//every live robot of other now belongs to this arena, other is left empty
+    ArenaStats stats() const;
+
+private:
+    vector<Robot*> m_slabs;//raw storage of ROBOT_SLAB_SIZE robots each
+    vector<shared_ptr<RobotArena>> m_kept;//retired slabs this arena still has robots in
+    int m_used;//robots carved out of the last slab
+    Robot* m_freeList;//released robots chained through m_left
+    int m_live;
+    int m_free;
+
+    void retire();
+    void keep(const vector<shared_ptr<RobotArena>>& kept);
 };
 
 class Swarm {
 public:
     friend class Grader;
     friend class Tester;
+    friend class FrozenSwarm;
+
+    // Bidirectional in-order iterator over the robots. It keeps the path from the root to its
+    // robot in a fixed array, so it never allocates, and each step moves up or down that path,
+    // O(1) amortized. Any change to the tree invalidates it; setState does not.
+    class const_iterator {
+    public:
+        friend class Swarm;
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef Robot value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Robot* pointer;
+        typedef const Robot& reference;
+
+        const_iterator() : m_root(nullptr), m_depth(0) {}
+        reference operator*() const { return *m_path[m_depth - 1]; }
+        pointer operator->() const { return m_path[m_depth - 1]; }
+        bool operator==(const const_iterator& other) const { return current() == other.current(); }
+        bool operator!=(const const_iterator& other) const { return current() != other.current(); }
+        const_iterator& operator++() {//right subtree's smallest, else the first ancestor we are left of
+            const Robot* aBot = m_path[m_depth - 1]->m_right;
+            if (aBot != nullptr) {
+                descend(aBot, &Robot::m_left);
+            }
+            else {
+                const Robot* child;
+                do {
+                    child = m_path[--m_depth];
+                } while (m_depth > 0 && m_path[m_depth - 1]->m_right == child);
+            }
+            return *this;
+        }
+        const_iterator& operator--() {//end() steps back to the largest robot
+            if (m_depth == 0) {
+                descend(m_root, &Robot::m_right);
+                return *this;
+            }
+            const Robot* aBot = m_path[m_depth - 1]->m_left;
+            if (aBot != nullptr) {
+                descend(aBot, &Robot::m_right);
+            }
+            else {
+                const Robot* child;
+                do {
+                    child = m_path[--m_depth];
+                } while (m_depth > 0 && m_path[m_depth - 1]->m_left == child);
+            }
+            return *this;
+        }
+        const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+        const_iterator operator--(int) { const_iterator old = *this; --*this; return old; }
+
+    private:
+        const Robot* m_root;
+        const Robot* m_path[SWARM_PATH_MAX];//m_path[m_depth - 1] is the robot, none at end()
+        int m_depth;
+
+        explicit const_iterator(const Robot* root) : m_root(root), m_depth(0) {}
+        const Robot* current() const { return (m_depth > 0) ? m_path[m_depth - 1] : nullptr; }
+        void descend(const Robot* aBot, Robot* Robot::*child) {//push aBot and its chain of children
+            while (aBot != nullptr) {
+                m_path[m_depth++] = aBot;
+                aBot = aBot->*child;
+            }
+        }
+    };
+
     Swarm();
+    template <class InputIt>
+    Swarm(InputIt first, InputIt last);//builds a balanced tree from a range of robots in one pass
     ~Swarm();
+    Swarm(const Swarm& other);//clones the tree node for node in O(n), heights included
+    Swarm& operator=(const Swarm& other);
+    Swarm(Swarm&& other) noexcept;//takes the tree over in O(1), other is left empty
+    Swarm& operator=(Swarm&& other) noexcept;
     void insert(const Robot& robot);
+    void insert(Robot&& robot);
+    void emplace(int id, ROBOTTYPE type = DEFAULT_TYPE, STATE state = DEFAULT_STATE);//inserts without building a Robot first
     void clear();
+    template <class InputIt>
+    void assign(InputIt first, InputIt last);//replaces the robots with the range, see assignRobots()
     void remove(int id);
+    template <class InputIt>
+    int insertBatch(InputIt first, InputIt last);//inserts a range of robots in one pass, returns the count added
+    template <class InputIt>
+    int removeBatch(InputIt first, InputIt last);//removes a range of IDs in one pass, returns the count removed
+    pair<Swarm, Swarm> split(int id);//robots below id and the rest; O(log n), plus O(k) with the index on or mixed states, see split()
+    bool join(const Robot& pivot, Swarm& right);//adds pivot and every robot of right, all above pivot; O(log n), see join()
+    bool concat(Swarm& right);//adds every robot of right, all above the robots here; O(log n), see concat()
     void dumpTree() const;
+    void dumpTree(OutputSink& out) const;
     void listRobots() const;
+    void listRobots(OutputSink& out) const;//same text as listRobots(), written to out
+    void listRobots(int page, int pageSize) const;//prints robots page * pageSize.. of the ID order, O(log n + pageSize)
+    static void writeRobot(int id, STATE state, ROBOTTYPE type, OutputSink& out);//one listing line, ID:STATE:TYPE
     bool setState(int id, STATE state);
-    void removeDead();//removes all dead robots from the tree
+    void removeDead();//removes all dead robots from the tree, at once if there are none
+    int removeIf(const function<bool(const Robot&)>& pred);//removes every robot pred accepts, returns the count
     bool findBot(int id) const;//returns true if the bot is in tree
+    int countByState(STATE state) const;//O(1), 0 for an unknown state
+    int countByType(ROBOTTYPE type) const;//O(1), 0 for an unknown type
+    int countByType(ROBOTTYPE type, int idLo, int idHi) const;//robots of type with IDs in idLo..idHi, O(log n)
+    int size() const;
+    int rank(int id) const;//robots with an ID below id, O(log n)
+    const Robot* select(int k) const;//robot k of the ID order counting from 0, nullptr past the end, O(log n)
+    int countInRange(int lo, int hi) const;//robots with IDs in lo..hi, O(log n)
+    void forEachInRange(int lo, int hi, const function<void(const Robot&)>& fn) const;//in ID order, O(log n + k)
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator lower_bound(int id) const;//first robot with an ID not below id
+    const_iterator upper_bound(int id) const;//first robot with an ID above id
+    const_iterator find(int id) const;//the robot with id, end() if there is none
+    ArenaStats allocatorStats() const;
+    SwarmStats stats() const;//operation counters and tree shape, see SwarmStats
+    void resetStats();//zeroes the operation counters
+    void enableLatency(bool enable);//times insert, remove, setState, findBot and removeDead, see latencyhistogram.h
+    bool latencyEnabled() const;
+    LatencyHistogram latency(SWARMOP op) const;//latencies of op so far, empty when timing is off
+    void writeLatency(OutputSink& out) const;//count, mean, p50, p99, p99.9 and max of every operation as JSON
+    void enableIndex(bool enable);//builds or drops the direct-addressed ID index
+    bool indexEnabled() const;
+    FrozenSwarm freeze() const;//immutable lookup snapshot of the current robots
+    bool save(const string& path) const;//binary swarm file, see mappedswarm.h
+    bool load(const string& path);//replaces the robots with a swarm file; false leaves them as they were
+    void attachJournal(SwarmJournal* journal);//records every later change in journal, nullptr detaches
+    bool checkpoint(const string& path);//saves a swarm file, then resets the attached journal
+    bool recover(const string& snapshotPath, const string& journalPath);//loads the snapshot and replays the journal
+    template <class T, class Visitor, class Combiner>
+    T parallelReduce(const T& identity, Visitor visit, Combiner combine) const;//see reduceSubtree()
+    template <class T, class Visitor, class Combiner>
+    T parallelReduce(const T& identity, Visitor visit, Combiner combine, WorkStealingPool& pool) const;
 
 private:
     Robot* m_root;//the root of the BST
+    RobotArena m_arena;//owns every node of the tree
+    vector<Robot*> m_index;//node of every ID in MINID..MAXID when the index is enabled, empty otherwise
+    vector<uint64_t> m_present;//bitmap of the IDs in m_index
+    atomic<int> m_stateCounts[STATE_COUNT];//atomic since ConcurrentSwarm changes states under a shared lock
+    int m_typeCounts[TYPE_COUNT];
+    SwarmJournal* m_journal;//not owned, nullptr when changes are not journaled
+    unique_ptr<LatencyRecorder> m_latency;//nullptr when operations are not timed
+#ifdef SWARM_STATS
+    struct Counters {//atomic since ConcurrentSwarm looks up under a shared lock
+        atomic<uint64_t> lookups, comparisons, inserts, removes, nodesVisited;
+        atomic<uint64_t> rotationsLeftLeft, rotationsRightRight, rotationsLeftRight, rotationsRightLeft;
+        atomic<uint64_t> heightUpdates, allocations, frees;
+    };
+    mutable Counters m_counters;
+#endif
 
-    void dump(Robot* aBot) const;
+    void dump(const Robot* aBot, OutputSink& out) const;
+    static void writeRobot(const Robot& aBot, OutputSink& out);
     void updateHeight(Robot* aBot);
     int checkImbalance(Robot* aBot);
     Robot* rebalance(Robot* aBot);
@@ -107,6 +364,10 @@ private:
     // ***************************************************
 
     Robot* insertRobot(const Robot& robot, Robot*& aBot);
+    Robot* insertAlongPath(int id, ROBOTTYPE type, STATE state, Robot* root);
+    Robot* cloneTree(const Robot* aBot);
+    void takeOver(Swarm& other);
+    Robot* deleteAlongPath(Robot* root, int id);
     Robot* traverseTree(Robot* aBot) const;
     Robot* findMin(Robot* aBot);
     Robot* findMax(Robot* aBot);
@@ -115,8 +376,113 @@ private:
     Robot* singleRightRotation(Robot* aBot);
     Robot* singleLeftRotation(Robot* aBot);
     bool bstProperty(Robot* aBot, int minKey, int maxKey);
-    void clearFromNode(Robot* &aBot);
-    Robot* removeDeadRobot(Robot* aBot);
+    int collectSurvivors(Robot* aBot, const function<bool(const Robot&)>& pred, vector<Robot*>& survivors);
+    Robot* buildBalanced(vector<Robot*>& robots, int low, int high);
+    void assignRobots(vector<Robot>& robots);
+    int insertRobots(vector<Robot>& robots);
+    int removeIDs(vector<int>& ids);
+    Robot* unionBatch(Robot* aBot, const vector<Robot>& robots, int low, int high);
+    Robot* differenceBatch(Robot* aBot, const vector<int>& ids, int low, int high);
+    Robot* buildBatch(const vector<Robot>& robots, int low, int high);
+    Robot* joinRobots(Robot* left, Robot* middle, Robot* right);
+    Robot* joinTrees(Robot* left, Robot* right);
+    Robot* splitLast(Robot* aBot, Robot*& last);
+    Robot* splitTree(Robot* aBot, int id, Robot*& rest);
+    Robot* adoptTree(Swarm& other);
+    void handOver(Robot* aBot, Swarm& to);
+    void moveRobots(Robot* aBot, Swarm& to);
+    static int countDead(const Robot* aBot);
+    void journalTree(const Robot* aBot);
+    Robot* newRobot(int id, ROBOTTYPE type, STATE state);
+    void releaseRobot(Robot* aBot);
+    void indexRobot(Robot* aBot);
+    void unindexRobot(int id);
+    void indexTree(Robot* aBot);
+    void countRobot(const Robot* aBot, int delta);
+    int countTypeBelow(ROBOTTYPE type, long long id) const;
+    int countBelow(long long id) const;
+    void visitInOrder(long long lo, long long hi, int count, const function<void(const Robot&)>& fn) const;
+    const_iterator boundOf(int id, bool inclusive) const;
     bool treeStatus(Robot* aBot);
+    template <class T, class Visitor, class Combiner>
+    T reduceSubtree(const Robot* aBot, const T& identity, Visitor& visit, Combiner& combine, WorkStealingPool& pool) const;
 };
+
+// Build the tree directly from a range of robots, sorted or not
+template <class InputIt>
+Swarm::Swarm(InputIt first, InputIt last) {
+    m_root = nullptr;
+    m_journal = nullptr;
+    resetStats();
+    assign(first, last);
+}
+
+// Replace the content of the tree with a range of robots, sorted or not
+template <class InputIt>
+void Swarm::assign(InputIt first, InputIt last) {
+    vector<Robot> robots(first, last);
+    assignRobots(robots);
+}
+
+// Insert a range of robots, sorted or not, see insertRobots()
+template <class InputIt>
+int Swarm::insertBatch(InputIt first, InputIt last) {
+    vector<Robot> robots(first, last);
+    return insertRobots(robots);
+}
+
+// Remove a range of IDs, sorted or not, see removeIDs()
+template <class InputIt>
+int Swarm::removeBatch(InputIt first, InputIt last) {
+    vector<int> ids(first, last);
+    return removeIDs(ids);
+}
+
+// Reduce every robot on the shared pool over all cores
+template <class T, class Visitor, class Combiner>
+T Swarm::parallelReduce(const T& identity, Visitor visit, Combiner combine) const {
+    return parallelReduce(identity, visit, combine, WorkStealingPool::shared());
+}
+
+// Reduce every robot on the threads of pool, see reduceSubtree()
+template <class T, class Visitor, class Combiner>
+T Swarm::parallelReduce(const T& identity, Visitor visit, Combiner combine, WorkStealingPool& pool) const {
+    return reduceSubtree(m_root, identity, visit, combine, pool);
+}
+
+// Fold the subtree of aBot: visit(partial, robot) adds a robot to a partial result that starts
+// as identity, and combine(left, right) merges the partials of neighbouring ID ranges, so
+// combine only has to be associative. The left subtree is forked as a task and the node and
+// right subtree are reduced by this thread; subtrees up to REDUCE_GRAIN_HEIGHT, a few
+// thousand robots at most, are walked in order by one task. visit may run on several threads
+// at once and the tree must not change during the reduction.
+template <class T, class Visitor, class Combiner>
+T Swarm::reduceSubtree(const Robot* aBot, const T& identity, Visitor& visit, Combiner& combine, WorkStealingPool& pool) const {
+    if (aBot == nullptr) {
+        return identity;
+    }
+    if (pool.size() == 1 || aBot->m_height <= REDUCE_GRAIN_HEIGHT) {
+        T result = identity;
+        vector<const Robot*> stack;
+        while (aBot != nullptr || !stack.empty()) {
+            while (aBot != nullptr) {
+                stack.push_back(aBot);
+                aBot = aBot->m_left;
+            }
+            aBot = stack.back();
+            stack.pop_back();
+            visit(result, *aBot);
+            aBot = aBot->m_right;
+        }
+        return result;
+    }
+    T left = identity;
+    TaskGroup group(pool);
+    group.run([&]() { left = reduceSubtree(aBot->m_left, identity, visit, combine, pool); });
+    T right = identity;
+    visit(right, *aBot);
+    right = combine(right, reduceSubtree(aBot->m_right, identity, visit, combine, pool));
+    group.wait();
+    return combine(left, right);
+}
 #endif
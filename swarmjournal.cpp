@@ -0,0 +1,326 @@
+#include "swarmjournal.h"
+#include <chrono>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const unsigned char JOURNAL_MAGIC[4] = { 'S', 'W', 'J', 'L' };
+const uint32_t FNV32_OFFSET = 2166136261u;
+const uint32_t FNV32_PRIME = 16777619u;
+
+static uint32_t loadLE32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void storeLE32(unsigned char* p, uint32_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+// FNV-1a of the first 8 bytes of a record
+static uint32_t recordCheck(const unsigned char* record) {
+    uint32_t hash = FNV32_OFFSET;
+    for (int i = 0; i < 8; i++) {
+        hash = (hash ^ record[i]) * FNV32_PRIME;
+    }
+    return hash;
+}
+
+// True if record is complete, passes its check and holds a known op, type and state
+static bool validRecord(const unsigned char* record) {
+    return record[0] >= JOURNAL_INSERT && record[0] <= JOURNAL_CLEAR && record[1] < TYPE_COUNT &&
+        record[2] < STATE_COUNT && loadLE32(record + 8) == recordCheck(record);
+}
+
+// Write all of data to fd; false on an error
+static bool writeAll(int fd, const unsigned char* data, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t count = ::write(fd, data + done, length - done);
+        if (count <= 0) {
+            return false;
+        }
+        done += (size_t)count;
+    }
+    return true;
+}
+
+// Read the whole file at path; false if it cannot be opened
+static bool readAll(const string& path, vector<unsigned char>& data) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    if (ok) {
+        data.resize((size_t)info.st_size);
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t count = ::read(fd, data.data() + done, data.size() - done);
+            if (count <= 0) {
+                break;
+            }
+            done += (size_t)count;
+        }
+        data.resize(done);
+    }
+    ::close(fd);
+    return ok;
+}
+
+// True if data starts with a journal header
+static bool validHeader(const vector<unsigned char>& data) {
+    return data.size() >= JOURNAL_HEADER_SIZE && data[0] == JOURNAL_MAGIC[0] && data[1] == JOURNAL_MAGIC[1] &&
+        data[2] == JOURNAL_MAGIC[2] && data[3] == JOURNAL_MAGIC[3] && loadLE32(data.data() + 4) == JOURNAL_VERSION;
+}
+
+// Length of the valid records of data after the header
+static size_t validLength(const vector<unsigned char>& data) {
+    size_t end = JOURNAL_HEADER_SIZE;
+    while (end + JOURNAL_RECORD_SIZE <= data.size() && validRecord(data.data() + end)) {
+        end += JOURNAL_RECORD_SIZE;
+    }
+    return end;
+}
+
+// Nothing open
+SwarmJournal::SwarmJournal() {
+    m_fd = -1;
+    m_window = 0;
+    m_appended = 0;
+    m_durable = 0;
+    m_syncs = 0;
+    m_flushing = false;
+    m_failed = false;
+    m_stop = false;
+}
+
+// Commit whatever is left
+SwarmJournal::~SwarmJournal() {
+    close();
+}
+
+// Open the journal at path for appending, creating it if needed. An existing journal is cut
+// back to its last valid record, so new records never follow a torn one. windowMicros is the
+// group-commit window; 0 makes every change durable before it returns.
+bool SwarmJournal::open(const string& path, int windowMicros) {
+    close();
+    vector<unsigned char> data;
+    bool exists = readAll(path, data);
+    if (exists && !data.empty() && !validHeader(data)) {
+        return false;//some other file
+    }
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t end = JOURNAL_HEADER_SIZE;
+    if (validHeader(data)) {
+        end = validLength(data);
+    }
+    else {
+        unsigned char header[JOURNAL_HEADER_SIZE];
+        for (int i = 0; i < 4; i++) {
+            header[i] = JOURNAL_MAGIC[i];
+        }
+        storeLE32(header + 4, JOURNAL_VERSION);
+        if (ftruncate(fd, 0) != 0 || !writeAll(fd, header, JOURNAL_HEADER_SIZE)) {
+            ::close(fd);
+            return false;
+        }
+    }
+    if (ftruncate(fd, (off_t)end) != 0 || lseek(fd, (off_t)end, SEEK_SET) < 0 || fsync(fd) != 0) {
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+    m_window = (windowMicros > 0) ? windowMicros : 0;
+    m_appended = 0;
+    m_durable = 0;
+    m_syncs = 0;
+    m_flushing = false;
+    m_failed = false;
+    m_stop = false;
+    m_pending.clear();
+    if (m_window > 0) {
+        m_flusher = thread(&SwarmJournal::flushLoop, this);
+    }
+    return true;
+}
+
+// Commit, stop the flusher and close the file
+void SwarmJournal::close() {
+    if (m_fd < 0) {
+        return;
+    }
+    commit();
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_flusher.joinable()) {
+        m_flusher.join();
+    }
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+// True between a successful open() and close()
+bool SwarmJournal::isOpen() const {
+    return m_fd >= 0;
+}
+
+// Add one record. Without a window the caller becomes the committer of every record waiting,
+// or waits for the committer already at work, and returns once its record is durable.
+void SwarmJournal::append(JOURNALOP op, int id, ROBOTTYPE type, STATE state) {
+    unsigned char record[JOURNAL_RECORD_SIZE];
+    record[0] = (unsigned char)op;
+    record[1] = (unsigned char)type;
+    record[2] = (unsigned char)state;
+    record[3] = 0;
+    storeLE32(record + 4, (uint32_t)id);
+    storeLE32(record + 8, recordCheck(record));
+    unique_lock<mutex> lock(m_lock);
+    if (m_fd < 0) {
+        return;
+    }
+    m_pending.insert(m_pending.end(), record, record + JOURNAL_RECORD_SIZE);
+    m_appended++;
+    if (m_window == 0) {
+        waitDurable(lock, m_appended);
+    }
+    else if (m_pending.size() >= JOURNAL_GROUP_BYTES) {
+        m_wake.notify_one();
+    }
+}
+
+// Make every record appended so far durable
+void SwarmJournal::commit() {
+    unique_lock<mutex> lock(m_lock);
+    if (m_fd >= 0) {
+        waitDurable(lock, m_appended);
+    }
+}
+
+// Return once count records are durable: commit the waiting ones unless another thread is
+// already writing, in which case wait for it and check again
+void SwarmJournal::waitDurable(unique_lock<mutex>& lock, uint64_t count) {
+    while (m_durable < count) {
+        if (!m_flushing) {
+            flushPending(lock);
+        }
+        else {
+            m_synced.wait(lock);
+        }
+    }
+}
+
+// Write and sync every waiting record as one group. The lock is held on entry and on return but
+// not during the write, so appends go on meanwhile; m_flushing keeps a second group out.
+void SwarmJournal::flushPending(unique_lock<mutex>& lock) {
+    vector<unsigned char> group;
+    group.swap(m_pending);
+    uint64_t records = group.size() / JOURNAL_RECORD_SIZE;
+    m_flushing = true;
+    lock.unlock();
+    bool ok = writeAll(m_fd, group.data(), group.size()) && fdatasync(m_fd) == 0;
+    lock.lock();
+    m_flushing = false;
+    m_failed = m_failed || !ok;
+    m_durable += records;
+    m_syncs++;
+    m_synced.notify_all();
+}
+
+// Flusher thread: commit a group once per window, or sooner when enough records are waiting
+void SwarmJournal::flushLoop() {
+    unique_lock<mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait_for(lock, chrono::microseconds(m_window),
+            [this]() { return m_stop || m_pending.size() >= JOURNAL_GROUP_BYTES; });
+        if (!m_pending.empty() && !m_flushing) {
+            flushPending(lock);
+        }
+        if (m_stop && m_pending.empty() && !m_flushing) {
+            return;
+        }
+    }
+}
+
+// Drop every record: commit, then cut the file back to its header. Call it once the swarm is
+// saved, see Swarm::checkpoint().
+bool SwarmJournal::reset() {
+    unique_lock<mutex> lock(m_lock);
+    if (m_fd < 0) {
+        return false;
+    }
+    waitDurable(lock, m_appended);
+    return ftruncate(m_fd, JOURNAL_HEADER_SIZE) == 0 && lseek(m_fd, JOURNAL_HEADER_SIZE, SEEK_SET) >= 0 &&
+        fsync(m_fd) == 0;
+}
+
+// Records appended since open
+uint64_t SwarmJournal::appended() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_appended;
+}
+
+// Records written and synced since open
+uint64_t SwarmJournal::durable() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_durable;
+}
+
+// Groups written and synced since open
+uint64_t SwarmJournal::syncs() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_syncs;
+}
+
+// True if a write or sync has failed since open; the records of that group may be lost
+bool SwarmJournal::failed() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_failed;
+}
+
+// Apply the records of the journal at path to swarm in order and return how many were applied.
+// A missing journal holds no changes; a file that is not a journal returns -1. The swarm should
+// have no journal attached, or the replayed changes are recorded again.
+int SwarmJournal::replay(const string& path, Swarm& swarm) {
+    vector<unsigned char> data;
+    if (!readAll(path, data)) {
+        return 0;
+    }
+    if (!validHeader(data)) {
+        return -1;
+    }
+    size_t end = validLength(data);
+    int applied = 0;
+    for (size_t offset = JOURNAL_HEADER_SIZE; offset < end; offset += JOURNAL_RECORD_SIZE) {
+        const unsigned char* record = data.data() + offset;
+        int id = (int)loadLE32(record + 4);
+        ROBOTTYPE type = static_cast<ROBOTTYPE>(record[1]);
+        STATE state = static_cast<STATE>(record[2]);
+        switch (record[0])
+        {
+        case JOURNAL_INSERT:
+            swarm.insert(Robot(id, type, state));
+            break;
+        case JOURNAL_REMOVE:
+            swarm.remove(id);
+            break;
+        case JOURNAL_SET_STATE:
+            swarm.setState(id, state);
+            break;
+        default:
+            swarm.clear();
+            break;
+        }
+        applied++;
+    }
+    return applied;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef SWARMJOURNAL_H
+#define SWARMJOURNAL_H
+#include "swarm.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 8
+#define JOURNAL_RECORD_SIZE 12
+#define JOURNAL_GROUP_BYTES (64 * 1024) //pending bytes that wake the flusher before the window ends
+
+// Kinds of journal records
+enum JOURNALOP { JOURNAL_INSERT = 1, JOURNAL_REMOVE, JOURNAL_SET_STATE, JOURNAL_CLEAR };
+
+// Journal file, little-endian and fixed-width:
+//   header  0: magic "SWJL"   4: version (u32)
+//   records 0: op (u8)   1: type (u8)   2: state (u8)   3: reserved, 0   4: id (i32)
+//           8: FNV-1a of bytes 0..7 (u32)
+// A record that is cut off or fails its check ends the journal; it is the tail of a write that
+// a crash interrupted.
+//
+// Write-ahead journal of the changes to a Swarm. A swarm with an attached journal appends one
+// record per robot it inserts, removes or changes the state of, and one per clear. Records are
+// collected in memory and made durable by group commit: with a window of 0 every change is
+// written and synced before the call returns, otherwise a flusher thread writes and syncs
+// everything collected once per window, so a crash loses at most the last window of changes and
+// the sync is paid once per group instead of once per change. commit() makes everything
+// appended so far durable right away.
+//
+// Every record is idempotent against a later state of the swarm (removals are recorded per
+// robot, never as "remove the dead ones"), so replaying a journal on top of a snapshot saved
+// after some of its records is still correct. That makes a checkpoint safe to interrupt between
+// saving the snapshot and resetting the journal.
+class SwarmJournal {
+public:
+    friend class Grader;
+    friend class Tester;
+    SwarmJournal();
+    ~SwarmJournal();//commits and closes
+    SwarmJournal(const SwarmJournal&) = delete;
+    SwarmJournal& operator=(const SwarmJournal&) = delete;
+    bool open(const string& path, int windowMicros);//appends to path, dropping a torn tail; false if it cannot
+    void close();//commits and stops the flusher
+    bool isOpen() const;
+    void append(JOURNALOP op, int id, ROBOTTYPE type = DEFAULT_TYPE, STATE state = DEFAULT_STATE);
+    void commit();//returns once every record appended so far is durable
+    bool reset();//drops every record, after a checkpoint
+    uint64_t appended() const;//records appended since open
+    uint64_t durable() const;//records written and synced since open
+    uint64_t syncs() const;//group commits done since open
+    bool failed() const;//a write or sync has failed since open
+    static int replay(const string& path, Swarm& swarm);//applies the records to swarm, -1 if path is no journal
+
+private:
+    int m_fd;
+    int m_window;//group-commit window in microseconds, 0 syncs every record
+    mutable mutex m_lock;
+    condition_variable m_wake;//flusher: a full group is waiting or the journal closes
+    condition_variable m_synced;//committers: a group was written
+    vector<unsigned char> m_pending;//records not written yet
+    uint64_t m_appended;
+    uint64_t m_durable;
+    uint64_t m_syncs;
+    bool m_flushing;//a group is being written, by the flusher or a committer
+    bool m_failed;
+    bool m_stop;
+    thread m_flusher;
+
+    void waitDurable(unique_lock<mutex>& lock, uint64_t count);
+    void flushPending(unique_lock<mutex>& lock);
+    void flushLoop();
+};
+#endif
@@ -0,0 +1,138 @@
+#include "threadpool.h"
+
+// Pool and worker index of the current thread; outside threads have no pool
+static thread_local const WorkStealingPool* t_pool = nullptr;
+static thread_local int t_index = -1;
+
+// Start threads - 1 workers, each with its own queue, plus the queue for outside threads
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    if (threads == 0) {
+        threads = thread::hardware_concurrency();
+    }
+    m_threads = (threads == 0) ? 1 : threads;
+    m_queued.store(0);
+    m_stop.store(false);
+    for (unsigned i = 0; i < m_threads; i++) {
+        m_queues.push_back(unique_ptr<TaskQueue>(new TaskQueue()));
+    }
+    for (unsigned i = 0; i + 1 < m_threads; i++) {
+        m_workers.emplace_back(&WorkStealingPool::work, this, (int)i);
+    }
+}
+
+// Stop the workers once they are idle
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> guard(m_idleLock);
+        m_stop.store(true);
+    }
+    m_idle.notify_all();
+    for (thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+// Threads working on the tasks, the waiting caller included
+unsigned WorkStealingPool::size() const {
+    return m_threads;
+}
+
+// Process-wide pool over every core
+WorkStealingPool& WorkStealingPool::shared() {
+    static WorkStealingPool pool;
+    return pool;
+}
+
+// Queue a worker pushes to and pops from first
+int WorkStealingPool::queueOfThisThread() const {
+    return (t_pool == this) ? t_index : (int)m_threads - 1;
+}
+
+// Push the task on the back of the queue of this thread and wake an idle worker
+void WorkStealingPool::submit(function<void()> task) {
+    TaskQueue& queue = *m_queues[queueOfThisThread()];
+    {
+        lock_guard<mutex> guard(queue.m_lock);
+        queue.m_tasks.push_back(move(task));
+    }
+    m_queued++;
+    if (!m_workers.empty()) {
+        lock_guard<mutex> guard(m_idleLock);
+        m_idle.notify_one();
+    }
+}
+
+// Run one task: the newest of this thread's queue, else the oldest of another queue.
+// Returns false when every queue is empty.
+bool WorkStealingPool::runOne() {
+    if (m_queued.load() == 0) {
+        return false;
+    }
+    int own = queueOfThisThread();
+    for (unsigned i = 0; i < m_threads; i++) {
+        TaskQueue& queue = *m_queues[(own + i) % m_threads];
+        function<void()> task;
+        {
+            lock_guard<mutex> guard(queue.m_lock);
+            if (queue.m_tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = move(queue.m_tasks.back());
+                queue.m_tasks.pop_back();
+            }
+            else {
+                task = move(queue.m_tasks.front());
+                queue.m_tasks.pop_front();
+            }
+        }
+        m_queued--;
+        task();
+        return true;
+    }
+    return false;
+}
+
+// Worker loop: run tasks while there are any, sleep otherwise
+void WorkStealingPool::work(int index) {
+    t_pool = this;
+    t_index = index;
+    while (true) {
+        if (runOne()) {
+            continue;
+        }
+        unique_lock<mutex> lock(m_idleLock);
+        m_idle.wait(lock, [this]() { return m_stop.load() || m_queued.load() > 0; });
+        if (m_stop.load()) {
+            return;
+        }
+    }
+}
+
+// Group without tasks
+TaskGroup::TaskGroup(WorkStealingPool& pool) : m_pool(pool) {
+    m_pending.store(0);
+}
+
+// Tasks may still refer to the group, so it cannot go away before they are done
+TaskGroup::~TaskGroup() {
+    wait();
+}
+
+// Fork task; it runs on whichever thread takes it first
+void TaskGroup::run(function<void()> task) {
+    m_pending++;
+    m_pool.submit([this, task]() {
+        task();
+        m_pending--;
+    });
+}
+
+// Join: help with queued tasks until every task of this group has finished
+void TaskGroup::wait() {
+    while (m_pending.load() > 0) {
+        if (!m_pool.runOne()) {
+            this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+using namespace std;
+
+// Fork-join thread pool with work stealing. Every worker owns a task deque: it pushes and pops
+// its own tasks at the back, so the most recently split (smallest) piece of work stays hot in
+// its cache, while idle threads steal from the front, where the oldest and largest pieces sit.
+// A pool of n threads starts n - 1 workers; the thread waiting in TaskGroup::wait() runs tasks
+// too, so it is the nth. Tasks must not throw.
+class WorkStealingPool {
+public:
+    friend class TaskGroup;
+    explicit WorkStealingPool(unsigned threads = 0);//0 uses every core
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    unsigned size() const;//threads working on the tasks, the waiting caller included
+    static WorkStealingPool& shared();//pool over every core, started on first use
+
+private:
+    struct TaskQueue {
+        mutex m_lock;
+        deque<function<void()>> m_tasks;
+    };
+    unsigned m_threads;
+    vector<unique_ptr<TaskQueue>> m_queues;//one per worker, the last one for outside threads
+    vector<thread> m_workers;
+    atomic<int> m_queued;//tasks waiting in all queues
+    atomic<bool> m_stop;
+    mutex m_idleLock;
+    condition_variable m_idle;
+
+    void submit(function<void()> task);
+    bool runOne();
+    int queueOfThisThread() const;
+    void work(int index);
+};
+
+// Tasks forked together and joined with wait()
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkStealingPool& pool);
+    ~TaskGroup();//waits for the tasks still running
+    void run(function<void()> task);
+    void wait();//runs queued tasks of any group until all tasks of this one are done
+
+private:
+    WorkStealingPool& m_pool;
+    atomic<int> m_pending;
+};
+#endif